@@ -0,0 +1,119 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "executor/thread_pool.hh"
+#include "queue/mpmc.hh"
+
+/// The pool we used to write by hand: every task goes through one global MPMC queue.
+class GlobalQueuePool {
+  using TaskQueue = toolbox::container::Queue<std::function<void()>, 1 << 16,
+                                              toolbox::container::QueueMode::MPMC>;
+
+ public:
+  explicit GlobalQueuePool(uint32_t n_worker) {
+    for (uint32_t i = 0; i < n_worker; i++) {
+      threads_.emplace_back([this] {
+        std::function<void()> task;
+        while (not stop_.load(std::memory_order_acquire)) {
+          if (q_.pop(task)) {
+            task();
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      });
+    }
+  }
+
+  ~GlobalQueuePool() {
+    stop_.store(true, std::memory_order_release);
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+ public:
+  template <typename F>
+  auto execute(F&& f) -> void {
+    while (not q_.push(std::forward<F>(f))) {
+      std::this_thread::yield();
+    }
+  }
+
+ private:
+  TaskQueue q_{};
+  std::vector<std::thread> threads_;
+  std::atomic_bool stop_{false};
+};
+
+using ThreadPool = toolbox::executor::ThreadPool;
+
+/// s.range(0) workers run `n_task` tiny tasks per iteration, either all submitted from
+/// outside of the pool (Flat) or spawned by the tasks themselves as a binary tree.
+template <typename Pool, bool Nested>
+class ThreadPoolBench : public ::benchmark::Fixture {
+ public:
+  constexpr static uint32_t depth = 12;
+  constexpr static uint64_t n_task = 1 << depth;
+
+ public:
+  auto SetUp(const ::benchmark::State& s) -> void override {
+    pool_ = std::make_unique<Pool>(static_cast<uint32_t>(s.range(0)));
+  }
+
+  auto TearDown(const ::benchmark::State& /*s*/) -> void override { pool_.reset(); }
+
+  auto run(::benchmark::State& s) -> void {
+    for (auto _ : s) {
+      n_done_.store(0, std::memory_order_relaxed);
+      if constexpr (Nested) {
+        pool_->execute([this] { spawn(depth); });
+      } else {
+        for (uint64_t i = 0; i < n_task; i++) {
+          pool_->execute([this] { n_done_.fetch_add(1, std::memory_order_relaxed); });
+        }
+      }
+      while (n_done_.load(std::memory_order_acquire) < n_task) {
+        std::this_thread::yield();
+      }
+    }
+    s.SetItemsProcessed(static_cast<int64_t>(s.iterations() * n_task));
+  }
+
+ private:
+  auto spawn(uint32_t d) -> void {
+    if (d == 0) {
+      n_done_.fetch_add(1, std::memory_order_release);
+      return;
+    }
+    pool_->execute([this, d] { spawn(d - 1); });
+    pool_->execute([this, d] { spawn(d - 1); });
+  }
+
+ private:
+  std::unique_ptr<Pool> pool_{};
+  std::atomic_uint64_t n_done_{0};
+};
+
+#define BenchName(pool, kind) #pool #kind "Bench"
+#define Bench(pool, kind, nested)                               \
+  namespace pool##kind##Bench {                                 \
+    using Benchmark = ThreadPoolBench<pool, nested>;            \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                          \
+    (::benchmark::State & s) { run(s); }                        \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                        \
+        ->Name(BenchName(pool, kind))                           \
+        ->DenseRange(1, std::thread::hardware_concurrency(), 1) \
+        ->UseRealTime();                                        \
+  }
+
+// workers scale up to the hardware threads
+Bench(ThreadPool, Flat, false);
+Bench(GlobalQueuePool, Flat, false);
+Bench(ThreadPool, Nested, true);
+Bench(GlobalQueuePool, Nested, true);
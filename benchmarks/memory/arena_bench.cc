@@ -0,0 +1,101 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <cstdlib>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+#include "memory/arena.hh"
+
+using toolbox::memory::Arena;
+
+constexpr size_t n_object = 64;
+
+/// Sizes of small objects, 16 to 256 bytes.
+auto Sizes() -> std::array<size_t, n_object> {
+  std::array<size_t, n_object> sizes{};
+  for (size_t i = 0; i < n_object; i++) {
+    sizes[i] = 16 + (i * 37) % 241;
+  }
+  return sizes;
+}
+
+/// Allocate n_object small objects, then free them all, as a request does.
+auto MallocChurnBench(::benchmark::State& s) -> void {
+  auto sizes = Sizes();
+  std::array<void*, n_object> objects{};
+  for (auto _ : s) {
+    for (size_t i = 0; i < n_object; i++) {
+      objects[i] = std::malloc(sizes[i]);
+      benchmark::DoNotOptimize(objects[i]);
+    }
+    for (void* p : objects) {
+      std::free(p);
+    }
+  }
+  s.SetItemsProcessed(static_cast<int64_t>(s.iterations() * n_object));
+}
+
+auto ArenaChurnBench(::benchmark::State& s) -> void {
+  auto sizes = Sizes();
+  Arena arena;
+  for (auto _ : s) {
+    for (size_t i = 0; i < n_object; i++) {
+      benchmark::DoNotOptimize(arena.allocate(sizes[i]));
+    }
+    arena.reset();
+  }
+  s.SetItemsProcessed(static_cast<int64_t>(s.iterations() * n_object));
+}
+
+/// Build the strings and a vector of a request, with the allocator of `resource`.
+auto Request(std::pmr::memory_resource* resource) -> size_t {
+  std::pmr::vector<std::pmr::string> fields(resource);
+  for (size_t i = 0; i < 16; i++) {
+    fields.emplace_back(48, static_cast<char>('a' + i));
+  }
+  std::pmr::vector<uint64_t> ids(resource);
+  for (uint64_t i = 0; i < 100; i++) {
+    ids.push_back(i);
+  }
+  return fields.size() + ids.size();
+}
+
+auto HeapRequestBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(Request(std::pmr::new_delete_resource()));
+  }
+}
+
+auto ArenaRequestBench(::benchmark::State& s) -> void {
+  Arena arena;
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(Request(&arena));
+    arena.reset();
+  }
+}
+
+/// A new arena per request, on a buffer of the stack.
+auto StackArenaRequestBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    std::array<std::byte, 8192> buffer;
+    Arena arena(buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(Request(&arena));
+  }
+}
+
+auto MonotonicRequestBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    std::array<std::byte, 8192> buffer;
+    std::pmr::monotonic_buffer_resource resource(buffer.data(), buffer.size());
+    benchmark::DoNotOptimize(Request(&resource));
+  }
+}
+
+BENCHMARK(MallocChurnBench);
+BENCHMARK(ArenaChurnBench);
+BENCHMARK(HeapRequestBench);
+BENCHMARK(ArenaRequestBench);
+BENCHMARK(StackArenaRequestBench);
+BENCHMARK(MonotonicRequestBench);
@@ -0,0 +1,104 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+#include "memory/object_pool.hh"
+#include "queue/spsc.hh"
+#include "util/misc.hh"
+
+class Msg {
+ public:
+  explicit Msg(uint64_t seq) : seq_(seq) {}
+
+ public:
+  uint64_t seq_;
+  char payload_[56];
+};
+
+/// Messages are allocated with `new` by the producer and deleted by the consumer.
+class Heap {
+ public:
+  auto create(uint64_t seq) -> Msg* { return new Msg(seq); }
+  auto destroy(Msg* m) -> void { delete m; }
+};
+
+/// Messages are taken from and given back to an ObjectPool.
+class Pool {
+ public:
+  auto create(uint64_t seq) -> Msg* { return pool_.create(seq); }
+  auto destroy(Msg* m) -> void { pool_.destroy(m); }
+
+ private:
+  toolbox::memory::ObjectPool<Msg> pool_{1 << 12};
+};
+
+/// The producer and consumer of spsc_bench, passing pointers to messages.
+template <typename Allocator>
+class PassBench : public ::benchmark::Fixture {
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    while (s.KeepRunning()) {
+      Msg* m = nullptr;
+      while (not q_.pop(m)) {
+        toolbox::misc::pause();
+      }
+      benchmark::DoNotOptimize(m->seq_);
+      allocator_.destroy(m);
+    }
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    uint64_t seq = 0;
+    while (s.KeepRunning()) {
+      Msg* m = nullptr;
+      while ((m = allocator_.create(seq)) == nullptr) {
+        toolbox::misc::pause();
+      }
+      while (not q_.push(m)) {
+        toolbox::misc::pause();
+      }
+      seq++;
+    }
+  }
+
+ private:
+  Allocator allocator_{};
+  toolbox::container::BoundedSPSCQueue<Msg*, 1024> q_{};
+};
+
+#define BenchName(a) #a "PassBench"
+#define Bench(a)                         \
+  namespace a##PassBench {               \
+    using Benchmark = PassBench<a>;      \
+    BENCHMARK_DEFINE_F(Benchmark, Run)   \
+    (::benchmark::State & s) {           \
+      if (s.thread_index() == 0) {       \
+        consumer(s);                     \
+      } else {                           \
+        producer(s);                     \
+      }                                  \
+    }                                    \
+    BENCHMARK_REGISTER_F(Benchmark, Run) \
+        ->Name(BenchName(a))             \
+        ->Iterations(1 << 22)            \
+        ->Threads(2)                     \
+        ->UseRealTime();                 \
+  }
+
+Bench(Heap);
+Bench(Pool);
+
+/// The same on a single thread, allocating and freeing a message at a time.
+template <typename Allocator>
+auto LocalBench(::benchmark::State& s) -> void {
+  Allocator allocator;
+  uint64_t seq = 0;
+  for (auto _ : s) {
+    Msg* m = allocator.create(seq++);
+    benchmark::DoNotOptimize(m);
+    allocator.destroy(m);
+  }
+}
+
+BENCHMARK(LocalBench<Heap>)->Name("HeapLocalBench");
+BENCHMARK(LocalBench<Pool>)->Name("PoolLocalBench");
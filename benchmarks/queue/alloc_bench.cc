@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <memory>
+#include <new>
+
+#include "queue/spsc.hh"
+#include "queue/unbounded_mpmc.hh"
+
+/// Every heap allocation of this binary is counted, so that the benchmarks can report
+/// how many allocations the unbounded queues make per million elements.
+static std::atomic_uint64_t n_alloc{0};
+
+auto operator new(size_t n) -> void* {
+  n_alloc.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(n)) return p;
+  throw std::bad_alloc();
+}
+
+auto operator new(size_t n, std::align_val_t align) -> void* {
+  n_alloc.fetch_add(1, std::memory_order_relaxed);
+  auto a = static_cast<size_t>(align);
+  if (void* p = std::aligned_alloc(a, (n + a - 1) / a * a)) return p;
+  throw std::bad_alloc();
+}
+
+// the replaced operators below pair malloc with free, which gcc can not see through
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+
+auto operator delete(void* p) noexcept -> void { std::free(p); }
+auto operator delete(void* p, size_t /*n*/) noexcept -> void { std::free(p); }
+auto operator delete(void* p, std::align_val_t /*align*/) noexcept -> void {
+  std::free(p);
+}
+auto operator delete(void* p, size_t /*n*/, std::align_val_t /*align*/) noexcept -> void {
+  std::free(p);
+}
+
+/// Push a burst of s.range(0) elements, then pop them all.
+template <typename Queue>
+class AllocBench : public ::benchmark::Fixture {
+  using ValueType = typename Queue::ValueType;
+
+ public:
+  auto run(::benchmark::State& s) -> void {
+    auto burst = static_cast<uint64_t>(s.range(0));
+    auto q = std::make_unique<Queue>();
+    uint64_t n_ops = 0;
+    uint64_t before = n_alloc.load(std::memory_order_relaxed);
+    for (auto _ : s) {
+      for (uint64_t i = 0; i < burst; i++) {
+        q->push(i);
+      }
+      ValueType e{};
+      for (uint64_t i = 0; i < burst; i++) {
+        q->pop(e);
+      }
+      benchmark::DoNotOptimize(e);
+      n_ops += burst;
+    }
+    uint64_t n = n_alloc.load(std::memory_order_relaxed) - before;
+    s.counters["allocs_per_1M"] = static_cast<double>(n) * 1e6 / n_ops;
+    s.SetItemsProcessed(static_cast<int64_t>(n_ops));
+  }
+};
+
+template <typename Queue, uint32_t MaxRetained>
+class Retained : public Queue {
+ public:
+  Retained() : Queue(MaxRetained) {}
+  ~Retained() = default;
+};
+
+using UnboundedSPSC = toolbox::container::UnboundedSPSCQueue<uint64_t>;
+using UnboundedSPSC4Retained = Retained<UnboundedSPSC, 4>;
+using SmallBlockUnboundedSPSC = toolbox::container::UnboundedSPSCQueue<uint64_t, 16>;
+using UnboundedMPMC = toolbox::container::UnboundedMPMCQueue<uint64_t>;
+
+#define BenchName(q) #q "AllocBench"
+#define Bench(q)                         \
+  namespace q##Bench {                   \
+    using Benchmark = AllocBench<q>;     \
+    BENCHMARK_DEFINE_F(Benchmark, Run)   \
+    (::benchmark::State & s) { run(s); } \
+    BENCHMARK_REGISTER_F(Benchmark, Run) \
+        ->Name(BenchName(q))             \
+        ->Arg(1)                         \
+        ->Arg(1 << 10)                   \
+        ->Arg(1 << 16);                  \
+  }
+
+Bench(UnboundedSPSC);
+Bench(UnboundedSPSC4Retained);
+Bench(SmallBlockUnboundedSPSC);
+Bench(UnboundedMPMC);
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "util/perf_counter.hh"
+#include "util/topology.hh"
+
+/// Give a queue of dynamic_size a default constructor, so that it can be benchmarked by
+/// the same fixtures as the queues sized at compile time.
+template <typename Queue, uint32_t Capacity>
+class RuntimeSized : public Queue {
+ public:
+  RuntimeSized() : Queue(Capacity) {}
+  ~RuntimeSized() = default;
+};
+
+/// Pin the calling thread of a benchmark to its cpu of the placement `p`, until the
+/// returned guard is destroyed. All the threads pick the same cpus, so if the machine has
+/// none, they all skip the benchmark and get nullptr.
+inline auto place(::benchmark::State& s, toolbox::util::Placement p)
+    -> std::unique_ptr<toolbox::util::ScopedAffinity> {
+  auto cpus = toolbox::util::Topology::instance().pick(p, s.threads());
+  if (cpus.empty()) {
+    s.SkipWithError(fmt::format("no cpus for {} threads as {}", s.threads(),
+                                toolbox::util::toString(p))
+                        .c_str());
+    return nullptr;
+  }
+  return std::make_unique<toolbox::util::ScopedAffinity>(cpus[s.thread_index()]);
+}
+
+/// Count the hardware events of the calling thread of a benchmark from construction to
+/// report(), which adds them as user counters per iteration. Counters are summed over
+/// the threads, and so are the iterations. Nothing is reported without perf.
+class PerfRegion {
+ public:
+  using Event = toolbox::util::PerfCounters::Event;
+
+  explicit PerfRegion(const std::vector<Event>& events = defaultEvents())
+      : counters_(events) {
+    counters_.start();
+  }
+
+  static auto defaultEvents() -> std::vector<Event> {
+    return toolbox::util::PerfCounters::defaultEvents();
+  }
+
+  auto report(::benchmark::State& s) -> void {
+    counters_.stop();
+    for (auto& [name, value] : counters_.read()) {
+      s.counters[name] =
+          ::benchmark::Counter(value, ::benchmark::Counter::kAvgIterations);
+    }
+  }
+
+ private:
+  toolbox::util::PerfCounters counters_;
+};
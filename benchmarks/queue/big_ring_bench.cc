@@ -0,0 +1,93 @@
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "bench_util.hh"
+#include "memory/page_alloc.hh"
+#include "queue/mpmc.hh"
+#include "queue/spsc.hh"
+
+/// A message of a cache line.
+class Msg {
+ public:
+  uint64_t seq_{0};
+  uint64_t payload_[7]{};
+};
+
+/// 1M slots of Msg, i.e. a ring of 64M, which sweeps far more pages than the dTLB covers
+/// unless the pages are huge.
+constexpr uint32_t ring_size = 1 << 20;
+
+/// Push a burst of s.range(0) messages, then pop them all, so that the ring is walked
+/// round and round a burst at a time.
+template <typename Queue>
+class BigRingBench : public ::benchmark::Fixture {
+ public:
+  static auto events() -> std::vector<PerfRegion::Event> {
+    auto events = PerfRegion::defaultEvents();
+    events.push_back({"dtlb-misses", PERF_TYPE_HW_CACHE,
+                      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)});
+    return events;
+  }
+
+  auto run(::benchmark::State& s) -> void {
+    auto burst = static_cast<uint64_t>(s.range(0));
+    auto q = std::make_unique<Queue>();
+    uint64_t n_ops = 0;
+    PerfRegion perf(events());
+    for (auto _ : s) {
+      Msg m;
+      for (uint64_t i = 0; i < burst; i++) {
+        m.seq_ = i;
+        q->push(m);
+      }
+      for (uint64_t i = 0; i < burst; i++) {
+        q->pop(m);
+      }
+      benchmark::DoNotOptimize(m);
+      n_ops += burst;
+    }
+    perf.report(s);
+    s.SetItemsProcessed(static_cast<int64_t>(n_ops));
+  }
+};
+
+template <typename Alloc>
+using SPSC =
+    toolbox::container::Queue<Msg, ring_size, toolbox::container::QueueMode::SPSC,
+                              toolbox::util::SpinWait, toolbox::container::NoMetrics,
+                              Alloc>;
+template <typename Alloc>
+using BoundedSPSC =
+    toolbox::container::BoundedSPSCQueue<Msg, ring_size, toolbox::util::SpinWait, Alloc>;
+
+using HeapSPSC = SPSC<toolbox::memory::HeapAlloc>;
+using MmapSPSC = SPSC<toolbox::memory::MmapAlloc<toolbox::memory::Pages::Normal>>;
+using HugePageSPSC = SPSC<toolbox::memory::HugePageAlloc>;
+using HeapBoundedSPSC = BoundedSPSC<toolbox::memory::HeapAlloc>;
+using MmapBoundedSPSC =
+    BoundedSPSC<toolbox::memory::MmapAlloc<toolbox::memory::Pages::Normal>>;
+using HugePageBoundedSPSC = BoundedSPSC<toolbox::memory::HugePageAlloc>;
+
+#define BenchName(q) #q "BigRingBench"
+#define Bench(q)                         \
+  namespace q##Bench {                   \
+    using Benchmark = BigRingBench<q>;   \
+    BENCHMARK_DEFINE_F(Benchmark, Run)   \
+    (::benchmark::State & s) { run(s); } \
+    BENCHMARK_REGISTER_F(Benchmark, Run) \
+        ->Name(BenchName(q))             \
+        ->Arg(1 << 6)                    \
+        ->Arg(1 << 12)                   \
+        ->Arg(1 << 18);                  \
+  }
+
+Bench(HeapSPSC);
+Bench(MmapSPSC);
+Bench(HugePageSPSC);
+Bench(HeapBoundedSPSC);
+Bench(MmapBoundedSPSC);
+Bench(HugePageBoundedSPSC);
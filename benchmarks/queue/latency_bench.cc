@@ -0,0 +1,285 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <memory>
+#include <thread>
+
+#include "bench_util.hh"
+#include "queue/mpmc.hh"
+#include "queue/spsc.hh"
+#include "util/concurrent_statistics.hh"
+#include "util/timer.hh"
+
+using toolbox::util::TscClock;
+using toolbox::util::tscp;
+
+/// Each element is the tscp() at which it was pushed, or was due to be pushed, and the
+/// consumers record the delay to its pop, in cycles. (2 ^ 24 - 1) * 64 cycles are about
+/// 0.3s at 3GHz, a delay beyond counts as the upper bound.
+///
+/// Notice:
+///     The stamps of two cpus are only comparable with an invariant and synchronized
+///     TSC, which TscClock::invariant() tells.
+class LatencyFixture : public ::benchmark::Fixture {
+ public:
+  using Delays = toolbox::util::ConcurrentStatistics<24, 64>;
+
+ protected:
+  /// A new histogram for each run, before the first iteration, which all the threads
+  /// start together.
+  auto begin(::benchmark::State& s) -> void {
+    if (s.thread_index() == 0) delays_ = std::make_unique<Delays>();
+  }
+
+  /// Report the delays in ns, after the last iteration, which all the threads end
+  /// together. Counters are summed over the threads, so only the first one sets them.
+  auto end(::benchmark::State& s) -> void {
+    if (s.thread_index() != 0) return;
+    auto delays = delays_->snapshot();
+    auto p = delays.percentiles(std::array<double, 3>{0.5, 0.99, 0.999});
+    s.counters["p50"] = static_cast<double>(TscClock::toNanos(p[0]));
+    s.counters["p99"] = static_cast<double>(TscClock::toNanos(p[1]));
+    s.counters["p999"] = static_cast<double>(TscClock::toNanos(p[2]));
+    s.counters["max"] = static_cast<double>(TscClock::toNanos(delays.max()));
+  }
+
+  template <typename Consumer>
+  auto consume(Consumer& c) -> void {
+    uint64_t stamp = 0;
+    while (not c.pop(stamp)) {
+      toolbox::misc::pause();
+    }
+    delays_->record(tscp() - stamp);
+  }
+
+ protected:
+  std::unique_ptr<Delays> delays_;
+};
+
+/// Producers push as fast as they can, so the delays include the queueing behind a full
+/// queue, but a producer blocked by a stall does not push the elements which would have
+/// waited for it, i.e. the coordinated omission, see OpenLoopLatency.
+template <typename Queue>
+class ClosedLoopLatency : public LatencyFixture {
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    auto c = q_.consumer();
+    while (s.KeepRunningBatch(s.threads() >> 1)) {
+      consume(c);
+    }
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    auto p = q_.producer();
+    while (s.KeepRunningBatch(s.threads() >> 1)) {
+      uint64_t stamp = tscp();
+      while (not p.push(stamp)) {
+        toolbox::misc::pause();
+      }
+    }
+  }
+
+ private:
+  Queue q_{};
+};
+
+/// Producers push at a fixed rate, s.range(0) elements per second over all of them, and
+/// stamp each element with the time it is due instead of the time it is pushed, so a
+/// stall delays every element scheduled during it.
+template <typename Queue>
+class OpenLoopLatency : public LatencyFixture {
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    auto c = q_.consumer();
+    while (s.KeepRunningBatch(s.threads() >> 1)) {
+      consume(c);
+    }
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    auto p = q_.producer();
+    auto interval = static_cast<uint64_t>(TscClock::cyclesPerNano() * 1e9 *
+                                          (s.threads() >> 1) / s.range(0));
+    uint64_t due = 0;
+    while (s.KeepRunningBatch(s.threads() >> 1)) {
+      if (due == 0) {
+        // the schedule starts once all the threads are running
+        due = tscp();
+      }
+      while (tscp() < due) {
+        toolbox::misc::pause();
+      }
+      while (not p.push(due)) {
+        toolbox::misc::pause();
+      }
+      due += interval;
+    }
+  }
+
+ private:
+  Queue q_{};
+};
+
+/// A round trip through two queues, the first thread sends its stamp, the second one
+/// echoes it back, so the delays are round trips with a single element in flight.
+template <typename Queue>
+class PingPongLatency : public LatencyFixture {
+ public:
+  auto ping(::benchmark::State& s) -> void {
+    auto p = to_.producer();
+    auto c = from_.consumer();
+    while (s.KeepRunning()) {
+      uint64_t stamp = tscp();
+      while (not p.push(stamp)) {
+        toolbox::misc::pause();
+      }
+      consume(c);
+    }
+  }
+
+  auto pong(::benchmark::State& s) -> void {
+    auto c = to_.consumer();
+    auto p = from_.producer();
+    while (s.KeepRunning()) {
+      uint64_t stamp = 0;
+      while (not c.pop(stamp)) {
+        toolbox::misc::pause();
+      }
+      while (not p.push(stamp)) {
+        toolbox::misc::pause();
+      }
+    }
+  }
+
+ private:
+  Queue to_{};
+  Queue from_{};
+};
+
+using BoundedSPSC = toolbox::container::BoundedSPSCQueue<uint64_t, 1024>;
+using SPSCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::SPSC>;
+using MPMCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC>;
+using MPMC_HTSMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_HTS>;
+using MPMC_RTSMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_RTS>;
+
+// a single producer and a single consumer for the SPSC queues, pairs of them otherwise
+#define SingleThreads Threads(2)
+#define MultiThreads ThreadRange(2, std::thread::hardware_concurrency())
+
+#define LatencyBenchName(q) #q "LatencyBench"
+#define LatencyBench(q, threads)            \
+  namespace q##LatencyBench {               \
+    using Benchmark = ClosedLoopLatency<q>; \
+    BENCHMARK_DEFINE_F(Benchmark, Run)      \
+    (::benchmark::State & s) {              \
+      begin(s);                             \
+      if (s.thread_index() % 2 == 0) {      \
+        consumer(s);                        \
+      } else {                              \
+        producer(s);                        \
+      }                                     \
+      end(s);                               \
+    }                                       \
+    BENCHMARK_REGISTER_F(Benchmark, Run)    \
+        ->Name(LatencyBenchName(q))         \
+        ->Iterations(1 << 22)               \
+        ->threads                           \
+        ->UseRealTime();                    \
+  }
+
+LatencyBench(BoundedSPSC, SingleThreads);
+LatencyBench(SPSCMode, SingleThreads);
+LatencyBench(MPMCMode, MultiThreads);
+LatencyBench(MPMC_HTSMode, MultiThreads);
+LatencyBench(MPMC_RTSMode, MultiThreads);
+
+#define OpenLoopBenchName(q) #q "OpenLoopBench"
+#define OpenLoopBench(q, threads)         \
+  namespace q##OpenLoopBench {            \
+    using Benchmark = OpenLoopLatency<q>; \
+    BENCHMARK_DEFINE_F(Benchmark, Run)    \
+    (::benchmark::State & s) {            \
+      begin(s);                           \
+      if (s.thread_index() % 2 == 0) {    \
+        consumer(s);                      \
+      } else {                            \
+        producer(s);                      \
+      }                                   \
+      end(s);                             \
+    }                                     \
+    BENCHMARK_REGISTER_F(Benchmark, Run)  \
+        ->Name(OpenLoopBenchName(q))      \
+        ->Iterations(1 << 18)             \
+        ->Arg(100'000)                    \
+        ->Arg(1'000'000)                  \
+        ->threads                         \
+        ->UseRealTime();                  \
+  }
+
+OpenLoopBench(BoundedSPSC, SingleThreads);
+OpenLoopBench(SPSCMode, SingleThreads);
+OpenLoopBench(MPMCMode, MultiThreads);
+OpenLoopBench(MPMC_HTSMode, MultiThreads);
+OpenLoopBench(MPMC_RTSMode, MultiThreads);
+
+#define PingPongBenchName(q) #q "PingPongBench"
+#define PingPongBench(q)                  \
+  namespace q##PingPongBench {            \
+    using Benchmark = PingPongLatency<q>; \
+    BENCHMARK_DEFINE_F(Benchmark, Run)    \
+    (::benchmark::State & s) {            \
+      begin(s);                           \
+      if (s.thread_index() == 0) {        \
+        ping(s);                          \
+      } else {                            \
+        pong(s);                          \
+      }                                   \
+      end(s);                             \
+    }                                     \
+    BENCHMARK_REGISTER_F(Benchmark, Run)  \
+        ->Name(PingPongBenchName(q))      \
+        ->Iterations(1 << 20)             \
+        ->Threads(2)                      \
+        ->UseRealTime();                  \
+  }
+
+PingPongBench(BoundedSPSC);
+PingPongBench(SPSCMode);
+PingPongBench(MPMCMode);
+PingPongBench(MPMC_HTSMode);
+PingPongBench(MPMC_RTSMode);
+
+// the round trip between the cpus of a placement, tagged with it
+#define PlacedPingPongBenchName(q, placement) #q "PingPongBench/" #placement
+#define PlacedPingPongBench(q, placement)                          \
+  namespace q##placement##PingPongBench {                          \
+    using Benchmark = PingPongLatency<q>;                          \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                             \
+    (::benchmark::State & s) {                                     \
+      auto pinned = place(s, toolbox::util::Placement::placement); \
+      if (pinned == nullptr) return;                               \
+      begin(s);                                                    \
+      if (s.thread_index() == 0) {                                 \
+        ping(s);                                                   \
+      } else {                                                     \
+        pong(s);                                                   \
+      }                                                            \
+      end(s);                                                      \
+    }                                                              \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                           \
+        ->Name(PlacedPingPongBenchName(q, placement))              \
+        ->Iterations(1 << 20)                                      \
+        ->Threads(2)                                               \
+        ->UseRealTime();                                           \
+  }
+
+PlacedPingPongBench(BoundedSPSC, SMTSiblings);
+PlacedPingPongBench(BoundedSPSC, SameL3);
+PlacedPingPongBench(BoundedSPSC, CrossNUMA);
+PlacedPingPongBench(MPMCMode, SMTSiblings);
+PlacedPingPongBench(MPMCMode, SameL3);
+PlacedPingPongBench(MPMCMode, CrossNUMA);
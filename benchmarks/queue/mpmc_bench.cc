@@ -1,9 +1,13 @@
 #include <benchmark/benchmark.h>
 
+#include <algorithm>
+#include <array>
 #include <random>
 
+#include "bench_util.hh"
 #include "dummy_queue.hh"
 #include "queue/mpmc.hh"
+#include "queue/unbounded_mpmc.hh"
 
 template <typename T>
 class TestData {
@@ -38,22 +42,26 @@ class MPMCBench : public ::benchmark::Fixture {
  public:
   auto consumer(::benchmark::State& s) -> void {
     auto c = q_.consumer();
+    PerfRegion perf;
     while (s.KeepRunningBatch(s.threads() >> 1)) {
       ValueType src;
       while (not c.pop(src)) {
         toolbox::misc::pause();
       }
     }
+    perf.report(s);
   }
 
   auto producer(::benchmark::State& s) -> void {
     auto p = q_.producer();
+    PerfRegion perf;
     ValueType dst = TestData<ValueType>::generate();
     while (s.KeepRunningBatch(s.threads() >> 1)) {
       while (not p.push(dst)) {
         toolbox::misc::pause();
       }
     }
+    perf.report(s);
   }
 
  private:
@@ -61,14 +69,131 @@ class MPMCBench : public ::benchmark::Fixture {
   std::atomic_int ready_{0};
 };
 
+template <typename Queue, uint32_t Batch>
+class MPMCBurstBench : public ::benchmark::Fixture {
+  using ValueType = typename Queue::ValueType;
+
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    auto c = q_.consumer();
+    PerfRegion perf;
+    std::array<ValueType, Batch> dst;
+    uint32_t n = 0;
+    while (s.KeepRunningBatch(Batch * (s.threads() >> 1))) {
+      for (uint32_t got = 0; got < Batch; got += n) {
+        while ((n = c.popBurst(dst.begin(), Batch - got)) == 0) {
+          toolbox::misc::pause();
+        }
+      }
+    }
+    perf.report(s);
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    auto p = q_.producer();
+    PerfRegion perf;
+    std::array<ValueType, Batch> src;
+    src.fill(TestData<ValueType>::generate());
+    while (s.KeepRunningBatch(Batch * (s.threads() >> 1))) {
+      while (not p.pushBulk(src.begin(), Batch)) {
+        toolbox::misc::pause();
+      }
+    }
+    perf.report(s);
+  }
+
+ private:
+  Queue q_{};
+};
+
+/// One thread on the single side against the others, e.g. a fan-in of producers into a
+/// single consumer.
+///
+/// Notice:
+///     Every thread counts batches of threads - 1 iterations, the single side moving
+///     one element per iteration and the others one per batch, so that both sides move
+///     the same number of elements even when the last batch passes the iterations.
+template <typename Queue, bool FanIn>
+class MPMCFanBench : public ::benchmark::Fixture {
+  using ValueType = typename Queue::ValueType;
+
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    auto c = q_.consumer();
+    PerfRegion perf;
+    const int fan = s.threads() - 1;
+    while (s.KeepRunningBatch(fan)) {
+      for (int i = 0; i < (FanIn ? fan : 1); i++) {
+        ValueType src;
+        while (not c.pop(src)) {
+          toolbox::misc::pause();
+        }
+      }
+    }
+    perf.report(s);
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    auto p = q_.producer();
+    PerfRegion perf;
+    ValueType dst = TestData<ValueType>::generate();
+    const int fan = s.threads() - 1;
+    while (s.KeepRunningBatch(fan)) {
+      for (int i = 0; i < (FanIn ? 1 : fan); i++) {
+        while (not p.push(dst)) {
+          toolbox::misc::pause();
+        }
+      }
+    }
+    perf.report(s);
+  }
+
+ private:
+  Queue q_{};
+};
+
 using MPMCMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC>;
+using MPSCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPSC>;
+using SPMCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::SPMC>;
 using MPMC_HTSMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_HTS>;
 using MPMC_RTSMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_RTS>;
+using MPMC_SEQMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_SEQ>;
+// the same queues with a cache line per slot, see queue/layout.hh
+template <toolbox::container::QueueMode Mode>
+using Padded =
+    toolbox::container::Queue<uint64_t, 1024, Mode, toolbox::util::SpinWait,
+                              toolbox::container::NoMetrics, toolbox::memory::HeapAlloc,
+                              toolbox::container::PaddedLayout>;
+using PaddedMPMCMode = Padded<toolbox::container::QueueMode::MPMC>;
+using PaddedMPMC_SEQMode = Padded<toolbox::container::QueueMode::MPMC_SEQ>;
+// the same queue with the instrumentation of queue/metrics.hh enabled
+using InstrumentedMPMCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC,
+                              toolbox::util::SpinWait,
+                              toolbox::container::QueueMetrics<>>;
+using UnboundedMPMC = toolbox::container::UnboundedMPMCQueue<uint64_t>;
 using Dummy = DummyQueue<uint64_t>;
 
+using toolbox::container::dynamic_size;
+using DynamicMPMCMode =
+    RuntimeSized<toolbox::container::Queue<uint64_t, dynamic_size,
+                                           toolbox::container::QueueMode::MPMC>,
+                 1024>;
+using DynamicMPMC_HTSMode =
+    RuntimeSized<toolbox::container::Queue<uint64_t, dynamic_size,
+                                           toolbox::container::QueueMode::MPMC_HTS>,
+                 1024>;
+using DynamicMPMC_RTSMode =
+    RuntimeSized<toolbox::container::Queue<uint64_t, dynamic_size,
+                                           toolbox::container::QueueMode::MPMC_RTS>,
+                 1024>;
+
 #define BenchName(q) #q "Bench"
 #define Bench(q)                                              \
   namespace q##Bench {                                        \
@@ -89,5 +214,131 @@ using Dummy = DummyQueue<uint64_t>;
   }
 
 Bench(MPMCMode);
+Bench(InstrumentedMPMCMode);
 Bench(MPMC_HTSMode);
-Bench(MPMC_RTSMode);
\ No newline at end of file
+Bench(MPMC_RTSMode);
+Bench(MPMC_SEQMode);
+Bench(PaddedMPMCMode);
+Bench(PaddedMPMC_SEQMode);
+Bench(DynamicMPMCMode);
+Bench(DynamicMPMC_HTSMode);
+Bench(DynamicMPMC_RTSMode);
+Bench(UnboundedMPMC);
+
+#define BurstBenchName(q, batch) #q "Burst" #batch "Bench"
+#define BurstBench(q, batch)                                  \
+  namespace q##Burst##batch##Bench {                          \
+    using Benchmark = MPMCBurstBench<q, batch>;               \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                        \
+    (::benchmark::State & s) {                                \
+      if (s.thread_index() % 2 == 0) {                        \
+        consumer(s);                                          \
+      } else {                                                \
+        producer(s);                                          \
+      }                                                       \
+    }                                                         \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                      \
+        ->Name(BurstBenchName(q, batch))                      \
+        ->Iterations(1 << 24)                                 \
+        ->ThreadRange(2, std::thread::hardware_concurrency()) \
+        ->UseRealTime();                                      \
+  }
+
+BurstBench(MPMCMode, 32);
+BurstBench(MPMC_HTSMode, 32);
+BurstBench(MPMC_RTSMode, 32);
+BurstBench(MPMC_SEQMode, 32);
+// a burst writes whole lines anyway, padding only spreads it
+BurstBench(PaddedMPMCMode, 32);
+
+#define FanBenchName(q, fan) #q #fan "Bench"
+#define FanBench(q, fan, fan_in)                              \
+  namespace q##fan##Bench {                                   \
+    using Benchmark = MPMCFanBench<q, fan_in>;                \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                        \
+    (::benchmark::State & s) {                                \
+      if ((s.thread_index() == 0) == fan_in) {                \
+        consumer(s);                                          \
+      } else {                                                \
+        producer(s);                                          \
+      }                                                       \
+    }                                                         \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                      \
+        ->Name(FanBenchName(q, fan))                          \
+        ->Iterations(1 << 24)                                 \
+        ->ThreadRange(2, std::thread::hardware_concurrency()) \
+        ->UseRealTime();                                      \
+  }
+
+// what the single threaded side saves over MPMC
+FanBench(MPSCMode, FanIn, true);
+FanBench(MPMCMode, FanIn, true);
+FanBench(SPMCMode, FanOut, false);
+FanBench(MPMCMode, FanOut, false);
+
+// the same pairs of threads pinned as the placement, tagged with it
+#define PlacedBenchName(q, placement) #q "Bench/" #placement
+#define PlacedBench(q, placement)                                  \
+  namespace q##placement##Bench {                                  \
+    using Benchmark = MPMCBench<q>;                                \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                             \
+    (::benchmark::State & s) {                                     \
+      auto pinned = place(s, toolbox::util::Placement::placement); \
+      if (pinned == nullptr) return;                               \
+      if (s.thread_index() % 2 == 0) {                             \
+        consumer(s);                                               \
+      } else {                                                     \
+        producer(s);                                               \
+      }                                                            \
+    }                                                              \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                           \
+        ->Name(PlacedBenchName(q, placement))                      \
+        ->Iterations(1 << 24)                                      \
+        ->ThreadRange(2, std::thread::hardware_concurrency())      \
+        ->UseRealTime();                                           \
+  }
+
+PlacedBench(MPMCMode, SMTSiblings);
+PlacedBench(MPMCMode, SameL3);
+PlacedBench(MPMCMode, CrossNUMA);
+PlacedBench(MPMC_HTSMode, SMTSiblings);
+PlacedBench(MPMC_HTSMode, SameL3);
+PlacedBench(MPMC_HTSMode, CrossNUMA);
+PlacedBench(MPMC_RTSMode, SMTSiblings);
+PlacedBench(MPMC_RTSMode, SameL3);
+PlacedBench(MPMC_RTSMode, CrossNUMA);
+PlacedBench(MPMC_SEQMode, SMTSiblings);
+PlacedBench(MPMC_SEQMode, SameL3);
+PlacedBench(MPMC_SEQMode, CrossNUMA);
+PlacedBench(PaddedMPMCMode, SMTSiblings);
+PlacedBench(PaddedMPMCMode, SameL3);
+PlacedBench(PaddedMPMCMode, CrossNUMA);
+
+// more threads than cpus, so that threads are preempted between their claim and their
+// publish, which stalls the other threads of a side in MPMC mode but not in MPMC_SEQ
+#define OversubscribedBenchName(q) #q "OversubscribedBench"
+#define OversubscribedBench(q)                                           \
+  namespace q##OversubscribedBench {                                     \
+    using Benchmark = MPMCBench<q>;                                      \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                                   \
+    (::benchmark::State & s) {                                           \
+      if (s.thread_index() % 2 == 0) {                                   \
+        consumer(s);                                                     \
+      } else {                                                           \
+        producer(s);                                                     \
+      }                                                                  \
+    }                                                                    \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                                 \
+        ->Name(OversubscribedBenchName(q))                               \
+        ->Iterations(1 << 20)                                            \
+        ->Threads(std::max(2U, std::thread::hardware_concurrency()) * 2) \
+        ->Threads(std::max(2U, std::thread::hardware_concurrency()) * 4) \
+        ->UseRealTime();                                                 \
+  }
+
+OversubscribedBench(MPMCMode);
+OversubscribedBench(MPMC_HTSMode);
+OversubscribedBench(MPMC_RTSMode);
+OversubscribedBench(MPMC_SEQMode);
+OversubscribedBench(PaddedMPMCMode);
+OversubscribedBench(PaddedMPMC_SEQMode);
@@ -0,0 +1,133 @@
+#include <benchmark/benchmark.h>
+
+#include <array>
+#include <memory>
+#include <thread>
+
+#include "queue/mpmc.hh"
+#include "queue/multicast.hh"
+
+/// One producer hands every element to each of the other threads.
+template <typename Queue>
+class MulticastFanOutBench : public ::benchmark::Fixture {
+  using ConsumerType = typename Queue::ConsumerType;
+
+ public:
+  auto SetUp(const ::benchmark::State& s) -> void override {
+    if (s.thread_index() != 0) return;
+    q_ = std::make_unique<Queue>();
+    for (int i = 1; i < s.threads(); i++) {
+      consumers_[i].reset(new ConsumerType(*q_, {}));
+    }
+    ready_.store(true, std::memory_order_release);
+  }
+
+  auto TearDown(const ::benchmark::State& s) -> void override {
+    if (s.thread_index() != 0) return;
+    ready_.store(false, std::memory_order_relaxed);
+    for (auto& c : consumers_) {
+      c.reset();
+    }
+    q_.reset();
+  }
+
+  auto consumer(::benchmark::State& s) -> void {
+    waitReady();
+    auto& c = *consumers_[s.thread_index()];
+    uint64_t sum = 0;
+    for (auto _ : s) {
+      while (c.poll([&sum](const uint64_t& e, uint32_t, bool) { sum += e; }, 1) == 0) {
+        toolbox::misc::pause();
+      }
+    }
+    benchmark::DoNotOptimize(sum);
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    waitReady();
+    auto p = q_->producer();
+    uint64_t i = 0;
+    for (auto _ : s) {
+      while (not p.push(i)) {
+        toolbox::misc::pause();
+      }
+      i++;
+    }
+  }
+
+ private:
+  auto waitReady() -> void {
+    while (not ready_.load(std::memory_order_acquire)) {
+      toolbox::misc::pause();
+    }
+  }
+
+ private:
+  std::unique_ptr<Queue> q_{};
+  std::array<std::unique_ptr<ConsumerType>, Queue::max_consumer> consumers_{};
+  std::atomic_bool ready_{false};
+};
+
+/// The same fan-out by copying every element into one queue per consumer.
+template <typename Queue, uint32_t MaxConsumer>
+class CopyFanOutBench : public ::benchmark::Fixture {
+  using ValueType = typename Queue::ValueType;
+
+ public:
+  auto consumer(::benchmark::State& s) -> void {
+    auto c = qs_[s.thread_index()].consumer();
+    ValueType e;
+    for (auto _ : s) {
+      while (not c.pop(e)) {
+        toolbox::misc::pause();
+      }
+    }
+  }
+
+  auto producer(::benchmark::State& s) -> void {
+    std::array<std::unique_ptr<typename Queue::ProducerType>, MaxConsumer> ps{};
+    for (int i = 1; i < s.threads(); i++) {
+      ps[i].reset(new typename Queue::ProducerType(qs_[i]));
+    }
+    ValueType e{};
+    for (auto _ : s) {
+      for (int i = 1; i < s.threads(); i++) {
+        while (not ps[i]->push(e)) {
+          toolbox::misc::pause();
+        }
+      }
+      e++;
+    }
+  }
+
+ private:
+  std::array<Queue, MaxConsumer> qs_{};
+};
+
+using Multicast = toolbox::container::MulticastQueue<uint64_t, 1024>;
+using SPSCCopy = toolbox::container::Queue<uint64_t, 1024, toolbox::container::SPSC>;
+using MulticastFixture = MulticastFanOutBench<Multicast>;
+using SPSCCopyFixture = CopyFanOutBench<SPSCCopy, Multicast::max_consumer>;
+
+#define BenchName(q) #q "FanOutBench"
+#define Bench(q, fixture)                                     \
+  namespace q##Bench {                                        \
+    using Benchmark = fixture;                                \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                        \
+    (::benchmark::State & s) {                                \
+      if (s.thread_index() == 0) {                            \
+        producer(s);                                          \
+      } else {                                                \
+        consumer(s);                                          \
+      }                                                       \
+    }                                                         \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                      \
+        ->Name(BenchName(q))                                  \
+        ->Iterations(1 << 22)                                 \
+        ->ThreadRange(2, std::thread::hardware_concurrency()) \
+        ->UseRealTime();                                      \
+  }
+
+// one ring read by every consumer against one copy per consumer
+Bench(Multicast, MulticastFixture);
+Bench(SPSCCopy, SPSCCopyFixture);
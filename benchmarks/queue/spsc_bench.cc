@@ -1,5 +1,6 @@
 #include <benchmark/benchmark.h>
 
+#include "bench_util.hh"
 #include "dummy_queue.hh"
 #include "queue/mpmc.hh"
 #include "queue/spsc.hh"
@@ -12,20 +13,24 @@ class SPSCBench : public ::benchmark::Fixture {
 
  public:
   auto consumer(::benchmark::State& s) -> void {
+    PerfRegion perf;
     while (s.KeepRunning()) {
       ValueType got;
       while (not c_.pop(got)) {
         toolbox::misc::pause();
       }
     }
+    perf.report(s);
   }
   auto producer(::benchmark::State& s) -> void {
+    PerfRegion perf;
     while (s.KeepRunning()) {
       ValueType e = 0xF0F0F0F0;
       while (not p_.push(e)) {
         toolbox::misc::pause();
       }
     }
+    perf.report(s);
   }
 
  private:
@@ -40,12 +45,28 @@ using SPSCMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::SPSC>;
 using MPMCMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC>;
+using MPSCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPSC>;
+using SPMCMode =
+    toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::SPMC>;
 using MPMC_HTSMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_HTS>;
 using MPMC_RTSMode =
     toolbox::container::Queue<uint64_t, 1024, toolbox::container::QueueMode::MPMC_RTS>;
 using Dummy = DummyQueue<uint64_t>;
 
+using toolbox::container::dynamic_size;
+using DynamicBoundedSPSC =
+    RuntimeSized<toolbox::container::BoundedSPSCQueue<uint64_t, dynamic_size>, 1024>;
+using DynamicSPSCMode =
+    RuntimeSized<toolbox::container::Queue<uint64_t, dynamic_size,
+                                           toolbox::container::QueueMode::SPSC>,
+                 1024>;
+using DynamicMPMCMode =
+    RuntimeSized<toolbox::container::Queue<uint64_t, dynamic_size,
+                                           toolbox::container::QueueMode::MPMC>,
+                 1024>;
+
 #define BenchName(q) #q "Bench"
 #define Bench(q)                         \
   namespace q##Bench {                   \
@@ -69,6 +90,11 @@ Bench(BoundedSPSC);
 Bench(UnboundedSPSC);
 Bench(SPSCMode);
 Bench(MPMCMode);
+Bench(MPSCMode);
+Bench(SPMCMode);
 Bench(MPMC_HTSMode);
 Bench(MPMC_RTSMode);
-Bench(Dummy);
\ No newline at end of file
+Bench(Dummy);
+Bench(DynamicBoundedSPSC);
+Bench(DynamicSPSCMode);
+Bench(DynamicMPMCMode);
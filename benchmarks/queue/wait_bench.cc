@@ -0,0 +1,98 @@
+#include <benchmark/benchmark.h>
+#include <time.h>
+
+#include <thread>
+
+#include "queue/spsc.hh"
+#include "util/statistics.hh"
+#include "util/timer.hh"
+#include "util/wait.hh"
+
+namespace {
+
+auto threadCpuTime() -> uint64_t {
+  timespec ts{};
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+  return ts.tv_sec * 1'000'000'000UL + ts.tv_nsec;
+}
+
+auto now() -> uint64_t {
+  return std::chrono::duration_cast<toolbox::util::nanoseconds>(
+             toolbox::util::clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+/// The producer stays idle for range(0) microseconds and then pushes a timestamp, the
+/// consumer blocks in popWait(). Reports the wake-up latency of the consumer and the
+/// fraction of a core it burned while waiting.
+template <typename Wait>
+class WaitBench : public ::benchmark::Fixture {
+  using Queue = toolbox::container::BoundedSPSCQueue<uint64_t, 1024, Wait>;
+
+ public:
+  auto run(::benchmark::State& s) -> void {
+    auto gap = toolbox::util::microseconds(s.range(0));
+    uint64_t consumer_cpu = 0;
+    latency_.reset();
+
+    toolbox::util::Timer wall;
+    wall.begin();
+    std::thread consumer([this, &consumer_cpu] {
+      auto c = q_.consumer();
+      auto begin = threadCpuTime();
+      uint64_t stamp = 0;
+      while (true) {
+        c.popWait(stamp);
+        if (stamp == 0) break;
+        latency_.record(now() - stamp);
+      }
+      consumer_cpu = threadCpuTime() - begin;
+    });
+
+    auto p = q_.producer();
+    for (auto _ : s) {
+      std::this_thread::sleep_for(gap);
+      p.pushWait(now());
+    }
+    p.pushWait(uint64_t{0});
+    consumer.join();
+    wall.end();
+
+    s.counters["wake_p50_ns"] = latency_.percentile(0.5);
+    s.counters["wake_p99_ns"] = latency_.percentile(0.99);
+    s.counters["wake_max_ns"] = latency_.max();
+    s.counters["consumer_cpu"] =
+        (double)consumer_cpu / wall.elapsed<toolbox::util::nanoseconds>();
+  }
+
+ private:
+  Queue q_{};
+  // up to (2 ^ 16 - 1) * 64 ns ~= 4 ms
+  toolbox::util::Statistics<16, 64> latency_;
+};
+
+using SpinWait = toolbox::util::SpinWait;
+using YieldWait = toolbox::util::YieldWait;
+using ParkWait = toolbox::util::ParkWait;
+
+#define BenchName(w) #w "Bench"
+#define Bench(w)                          \
+  namespace w##Bench {                    \
+    using Benchmark = WaitBench<w>;       \
+    BENCHMARK_DEFINE_F(Benchmark, Run)    \
+    (::benchmark::State & s) { run(s); }  \
+    BENCHMARK_REGISTER_F(Benchmark, Run)  \
+        ->Name(BenchName(w))              \
+        ->Arg(10)                         \
+        ->Arg(100)                        \
+        ->Arg(1000)                       \
+        ->Iterations(1 << 11)             \
+        ->Unit(::benchmark::kMicrosecond) \
+        ->UseRealTime();                  \
+  }
+
+Bench(SpinWait);
+Bench(YieldWait);
+Bench(ParkWait);
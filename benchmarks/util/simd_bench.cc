@@ -0,0 +1,56 @@
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "util/simd.hh"
+
+using namespace toolbox::util;
+
+/// The buckets of a Statistics<20, 1024>.
+constexpr size_t n_counter = 20 * 1024;
+
+template <void (*Add)(uint64_t*, const uint64_t*, size_t)>
+auto AddBench(::benchmark::State& s) -> void {
+  std::vector<uint64_t> dst(n_counter, 1);
+  std::vector<uint64_t> src(n_counter, 2);
+  for (auto _ : s) {
+    Add(dst.data(), src.data(), n_counter);
+    benchmark::ClobberMemory();
+  }
+  s.SetBytesProcessed(static_cast<int64_t>(s.iterations() * n_counter * 8));
+}
+
+template <uint64_t (*Sum)(const uint64_t*, size_t)>
+auto SumBench(::benchmark::State& s) -> void {
+  std::vector<uint64_t> src(n_counter, 2);
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(Sum(src.data(), n_counter));
+  }
+  s.SetBytesProcessed(static_cast<int64_t>(s.iterations() * n_counter * 8));
+}
+
+template <uint64_t (*PrefixSum)(const uint64_t*, uint64_t*, size_t)>
+auto PrefixSumBench(::benchmark::State& s) -> void {
+  std::vector<uint64_t> src(n_counter, 2);
+  std::vector<uint64_t> dst(n_counter);
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(PrefixSum(src.data(), dst.data(), n_counter));
+    benchmark::ClobberMemory();
+  }
+  s.SetBytesProcessed(static_cast<int64_t>(s.iterations() * n_counter * 8));
+}
+
+BENCHMARK(AddBench<addArrayScalar>)->Name("ScalarAddBench");
+BENCHMARK(SumBench<sumArrayScalar>)->Name("ScalarSumBench");
+BENCHMARK(PrefixSumBench<prefixSumScalar>)->Name("ScalarPrefixSumBench");
+
+#if defined(TOOLBOX_SIMD_X86)
+BENCHMARK(AddBench<addArraySSE2>)->Name("SSE2AddBench");
+BENCHMARK(SumBench<sumArraySSE2>)->Name("SSE2SumBench");
+BENCHMARK(PrefixSumBench<prefixSumSSE2>)->Name("SSE2PrefixSumBench");
+#endif
+
+// the kernels picked at runtime, AVX2 if supported
+BENCHMARK(AddBench<addArray>)->Name("AddBench");
+BENCHMARK(SumBench<sumArray>)->Name("SumBench");
+BENCHMARK(PrefixSumBench<prefixSum>)->Name("PrefixSumBench");
@@ -0,0 +1,191 @@
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <vector>
+
+#include "util/concurrent_statistics.hh"
+#include "util/hdr_histogram.hh"
+#include "util/statistics.hh"
+
+/// Samples below `upper`, spread over all the levels of a Statistics.
+auto Samples(uint64_t upper) -> std::vector<uint64_t> {
+  std::mt19937_64 rng(42);
+  std::vector<uint64_t> samples(1 << 12);
+  for (auto& x : samples) {
+    // log-uniform, as latencies usually are
+    x = rng() % ((upper >> (rng() % 16)) + 1);
+  }
+  return samples;
+}
+
+template <typename Statistics, uint64_t Upper>
+class RecordBench : public ::benchmark::Fixture {
+ public:
+  auto run(::benchmark::State& s) -> void {
+    auto samples = Samples(Upper + Upper / 8);
+    size_t i = 0;
+    for (auto _ : s) {
+      statistics_.record(samples[i++ & (samples.size() - 1)]);
+    }
+    benchmark::DoNotOptimize(statistics_);
+    s.SetItemsProcessed(s.iterations());
+  }
+
+ private:
+  Statistics statistics_{};
+};
+
+/// `Query` runs after each record() when `Dirty`, so that it pays for the rebuild of
+/// the cumulative counts, otherwise the counts are only built once.
+template <typename Statistics, uint64_t Upper, typename Query, bool Dirty>
+class QueryBench : public ::benchmark::Fixture {
+ public:
+  auto run(::benchmark::State& s) -> void {
+    for (auto x : Samples(Upper + Upper / 8)) {
+      statistics_.record(x);
+    }
+    for (auto _ : s) {
+      if constexpr (Dirty) {
+        statistics_.record(Upper / 2);
+      }
+      benchmark::DoNotOptimize(Query()(statistics_));
+    }
+  }
+
+ private:
+  Statistics statistics_{};
+};
+
+/// Merge per-thread statistics, as an exporter does every period.
+template <typename Statistics>
+class MergeBench : public ::benchmark::Fixture {
+ public:
+  auto run(::benchmark::State& s) -> void {
+    for (auto x : Samples(1 << 20)) {
+      shard_.record(x);
+    }
+    for (auto _ : s) {
+      total_ += shard_;
+      benchmark::DoNotOptimize(total_);
+    }
+    s.SetItemsProcessed(s.iterations());
+  }
+
+ private:
+  Statistics shard_{};
+  Statistics total_{};
+};
+
+struct Count {
+  template <typename S>
+  auto operator()(S& s) -> uint64_t {
+    return s.count();
+  }
+};
+
+struct Sum {
+  template <typename S>
+  auto operator()(S& s) -> double {
+    return s.sum();
+  }
+};
+
+struct P99 {
+  template <typename S>
+  auto operator()(S& s) -> uint64_t {
+    return s.percentile(0.99);
+  }
+};
+
+/// The percentiles of dump(), one by one.
+struct Percentiles {
+  template <typename S>
+  auto operator()(S& s) -> uint64_t {
+    return s.percentile(0.5) + s.percentile(0.9) + s.percentile(0.95) +
+           s.percentile(0.99) + s.percentile(0.999);
+  }
+};
+
+/// The percentiles of dump() in one pass.
+struct OnePassPercentiles {
+  template <typename S>
+  auto operator()(S& s) -> uint64_t {
+    auto p = s.percentiles(std::array<double, 5>{0.5, 0.9, 0.95, 0.99, 0.999});
+    return p[0] + p[1] + p[2] + p[3] + p[4];
+  }
+};
+
+struct Dump {
+  template <typename S>
+  auto operator()(S& s) -> std::string {
+    return s.dump();
+  }
+};
+
+using Small = toolbox::util::Statistics<4, 32>;
+using Large = toolbox::util::Statistics<16, 64>;
+using Huge = toolbox::util::Statistics<20, 1024>;
+using Acc = toolbox::util::AccStatistics<1024>;
+using Concurrent = toolbox::util::ConcurrentStatistics<16, 64>;
+
+/// 1ns to 1h at 3 digits
+class Hdr : public toolbox::util::HdrHistogram<> {
+ public:
+  Hdr() : HdrHistogram(1, 3600ULL * 1000 * 1000 * 1000, 3) {}
+};
+
+constexpr uint64_t small_upper = 15 * 32;
+constexpr uint64_t large_upper = ((1ULL << 16) - 1) * 64;
+constexpr uint64_t huge_upper = ((1ULL << 20) - 1) * 1024;
+constexpr uint64_t acc_upper = 1024;
+
+#define RecordBenchName(q) #q "RecordBench"
+#define RecordBenchOf(q, upper)              \
+  namespace q##RecordBench {                 \
+    using Benchmark = RecordBench<q, upper>; \
+    BENCHMARK_DEFINE_F(Benchmark, Run)       \
+    (::benchmark::State & s) { run(s); }     \
+    BENCHMARK_REGISTER_F(Benchmark, Run)     \
+        ->Name(RecordBenchName(q));          \
+  }
+
+RecordBenchOf(Small, small_upper);
+RecordBenchOf(Large, large_upper);
+RecordBenchOf(Acc, acc_upper);
+RecordBenchOf(Concurrent, large_upper);
+RecordBenchOf(Hdr, large_upper);
+
+#define QueryBenchName(q, query, kind) #q #query #kind "Bench"
+#define QueryBenchOf(q, upper, query, kind, dirty)        \
+  namespace q##query##kind##Bench {                       \
+    using Benchmark = QueryBench<q, upper, query, dirty>; \
+    BENCHMARK_DEFINE_F(Benchmark, Run)                    \
+    (::benchmark::State & s) { run(s); }                  \
+    BENCHMARK_REGISTER_F(Benchmark, Run)                  \
+        ->Name(QueryBenchName(q, query, kind));           \
+  }
+
+QueryBenchOf(Large, large_upper, Count, Cached, false);
+QueryBenchOf(Large, large_upper, Sum, Cached, false);
+QueryBenchOf(Large, large_upper, P99, Cached, false);
+QueryBenchOf(Large, large_upper, P99, Dirty, true);
+QueryBenchOf(Large, large_upper, Dump, Cached, false);
+QueryBenchOf(Small, small_upper, P99, Dirty, true);
+QueryBenchOf(Hdr, large_upper, P99, Cached, false);
+QueryBenchOf(Hdr, large_upper, Dump, Cached, false);
+QueryBenchOf(Huge, huge_upper, P99, Dirty, true);
+QueryBenchOf(Huge, huge_upper, Percentiles, Cached, false);
+QueryBenchOf(Huge, huge_upper, OnePassPercentiles, Cached, false);
+
+#define MergeBenchName(q) #q "MergeBench"
+#define MergeBenchOf(q)                  \
+  namespace q##MergeBench {              \
+    using Benchmark = MergeBench<q>;     \
+    BENCHMARK_DEFINE_F(Benchmark, Run)   \
+    (::benchmark::State & s) { run(s); } \
+    BENCHMARK_REGISTER_F(Benchmark, Run) \
+        ->Name(MergeBenchName(q));       \
+  }
+
+MergeBenchOf(Large);
+MergeBenchOf(Huge);
@@ -0,0 +1,36 @@
+#include <benchmark/benchmark.h>
+
+#include "util/timer.hh"
+
+using namespace toolbox::util;
+
+/// The cost of reading each clock once.
+static auto SteadyClockBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(clock::now());
+  }
+}
+
+static auto TscBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(tsc());
+  }
+}
+
+static auto TscpBench(::benchmark::State& s) -> void {
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(tscp());
+  }
+}
+
+static auto TscClockBench(::benchmark::State& s) -> void {
+  TscClock::now();  // calibrated out of the loop
+  for (auto _ : s) {
+    benchmark::DoNotOptimize(TscClock::now());
+  }
+}
+
+BENCHMARK(SteadyClockBench);
+BENCHMARK(TscBench);
+BENCHMARK(TscpBench);
+BENCHMARK(TscClockBench);
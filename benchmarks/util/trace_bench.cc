@@ -0,0 +1,23 @@
+#include <benchmark/benchmark.h>
+
+#include <chrono>
+
+#include "util/trace.hh"
+
+using toolbox::util::Tracer;
+
+/// The cost of a span, drained in the background as in production.
+static auto TraceScopeBench(::benchmark::State& s) -> void {
+  Tracer::enable(s.range(0) != 0);
+  Tracer::instance().start(std::chrono::milliseconds(1));
+  for (auto _ : s) {
+    TRACE_SCOPE("span");
+    benchmark::ClobberMemory();
+  }
+  Tracer::instance().stop();
+  s.counters["dropped"] = static_cast<double>(Tracer::instance().dropped());
+  Tracer::instance().clear();
+  Tracer::enable(true);
+}
+
+BENCHMARK(TraceScopeBench)->ArgName("enabled")->Arg(0)->Arg(1);
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "queue/mpmc.hh"
+#include "queue/work_stealing.hh"
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/wait.hh"
+
+namespace toolbox::executor {
+
+/// A fixed-size pool of worker threads with one work-stealing deque per worker.
+///
+/// Tasks submitted by a worker go to the bottom of its own deque, and the others to a
+/// global MPMC injection queue. A worker runs the tasks of its own deque first, then
+/// those of the injection queue, then steals from the other workers, and parks when
+/// there is nothing left to do.
+///
+/// Notice:
+///     The destructor runs all the submitted tasks before joining the workers, no task
+///     shall be submitted from outside of the pool once the destructor is called.
+class ThreadPool : public util::Noncopyable, public util::Nonmovable {
+ private:
+  class Task {
+   public:
+    Task() = default;
+    virtual ~Task() = default;
+
+   public:
+    virtual auto run() -> void = 0;
+  };
+
+  template <typename F>
+  class TaskImpl : public Task {
+   public:
+    template <typename U>
+    explicit TaskImpl(U&& f) : f_(std::forward<U>(f)) {}
+    ~TaskImpl() override = default;
+
+   public:
+    auto run() -> void override { f_(); }
+
+   private:
+    F f_;
+  };
+
+  using InjectionQueue =
+      container::Queue<Task*, container::dynamic_size, container::QueueMode::MPMC>;
+
+  class alignas(util::cache_line_size) Worker {
+   public:
+    container::WorkStealingDeque<Task*> deque_{};
+    uint64_t rng_{0};
+  };
+
+ public:
+  constexpr static uint32_t default_injection_capacity = 1 << 16;
+  constexpr static uint32_t max_worker = 1024;
+
+ public:
+  ThreadPool() : ThreadPool(std::thread::hardware_concurrency()) {}
+
+  explicit ThreadPool(uint32_t n_worker,
+                      uint32_t injection_capacity = default_injection_capacity)
+      : n_worker_(checkWorkers(n_worker)),
+        injection_(injection_capacity),
+        workers_(new Worker[n_worker]) {
+    for (uint32_t i = 0; i < n_worker; i++) {
+      workers_[i].rng_ = i + 1;
+    }
+    threads_.reserve(n_worker);
+    for (uint32_t i = 0; i < n_worker; i++) {
+      threads_.emplace_back([this, i] { work(i); });
+    }
+  }
+
+  ~ThreadPool() {
+    stop_.store(true, std::memory_order_release);
+    idle_.notify(size());
+    for (auto& t : threads_) {
+      t.join();
+    }
+  }
+
+ public:
+  /// Run f(args...) on a worker, its result or exception is handed to the future.
+  template <typename F, typename... Args>
+  auto submit(F&& f, Args&&... args)
+      -> std::future<std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>> {
+    using R = std::invoke_result_t<std::decay_t<F>, std::decay_t<Args>...>;
+    auto bound = [f = std::forward<F>(f),
+                  args = std::make_tuple(std::forward<Args>(args)...)]() mutable {
+      return std::apply(std::move(f), std::move(args));
+    };
+    std::packaged_task<R()> task(std::move(bound));
+    auto future = task.get_future();
+    schedule(new TaskImpl<std::packaged_task<R()>>(std::move(task)));
+    return future;
+  }
+
+  /// Run f() on a worker without a future, exceptions escaping f terminate the program.
+  template <typename F>
+  auto execute(F&& f) -> void {
+    schedule(new TaskImpl<std::decay_t<F>>(std::forward<F>(f)));
+  }
+
+ public:
+  [[nodiscard]] auto size() const -> uint32_t { return n_worker_; }
+
+  /// Index of the calling worker of this pool, or -1 for other threads.
+  [[nodiscard]] auto currentWorker() const -> int32_t {
+    return current_pool == this ? current_worker : -1;
+  }
+
+ private:
+  static auto checkWorkers(uint32_t n_worker) -> uint32_t {
+    if (n_worker < 1 or n_worker > max_worker) {
+      throw std::runtime_error("invalid number of workers");
+    }
+    return n_worker;
+  }
+
+  auto schedule(Task* task) -> void {
+    if (int32_t w = currentWorker(); w >= 0) {
+      workers_[w].deque_.push(task);
+    } else {
+      while (not injection_.push(task)) {
+        // the injection queue is full, let the workers drain it
+        std::this_thread::yield();
+      }
+    }
+    idle_.notify(1);
+  }
+
+  auto work(uint32_t id) -> void {
+    current_pool = this;
+    current_worker = static_cast<int32_t>(id);
+    Task* task = nullptr;
+    while (true) {
+      auto ready = [&] {
+        return (task = findTask(id)) != nullptr or stop_.load(std::memory_order_acquire);
+      };
+      idle_.waitUntil(ready, util::time_point::max());
+      if (task == nullptr) break;
+      task->run();
+      delete task;
+    }
+    current_pool = nullptr;
+    current_worker = -1;
+  }
+
+  auto findTask(uint32_t id) -> Task* {
+    Task* task = nullptr;
+    if (workers_[id].deque_.pop(task) or injection_.pop(task)) {
+      return task;
+    }
+    uint32_t n = size();
+    // start from a random victim, so that thieves do not gang up on the same worker
+    uint32_t start = static_cast<uint32_t>(nextRandom(workers_[id].rng_) % n);
+    for (uint32_t i = 0; i < n; i++) {
+      uint32_t victim = (start + i) % n;
+      if (victim != id and workers_[victim].deque_.steal(task)) {
+        return task;
+      }
+    }
+    return nullptr;
+  }
+
+  static auto nextRandom(uint64_t& x) -> uint64_t {
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    return x;
+  }
+
+ private:
+  inline static thread_local const ThreadPool* current_pool = nullptr;
+  inline static thread_local int32_t current_worker = -1;
+
+  const uint32_t n_worker_;
+  InjectionQueue injection_;
+  std::unique_ptr<Worker[]> workers_;
+  std::vector<std::thread> threads_;
+
+  alignas(util::cache_line_size) util::ParkWait idle_{};
+  std::atomic_bool stop_{false};
+};
+
+}  // namespace toolbox::executor
@@ -0,0 +1,210 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory_resource>
+#include <new>
+#include <stdexcept>
+
+#include "util/marker.hh"
+#include "util/math.hh"
+
+namespace toolbox::memory {
+
+/// A monotonic arena, which bumps a pointer through chunks taken from an upstream
+/// resource and frees nothing until it is rewound, for the many short-lived objects of
+/// a request, e.g. strings and vectors.
+///
+/// An optional initial buffer, e.g. on the stack, is used before the first chunk. A
+/// chunk is chunk_size bytes, or larger for a larger allocation. rewind() gives back all
+/// the memory allocated since a mark() and reset() all of it, while both keep the chunks
+/// for the following allocations, release() gives them back to the upstream resource.
+/// The arena is a std::pmr::memory_resource for the pmr containers, see ArenaAllocator
+/// for the other ones.
+///
+/// Notice:
+///     Not thread-safe. deallocate() does nothing, the objects of the arena shall not be
+///     used once rewound.
+class Arena : public std::pmr::memory_resource,
+              public util::Noncopyable,
+              public util::Nonmovable {
+ public:
+  constexpr static size_t default_chunk_size = 64 << 10;
+
+ private:
+  /// The header of a chunk, at the beginning of its memory.
+  class Chunk {
+   public:
+    Chunk(size_t size, bool owned) : size_(size), owned_(owned) {}
+
+   public:
+    auto begin() -> std::byte* { return reinterpret_cast<std::byte*>(this + 1); }
+    auto end() -> std::byte* { return reinterpret_cast<std::byte*>(this) + size_; }
+
+   public:
+    Chunk* next_{nullptr};
+    const size_t size_;  // including the header
+    const bool owned_;
+  };
+
+ public:
+  /// Where the arena is at a time, see rewind().
+  class Mark {
+   public:
+    Chunk* chunk_{nullptr};
+    std::byte* ptr_{nullptr};
+  };
+
+ public:
+  explicit Arena(size_t chunk_size = default_chunk_size,
+                 std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+      : chunk_size_(checkChunkSize(chunk_size)), upstream_(upstream) {}
+
+  /// Allocate from `buffer` of `size` bytes first, which shall outlive the arena.
+  Arena(void* buffer, size_t size, size_t chunk_size = default_chunk_size,
+        std::pmr::memory_resource* upstream = std::pmr::new_delete_resource())
+      : Arena(chunk_size, upstream) {
+    auto p = misc::alignUp(reinterpret_cast<uintptr_t>(buffer), alignof(Chunk));
+    auto last = reinterpret_cast<uintptr_t>(buffer) + size;
+    if (p + sizeof(Chunk) < last) {
+      head_ = new (reinterpret_cast<void*>(p)) Chunk(last - p, false);
+    }
+  }
+
+  ~Arena() override { release(); }
+
+ public:
+  /// `n` bytes aligned to `align`, which shall be a power of 2.
+  auto allocate(size_t n, size_t align = alignof(std::max_align_t)) -> void* {
+    auto p = misc::alignUp(reinterpret_cast<uintptr_t>(ptr_), align);
+    if (p + n <= reinterpret_cast<uintptr_t>(end_) and ptr_ != nullptr) {
+      ptr_ = reinterpret_cast<std::byte*>(p + n);
+      return reinterpret_cast<void*>(p);
+    }
+    return allocateSlow(n, align);
+  }
+
+  auto deallocate(void* /*p*/, size_t /*n*/, size_t /*align*/ = 0) -> void {}
+
+  auto mark() const -> Mark { return Mark{cur_, ptr_}; }
+
+  /// Give back all the memory allocated since `m`, which shall be a mark of this arena
+  /// not rewound past.
+  auto rewind(const Mark& m) -> void {
+    cur_ = m.chunk_;
+    ptr_ = m.ptr_;
+    end_ = cur_ == nullptr ? nullptr : cur_->end();
+  }
+
+  /// Give back all the memory, the chunks are kept for the following allocations.
+  auto reset() -> void { rewind(Mark{}); }
+
+  /// Give back all the memory and the chunks to the upstream resource.
+  auto release() -> void {
+    Chunk* c = head_;
+    head_ = nullptr;
+    while (c != nullptr) {
+      Chunk* next = c->next_;
+      if (c->owned_) {
+        size_t size = c->size_;
+        c->~Chunk();
+        upstream_->deallocate(c, size, alignof(std::max_align_t));
+      } else {
+        // the initial buffer stays first
+        c->next_ = nullptr;
+        head_ = c;
+      }
+      c = next;
+    }
+    footprint_ = 0;
+    reset();
+  }
+
+  /// Bytes taken from the upstream resource.
+  auto footprint() const -> size_t { return footprint_; }
+
+ private:
+  auto do_allocate(size_t n, size_t align) -> void* override {
+    return allocate(n, align);
+  }
+  auto do_deallocate(void* /*p*/, size_t /*n*/, size_t /*align*/) -> void override {}
+  auto do_is_equal(const std::pmr::memory_resource& r) const noexcept -> bool override {
+    return this == &r;
+  }
+
+  static auto checkChunkSize(size_t chunk_size) -> size_t {
+    if (chunk_size <= sizeof(Chunk)) {
+      throw std::runtime_error("chunk size of arena is too small");
+    }
+    return chunk_size;
+  }
+
+  static auto fits(Chunk* c, size_t n, size_t align) -> bool {
+    auto p = misc::alignUp(reinterpret_cast<uintptr_t>(c->begin()), align);
+    return p + n <= reinterpret_cast<uintptr_t>(c->end());
+  }
+
+  /// Move to the next chunk, the chunks before the current one are in use and the ones
+  /// after it are kept by rewind(), a new chunk goes right after the current one.
+  auto allocateSlow(size_t n, size_t align) -> void* {
+    Chunk* next = cur_ == nullptr ? head_ : cur_->next_;
+    if (next == nullptr or not fits(next, n, align)) {
+      size_t size = std::max(chunk_size_, sizeof(Chunk) + n + align);
+      void* p = upstream_->allocate(size, alignof(std::max_align_t));
+      footprint_ += size;
+      Chunk* c = new (p) Chunk(size, true);
+      c->next_ = next;
+      (cur_ == nullptr ? head_ : cur_->next_) = c;
+      next = c;
+    }
+    cur_ = next;
+    ptr_ = cur_->begin();
+    end_ = cur_->end();
+    return allocate(n, align);
+  }
+
+ private:
+  std::byte* ptr_{nullptr};
+  std::byte* end_{nullptr};
+  Chunk* cur_{nullptr};
+  Chunk* head_{nullptr};
+  const size_t chunk_size_;
+  size_t footprint_{0};
+  std::pmr::memory_resource* const upstream_;
+};
+
+/// An allocator of an Arena for the containers without pmr, e.g.
+/// std::vector<int, ArenaAllocator<int>>.
+template <typename T>
+class ArenaAllocator {
+ public:
+  using value_type = T;
+
+ public:
+  explicit ArenaAllocator(Arena& arena) noexcept : arena_(&arena) {}
+  template <typename U>
+  ArenaAllocator(const ArenaAllocator<U>& r) noexcept : arena_(&r.arena()) {}
+
+ public:
+  auto allocate(size_t n) -> T* {
+    return static_cast<T*>(arena_->allocate(n * sizeof(T), alignof(T)));
+  }
+  auto deallocate(T* /*p*/, size_t /*n*/) noexcept -> void {}
+
+  auto arena() const -> Arena& { return *arena_; }
+
+  template <typename U>
+  auto operator==(const ArenaAllocator<U>& r) const -> bool {
+    return arena_ == &r.arena();
+  }
+  template <typename U>
+  auto operator!=(const ArenaAllocator<U>& r) const -> bool {
+    return arena_ != &r.arena();
+  }
+
+ private:
+  Arena* arena_;
+};
+
+}  // namespace toolbox::memory
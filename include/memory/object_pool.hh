@@ -0,0 +1,192 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+
+#include "queue/mpmc.hh"
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/math.hh"
+#include "util/thread_id.hh"
+
+namespace toolbox::memory {
+
+template <typename T>
+class ObjectPool;
+
+/// Owns an object of an ObjectPool, and gives it back to the pool when destroyed, on
+/// whichever thread that happens.
+template <typename T>
+class PoolPtr {
+ public:
+  PoolPtr() = default;
+  /// Adopt `p`, which shall come from `pool`, e.g. after it went through a queue as a
+  /// raw pointer.
+  PoolPtr(ObjectPool<T>& pool, T* p) : pool_(&pool), p_(p) {}
+  ~PoolPtr() { reset(); }
+
+  PoolPtr(const PoolPtr&) = delete;
+  auto operator=(const PoolPtr&) -> PoolPtr& = delete;
+
+  PoolPtr(PoolPtr&& r) noexcept : pool_(r.pool_), p_(std::exchange(r.p_, nullptr)) {}
+  auto operator=(PoolPtr&& r) noexcept -> PoolPtr& {
+    if (this != &r) {
+      reset();
+      pool_ = r.pool_;
+      p_ = std::exchange(r.p_, nullptr);
+    }
+    return *this;
+  }
+
+ public:
+  auto get() const -> T* { return p_; }
+  auto operator*() const -> T& { return *p_; }
+  auto operator->() const -> T* { return p_; }
+  explicit operator bool() const { return p_ != nullptr; }
+
+  /// Give up the ownership, the object shall be handed back by ObjectPool::destroy() or
+  /// adopted by another PoolPtr.
+  auto release() -> T* { return std::exchange(p_, nullptr); }
+
+  auto reset() -> void {
+    if (p_ != nullptr) pool_->destroy(std::exchange(p_, nullptr));
+  }
+
+ private:
+  ObjectPool<T>* pool_{nullptr};
+  T* p_{nullptr};
+};
+
+/// A pool of objects of T, for objects created on a thread and destroyed on another,
+/// e.g. messages passed by pointer through a queue, which is the worst case of malloc.
+///
+/// The objects live in a single slab of `capacity` slots, each one aligned to and padded
+/// to cache lines so that two objects never share a line. Each thread allocates from and
+/// frees to its own cache of free slots, picked by util::ThreadId, without any atomic
+/// operation. A thread whose cache runs dry takes a batch of free slots from a shared
+/// MPMC queue, and a thread whose cache overflows, e.g. the consumer freeing what a
+/// producer allocated, gives a batch back to it, so the slots freed on a remote thread
+/// flow back to the allocating one lock-free and a batch at a time.
+///
+/// Notice:
+///     create() returns nullptr when no slot is left, up to 2 * batch slots per thread
+///     may sit in the caches of other threads, so the capacity shall cover them. All the
+///     objects shall be destroyed before the pool.
+template <typename T>
+class ObjectPool : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using ValueType = T;
+  using Pointer = PoolPtr<T>;
+
+  constexpr static uint32_t batch = 32;
+  constexpr static size_t slot_align = std::max(alignof(T), util::cache_line_size);
+  constexpr static size_t slot_size = misc::alignUp(sizeof(T), slot_align);
+
+ private:
+  class alignas(util::cache_line_size) Cache {
+   public:
+    std::array<void*, 2 * batch> slots_{};
+    uint32_t n_{0};
+  };
+
+ public:
+  explicit ObjectPool(uint32_t capacity)
+      : capacity_(capacity),
+        slab_(static_cast<std::byte*>(::operator new(
+            slot_size * capacity, std::align_val_t{slot_align}))),
+        free_(capacity),
+        caches_(new std::atomic<Cache*>[util::ThreadId::max_thread]) {
+    for (uint32_t i = 0; i < util::ThreadId::max_thread; i++) {
+      caches_[i].store(nullptr, std::memory_order_relaxed);
+    }
+    for (uint32_t i = 0; i < capacity_; i++) {
+      free_.push(slab_ + i * slot_size);
+    }
+  }
+
+  ~ObjectPool() {
+    for (uint32_t i = 0; i < util::ThreadId::max_thread; i++) {
+      delete caches_[i].load(std::memory_order_relaxed);
+    }
+    ::operator delete(slab_, std::align_val_t{slot_align});
+  }
+
+ public:
+  /// A new object, or nullptr if the pool is exhausted.
+  template <typename... Args>
+  auto create(Args&&... args) -> T* {
+    void* p = allocate();
+    if (p == nullptr) return nullptr;
+    try {
+      return new (p) T(std::forward<Args>(args)...);
+    } catch (...) {
+      deallocate(p);
+      throw;
+    }
+  }
+
+  /// Destroy an object of this pool, from any thread.
+  auto destroy(T* p) -> void {
+    p->~T();
+    deallocate(p);
+  }
+
+  /// create() owned by a PoolPtr, empty if the pool is exhausted.
+  template <typename... Args>
+  auto make(Args&&... args) -> Pointer {
+    return Pointer(*this, create(std::forward<Args>(args)...));
+  }
+
+ public:
+  /// A slot of slot_size bytes, or nullptr if the pool is exhausted.
+  auto allocate() -> void* {
+    Cache& cache = local();
+    if (cache.n_ == 0) {
+      cache.n_ = free_.popBurst(cache.slots_.begin(), batch);
+      if (cache.n_ == 0) return nullptr;
+    }
+    return cache.slots_[--cache.n_];
+  }
+
+  auto deallocate(void* p) -> void {
+    Cache& cache = local();
+    if (cache.n_ == cache.slots_.size()) {
+      // never fails, the queue has room for all the slots
+      cache.n_ -= batch;
+      free_.pushBulk(cache.slots_.begin() + cache.n_, batch);
+    }
+    cache.slots_[cache.n_++] = p;
+  }
+
+  auto owns(const void* p) const -> bool {
+    auto b = static_cast<const std::byte*>(p);
+    return b >= slab_ and b < slab_ + slot_size * capacity_;
+  }
+
+  auto capacity() const -> uint32_t { return capacity_; }
+
+ private:
+  auto local() -> Cache& {
+    auto& slot = caches_[util::ThreadId::get()];
+    Cache* cache = slot.load(std::memory_order_relaxed);
+    if (cache == nullptr) {
+      cache = new Cache();
+      slot.store(cache, std::memory_order_relaxed);
+    }
+    return *cache;
+  }
+
+ private:
+  const uint32_t capacity_;
+  std::byte* const slab_;
+  container::Queue<void*, container::dynamic_size, container::QueueMode::MPMC> free_;
+  std::unique_ptr<std::atomic<Cache*>[]> caches_;
+};
+
+}  // namespace toolbox::memory
@@ -0,0 +1,136 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+#include "util/align.hh"
+#include "util/math.hh"
+
+namespace toolbox::memory {
+
+/// The Alloc of a queue places its slots, e.g. Queue and BoundedSPSCQueue take one as a
+/// template parameter. An Alloc is a type with
+///     static auto allocate(size_t bytes) -> void*;
+///     static auto deallocate(void* p, size_t bytes) -> void;
+/// and throws std::bad_alloc when it runs out of memory.
+
+/// The slots on the heap, the default, aligned to cache lines so that slots padded to
+/// them do not straddle two, see queue/layout.hh.
+class HeapAlloc {
+ public:
+  static auto allocate(size_t bytes) -> void* {
+    return ::operator new[](bytes, std::align_val_t{util::cache_line_size});
+  }
+  static auto deallocate(void* p, size_t /*bytes*/) -> void {
+    ::operator delete[](p, std::align_val_t{util::cache_line_size});
+  }
+};
+
+enum class Pages {
+  Normal,       // 4K pages
+  Transparent,  // transparent huge pages, by madvise(MADV_HUGEPAGE)
+  Huge,         // MAP_HUGETLB, or transparent huge pages if none is reserved
+};
+
+/// Any node, i.e. the default policy of the kernel, which places a page on the node of
+/// the thread first touching it.
+constexpr int any_node = -1;
+
+/// The slots in their own anonymous mapping, of huge pages unless `P` is Pages::Normal,
+/// bound to the NUMA node `Node` by mbind(2) if it is not any_node, and faulted in at
+/// allocation if `Prefault`, so that the first pass over a large ring neither takes the
+/// page faults nor lands its pages on the node of whichever thread touches them first.
+///
+/// Notice:
+///     Mappings of huge pages are rounded up to 2M, a queue of a few slots wastes most
+///     of it. MAP_HUGETLB needs pages reserved in /proc/sys/vm/nr_hugepages, and the
+///     transparent ones need "madvise" or "always" in
+///     /sys/kernel/mm/transparent_hugepage/enabled, otherwise the pages stay 4K.
+template <Pages P = Pages::Huge, int Node = any_node, bool Prefault = true>
+class MmapAlloc {
+ public:
+  constexpr static size_t page_size = 4 << 10;
+  constexpr static size_t huge_page_size = 2 << 20;
+
+  static auto mappingSize(size_t bytes) -> size_t {
+    return misc::alignUp(bytes, P == Pages::Normal ? page_size : huge_page_size);
+  }
+
+ public:
+  static auto allocate(size_t bytes) -> void* {
+    size_t size = mappingSize(bytes);
+    void* p = P == Pages::Huge ? map(size, MAP_HUGETLB) : MAP_FAILED;
+    if (p == MAP_FAILED) {
+      p = P == Pages::Normal ? map(size, 0) : mapAligned(size);
+      if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+      }
+      if (P != Pages::Normal) ::madvise(p, size, MADV_HUGEPAGE);
+    }
+    if constexpr (Node != any_node) {
+      bind(p, size);
+    }
+    if constexpr (Prefault) {
+      // a write per page, so that the pages are faulted in now and under the policy
+      auto* b = static_cast<volatile std::byte*>(p);
+      for (size_t i = 0; i < size; i += page_size) {
+        b[i] = std::byte{0};
+      }
+    }
+    return p;
+  }
+
+  static auto deallocate(void* p, size_t bytes) -> void {
+    ::munmap(p, mappingSize(bytes));
+  }
+
+ private:
+  /// Not MAP_NORESERVE, so that MAP_HUGETLB fails when no huge page is left rather than
+  /// the first touch of a page raising SIGBUS.
+  static auto map(size_t size, int flags) -> void* {
+    return ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                  MAP_PRIVATE | MAP_ANONYMOUS | flags, -1, 0);
+  }
+
+  /// A mapping aligned to the huge pages, so that all of it can be backed by them.
+  static auto mapAligned(size_t size) -> void* {
+    void* raw = map(size + huge_page_size, 0);
+    if (raw == MAP_FAILED) return MAP_FAILED;
+    auto begin = reinterpret_cast<uintptr_t>(raw);
+    auto aligned = misc::alignUp(begin, huge_page_size);
+    if (aligned > begin) {
+      ::munmap(raw, aligned - begin);
+    }
+    ::munmap(reinterpret_cast<void*>(aligned + size), begin + huge_page_size - aligned);
+    return reinterpret_cast<void*>(aligned);
+  }
+
+  static auto bind(void* p, size_t size) -> void {
+    static_assert(Node >= 0 and Node < 64, "invalid NUMA node");
+    unsigned long mask = 1UL << Node;
+    if (::syscall(SYS_mbind, p, size, MPOL_BIND, &mask, sizeof(mask) * 8, 0) != 0) {
+      int err = errno;
+      ::munmap(p, size);
+      throw std::runtime_error(
+          fmt::format("fail to bind memory to node {}: {}", Node, std::strerror(err)));
+    }
+  }
+};
+
+using HugePageAlloc = MmapAlloc<Pages::Huge>;
+
+/// Huge pages of the NUMA node `Node`.
+template <int Node>
+using NumaAlloc = MmapAlloc<Pages::Huge, Node>;
+
+}  // namespace toolbox::memory
@@ -1,13 +1,21 @@
 #pragma once
 
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <new>
 #include <stdexcept>
+#include <type_traits>
+#include <utility>
 
 #include "util/marker.hh"
 
 namespace toolbox {
 namespace container {
 
+/// Size of the queues whose capacity is given at construction.
+constexpr uint32_t dynamic_size = 0;
+
 class DescriptorCounter {
  public:
   /// -1 means no limit
@@ -18,6 +26,21 @@ class DescriptorCounter {
         max_consumer_(max_consumer) {}
   ~DescriptorCounter() = default;
 
+ public:
+  /// Atomically take one of the descriptors, returns false if all are taken.
+  static auto acquire(std::atomic_int32_t& n, int32_t max) -> bool {
+    int32_t cur = n.load(std::memory_order_relaxed);
+    do {
+      if (cur == max) return false;
+    } while (not n.compare_exchange_weak(cur, cur + 1, std::memory_order_acq_rel,
+                                         std::memory_order_relaxed));
+    return true;
+  }
+
+  static auto release(std::atomic_int32_t& n) -> void {
+    n.fetch_sub(1, std::memory_order_acq_rel);
+  }
+
  public:
   std::atomic_int32_t n_producer_;
   std::atomic_int32_t n_consumer_;
@@ -25,6 +48,66 @@ class DescriptorCounter {
   int32_t max_consumer_;
 };
 
+/// A view of ring slots handed out by the zero-copy api. The slots may wrap around the
+/// end of the ring, so they are split into [first, first + firstSize) followed by
+/// [second, second + secondSize).
+///
+/// Notice:
+///     The slots are stride() bytes apart, which is more than sizeof(T) if the queue pads
+///     them, see queue/layout.hh, then first() and second() can not be walked as arrays.
+template <typename T>
+class SlotSpan {
+  using Byte = std::conditional_t<std::is_const_v<T>, const std::byte, std::byte>;
+
+ public:
+  SlotSpan() = default;
+  SlotSpan(T* first, uint32_t n_first, T* second, uint32_t n_second, uint32_t pos,
+           uint32_t stride = sizeof(T))
+      : first_(first),
+        second_(second),
+        n_first_(n_first),
+        n_second_(n_second),
+        pos_(pos),
+        stride_(stride) {}
+  ~SlotSpan() = default;
+
+ public:
+  [[nodiscard]] auto size() const -> uint32_t { return n_first_ + n_second_; }
+  [[nodiscard]] auto empty() const -> bool { return size() == 0; }
+
+  auto operator[](uint32_t i) const -> T& {
+    return i < n_first_ ? at(first_, i) : at(second_, i - n_first_);
+  }
+
+  /// Construct the i-th reserved slot in place.
+  template <typename... Args>
+  auto emplace(uint32_t i, Args&&... args) const -> T& {
+    return *new (&(*this)[i]) T(std::forward<Args>(args)...);
+  }
+
+  [[nodiscard]] auto first() const -> T* { return first_; }
+  [[nodiscard]] auto firstSize() const -> uint32_t { return n_first_; }
+  [[nodiscard]] auto second() const -> T* { return second_; }
+  [[nodiscard]] auto secondSize() const -> uint32_t { return n_second_; }
+  [[nodiscard]] auto stride() const -> uint32_t { return stride_; }
+
+  /// ring position of the first slot, only meaningful to the queue which made the span
+  [[nodiscard]] auto pos() const -> uint32_t { return pos_; }
+
+ private:
+  auto at(T* p, uint32_t i) const -> T& {
+    return *reinterpret_cast<T*>(reinterpret_cast<Byte*>(p) + size_t{i} * stride_);
+  }
+
+ private:
+  T* first_{nullptr};
+  T* second_{nullptr};
+  uint32_t n_first_{0};
+  uint32_t n_second_{0};
+  uint32_t pos_{0};
+  uint32_t stride_{sizeof(T)};
+};
+
 template <typename Queue>
 class QueueProducer : util::Noncopyable {
  public:
@@ -32,12 +115,12 @@ class QueueProducer : util::Noncopyable {
 
  public:
   explicit QueueProducer(Queue& q) : q_(q) {
-    if (q_.counter_.n_producer_ == q.counter_.max_producer_) {
+    if (not DescriptorCounter::acquire(q_.counter_.n_producer_,
+                                       q_.counter_.max_producer_)) {
       throw std::runtime_error("too many producers");
     }
-    q_.counter_.n_producer_++;
   }
-  ~QueueProducer() { q_.counter_.n_producer_--; }
+  ~QueueProducer() { DescriptorCounter::release(q_.counter_.n_producer_); }
 
  public:
   template <typename... Args>
@@ -45,6 +128,30 @@ class QueueProducer : util::Noncopyable {
     return q_.push(std::forward<Args>(args)...);
   }
 
+  template <typename InputIt>
+  auto pushBulk(InputIt first, uint32_t n) -> bool {
+    return q_.pushBulk(first, n);
+  }
+
+  template <typename InputIt>
+  auto pushBurst(InputIt first, uint32_t n) -> uint32_t {
+    return q_.pushBurst(first, n);
+  }
+
+  template <typename... Args>
+  auto pushWait(Args&&... args) -> void {
+    q_.pushWait(std::forward<Args>(args)...);
+  }
+
+  template <typename Rep, typename Period, typename... Args>
+  auto pushWaitFor(const std::chrono::duration<Rep, Period>& timeout, Args&&... args)
+      -> bool {
+    return q_.pushWaitFor(timeout, std::forward<Args>(args)...);
+  }
+
+  auto reserve(uint32_t n) -> SlotSpan<ValueType> { return q_.reserve(n); }
+  auto commit(const SlotSpan<ValueType>& span) -> void { q_.commit(span); }
+
  private:
   Queue& q_;
 };
@@ -56,16 +163,37 @@ class QueueConsumer : util::Noncopyable {
 
  public:
   explicit QueueConsumer(Queue& q) : q_(q) {
-    if (q_.counter_.n_producer_ == q.counter_.max_consumer_) {
+    if (not DescriptorCounter::acquire(q_.counter_.n_consumer_,
+                                       q_.counter_.max_consumer_)) {
       throw std::runtime_error("too many consumers");
     }
-    q_.counter_.n_consumer_++;
   }
-  ~QueueConsumer() { q_.counter_.n_consumer_--; }
+  ~QueueConsumer() { DescriptorCounter::release(q_.counter_.n_consumer_); }
 
  public:
   auto pop(ValueType& e) -> bool { return q_.pop(e); }
 
+  template <typename OutputIt>
+  auto popBulk(OutputIt d_first, uint32_t n) -> bool {
+    return q_.popBulk(d_first, n);
+  }
+
+  template <typename OutputIt>
+  auto popBurst(OutputIt d_first, uint32_t n) -> uint32_t {
+    return q_.popBurst(d_first, n);
+  }
+
+  auto popWait(ValueType& e) -> void { q_.popWait(e); }
+
+  template <typename Rep, typename Period>
+  auto popWaitFor(ValueType& e, const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return q_.popWaitFor(e, timeout);
+  }
+
+  auto peek(uint32_t n) -> SlotSpan<const ValueType> { return q_.peek(n); }
+  auto release(const SlotSpan<const ValueType>& span) -> void { q_.release(span); }
+
  private:
   Queue& q_;
 };
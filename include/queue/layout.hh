@@ -0,0 +1,42 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+
+#include "util/align.hh"
+#include "util/math.hh"
+
+namespace toolbox::container {
+
+/// The Layout of a Queue places its slots, the slot of ring index i lives i * stride<T>()
+/// bytes after the first one.
+///
+/// PackedLayout, the default, puts the slots side by side, e.g. 8 slots of uint64_t share
+/// a cache line.
+class PackedLayout {
+ public:
+  template <typename T>
+  constexpr static auto stride() -> size_t {
+    return sizeof(T);
+  }
+};
+
+/// Gives each slot cache lines of its own, so that the producers of neighbouring slots,
+/// which write them at the same time in the MPMC modes, do not bounce a line between
+/// their cores, and neither do the consumers, nor a consumer reading the slot next to
+/// the one a producer writes.
+///
+/// Notice:
+///     A slot of a small element takes a whole line, e.g. 8 times the memory for
+///     uint64_t, and a single thread streaming through the ring touches as many more
+///     lines. Whether that pays depends on the machine and the number of threads, compare
+///     the Padded benches of mpmc_bench.cc with the packed ones on a multi-core machine.
+class PaddedLayout {
+ public:
+  template <typename T>
+  constexpr static auto stride() -> size_t {
+    return misc::alignUp(sizeof(T), std::max(alignof(T), util::cache_line_size));
+  }
+};
+
+}  // namespace toolbox::container
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+#include "util/align.hh"
+#include "util/concurrent_statistics.hh"
+#include "util/marker.hh"
+#include "util/statistics.hh"
+#include "util/thread_id.hh"
+
+namespace toolbox::container {
+
+/// The Metrics of a Queue receive a call at each event of interest, e.g. a failed CAS
+/// on a head. NoMetrics, the default, ignores them all and compiles to nothing.
+class NoMetrics {
+ public:
+  constexpr static bool enabled = false;
+
+ public:
+  auto casRetry() -> void {}
+  auto tailSpin(uint32_t /*n*/) -> void {}
+  auto full() -> void {}
+  auto empty() -> void {}
+  auto occupancy(uint32_t /*n*/) -> void {}
+};
+
+/// Counts the contention and the occupancy of a Queue.
+///
+/// Each thread counts into its own cache line aligned shard, picked by util::ThreadId as
+/// in util::ConcurrentStatistics, which also keeps the occupancy histogram, so that the
+/// instrumentation adds no contention of its own. The occupancy is sampled at each push,
+/// and the histogram covers (2 ^ N - 1) * scale elements.
+///
+/// Notice:
+///     A snapshot is not a consistent cut, see util::ConcurrentStatistics.
+template <uint32_t N = 20, uint32_t scale = 8>
+class QueueMetrics : public util::Noncopyable, public util::Nonmovable {
+ public:
+  constexpr static bool enabled = true;
+
+  using StatisticsType = util::Statistics<N, scale>;
+
+  class Snapshot {
+   public:
+    uint64_t cas_retries_{0};  // failed CAS on a head
+    uint64_t tail_spins_{0};   // spins waiting for the reservations of other threads
+    uint64_t full_{0};         // pushes rejected as the queue is full
+    uint64_t empty_{0};        // pops rejected as the queue is empty
+    uint64_t high_water_{0};   // the highest occupancy seen by a push
+    StatisticsType occupancy_{};
+  };
+
+ private:
+  class alignas(util::cache_line_size) Shard {
+   public:
+    static auto add(std::atomic_uint64_t& c, uint64_t n) -> void {
+      c.store(c.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+   public:
+    std::atomic_uint64_t cas_retries_{0};
+    std::atomic_uint64_t tail_spins_{0};
+    std::atomic_uint64_t full_{0};
+    std::atomic_uint64_t empty_{0};
+    std::atomic_uint64_t high_water_{0};
+  };
+
+ public:
+  QueueMetrics() : shards_(new std::atomic<Shard*>[util::ThreadId::max_thread]) {
+    for (uint32_t i = 0; i < util::ThreadId::max_thread; i++) {
+      shards_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~QueueMetrics() {
+    for (uint32_t i = 0; i < util::ThreadId::max_thread; i++) {
+      delete shards_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  auto casRetry() -> void { Shard::add(local().cas_retries_, 1); }
+  auto tailSpin(uint32_t n) -> void { Shard::add(local().tail_spins_, n); }
+  auto full() -> void { Shard::add(local().full_, 1); }
+  auto empty() -> void { Shard::add(local().empty_, 1); }
+
+  auto occupancy(uint32_t n) -> void {
+    occupancy_.record(n);
+    Shard& shard = local();
+    if (n > shard.high_water_.load(std::memory_order_relaxed)) {
+      shard.high_water_.store(n, std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  /// All the events counted so far, merged from all the shards.
+  auto snapshot() const -> Snapshot {
+    Snapshot r;
+    uint32_t n = util::ThreadId::highWater();
+    for (uint32_t i = 0; i < n; i++) {
+      const Shard* shard = shards_[i].load(std::memory_order_acquire);
+      if (shard == nullptr) continue;
+      r.cas_retries_ += shard->cas_retries_.load(std::memory_order_relaxed);
+      r.tail_spins_ += shard->tail_spins_.load(std::memory_order_relaxed);
+      r.full_ += shard->full_.load(std::memory_order_relaxed);
+      r.empty_ += shard->empty_.load(std::memory_order_relaxed);
+      r.high_water_ =
+          std::max(r.high_water_, shard->high_water_.load(std::memory_order_relaxed));
+    }
+    r.occupancy_ = occupancy_.snapshot();
+    return r;
+  }
+
+ private:
+  auto local() -> Shard& {
+    auto& slot = shards_[util::ThreadId::get()];
+    Shard* shard = slot.load(std::memory_order_relaxed);
+    if (shard == nullptr) {
+      shard = new Shard();
+      slot.store(shard, std::memory_order_release);
+    }
+    return *shard;
+  }
+
+ private:
+  std::unique_ptr<std::atomic<Shard*>[]> shards_;
+  util::ConcurrentStatistics<N, scale> occupancy_{};
+};
+
+}  // namespace toolbox::container
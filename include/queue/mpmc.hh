@@ -2,14 +2,22 @@
 
 #include <spdlog/spdlog.h>
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <new>
+#include <thread>
 
 #include "descriptor.hh"
+#include "layout.hh"
+#include "memory/page_alloc.hh"
+#include "metrics.hh"
 #include "util/align.hh"
 #include "util/math.hh"
 #include "util/misc.hh"
+#include "util/offset_ptr.hh"
+#include "util/timer.hh"
+#include "util/wait.hh"
 
 namespace toolbox::container {
 
@@ -20,9 +28,35 @@ enum QueueMode {
   MPMC,
   MPMC_HTS,
   MPMC_RTS,
+  MPSC,      // multiple producers, the consumer side is single threaded as in SPSC
+  SPMC,      // multiple consumers, the producer side is single threaded as in SPSC
+  MPMC_SEQ,  // a sequence number per slot as in Vyukov's bounded MPMC queue, see below
 };
 
-template <typename T, uint32_t Size, QueueMode Mode>
+template <typename T, uint32_t Size, QueueMode Mode, typename Wait>
+class SharedQueue;
+
+/// Wait is the strategy of the blocking operations, see util/wait.hh.
+/// Metrics receives the contention and occupancy events, see queue/metrics.hh, the
+/// default NoMetrics compiles them out.
+/// Alloc places the slots, see memory/page_alloc.hh, e.g. on huge pages of a NUMA node.
+/// Layout lays them out, see queue/layout.hh, e.g. a cache line each.
+///
+/// In MPMC_SEQ mode each slot carries a sequence number, which tells the lap of the
+/// ring it is ready for: a producer claims free slots by a CAS on the producer head as in
+/// MPMC mode, but then publishes each slot by its sequence number instead of waiting for
+/// the preceding producers to move the tail, and so do consumers, so that a preempted
+/// producer or consumer only holds up the slots it claimed, not the whole queue. As in
+/// Vyukov's queue, a slot is a cell of its sequence number and its element, so that a
+/// push or a pop writes a single line.
+/// Notice:
+///     In MPMC_SEQ mode the sequence number takes 4 more bytes per slot, rounded up to
+///     the alignment of T, e.g. a slot of uint64_t takes 16 bytes instead of 8, with
+///     PaddedLayout still one cache line as long as both fit in it. The slots of the
+///     zero-copy spans are slot_stride bytes apart, see SlotSpan::stride().
+template <typename T, uint32_t Size, QueueMode Mode, typename Wait = util::SpinWait,
+          typename Metrics = NoMetrics, typename Alloc = memory::HeapAlloc,
+          typename Layout = PackedLayout>
 class Queue {
   class [[gnu::packed]] Handle {
    public:
@@ -42,7 +76,7 @@ class Queue {
    public:
     RawHandle() : head_(0), tail_(0) {}
     ~RawHandle() = default;
-    RawHandle(uint64_t x) : head_(x >> 32), tail_(x) {}
+    RawHandle(uint64_t x) { asUint64Ref() = x; }
 
    public:
     auto sync() -> bool { return head_ == tail_; }
@@ -89,7 +123,7 @@ class Queue {
   class [[gnu::packed]] alignas(sizeof(uint64_t)) PosRef {
    public:
     PosRef() : pos_(0), ref_(0) {}
-    PosRef(uint64_t x) : pos_(x >> 32), ref_(x) {}
+    PosRef(uint64_t x) { asUint64Ref() = x; }
     ~PosRef() = default;
 
    public:
@@ -117,10 +151,16 @@ class Queue {
     uint32_t ref_;
   };
 
-  constexpr static uint32_t head_tail_dis_max = Size / 8;
+  /// A slot of MPMC_SEQ mode.
+  class SeqCell {
+   public:
+    std::atomic_uint32_t seq_;
+    alignas(T) std::byte elem_[sizeof(T)];
+  };
+
   class [[gnu::packed]] RTSHandle {
    public:
-    RTSHandle() : head_(), tail_(), dis_max_(head_tail_dis_max) {}
+    RTSHandle() : head_(), tail_(), dis_max_(0) {}
     ~RTSHandle() = default;
 
    public:
@@ -136,266 +176,540 @@ class Queue {
  public:
   using ValueType = T;
   using HandleType = std::conditional_t<
-      Mode == MPMC or Mode == SPSC, Handle,
+      Mode == MPMC or Mode == SPSC or Mode == MPSC or Mode == SPMC or Mode == MPMC_SEQ,
+      Handle,
       std::conditional_t<Mode == MPMC_HTS, HTSHandle,
                          std::conditional_t<Mode == MPMC_RTS, RTSHandle, void>>>;
   static_assert(not std::is_same_v<Handle, void>, "unknown queue mode");
-  using QueueType = Queue<ValueType, Size, Mode>;
+  using QueueType = Queue<ValueType, Size, Mode, Wait, Metrics, Alloc, Layout>;
+  using MetricsType = Metrics;
   using ProducerType = QueueProducer<QueueType>;
   using ConsumerType = QueueConsumer<QueueType>;
 
  public:
   friend class QueueProducer<QueueType>;
   friend class QueueConsumer<QueueType>;
+  friend class SharedQueue<ValueType, Size, Mode, Wait>;
 
  public:
-  Queue()
-      : size_(misc::alignUpPowerOf2(Size)),
+  template <uint32_t S = Size, std::enable_if_t<S != dynamic_size, int> = 0>
+  Queue() : Queue(Size, Size / 8, nullptr) {}
+
+  /// Only for queues of dynamic_size.
+  template <uint32_t S = Size, std::enable_if_t<S == dynamic_size, int> = 0>
+  explicit Queue(uint32_t capacity) : Queue(capacity, capacity / 8, nullptr) {}
+
+  /// Only for queues of dynamic_size, head_tail_dis_max is the maximum distance between
+  /// head and tail in MPMC_RTS mode, which is capacity / 8 by default.
+  template <uint32_t S = Size, std::enable_if_t<S == dynamic_size, int> = 0>
+  Queue(uint32_t capacity, uint32_t head_tail_dis_max)
+      : Queue(capacity, head_tail_dis_max, nullptr) {}
+
+  ~Queue() {
+    if (not std::is_trivially_destructible<ValueType>()) {
+      uint32_t pos = consumer_handle_.head();
+      uint32_t end = producer_handle_.head();
+      while (pos != end) {
+        slot(pos++).~ValueType();
+      }
+    }
+    if (owns_elems_) {
+      Alloc::deallocate(reinterpret_cast<std::byte*>(elems_.get()) - elem_offset,
+                        storageSize(capacity_));
+    }
+  }
+
+ private:
+  /// The slots are placed in `storage` of storageSize(capacity) bytes if it is given, and
+  /// they are addressed relative to the queue itself, so that the queue and its storage
+  /// can be shared by processes mapping them at different addresses.
+  Queue(uint32_t capacity, uint32_t head_tail_dis_max, ValueType* storage)
+      : size_(misc::alignUpPowerOf2(checkCapacity(capacity))),
         mask_(size_ - 1),
-        capacity_(Size),
-        counter_(isSPSC() ? 1 : -1, isSPSC() ? 1 : -1),
-        elems_(static_cast<ValueType*>(::operator new[](sizeof(ValueType) * size_))) {
-    if (elems_ == nullptr) {
+        capacity_(capacity),
+        counter_(isSingleProducer() ? 1 : -1, isSingleConsumer() ? 1 : -1),
+        owns_elems_(storage == nullptr),
+        elems_(firstElem(owns_elems_ ? Alloc::allocate(storageSize(capacity))
+                                     : static_cast<void*>(storage))) {
+    if (not elems_) {
       throw std::bad_alloc();
     }
-  }
-  ~Queue() {
-    if (not std::is_trivially_destructible<ValueType>()) {
-      size_t idx = consumer_handle_.head();
-      size_t end = producer_handle_.head();
-      while (idx != end) {
-        elems_[idx].~ValueType();
-        if (++idx == size_) {
-          idx = 0;
-        }
+    if constexpr (Mode == MPMC_SEQ) {
+      // slot i is free for the producer of position i
+      for (uint32_t i = 0; i < size_; i++) {
+        new (&seq(i)) std::atomic_uint32_t(i);
       }
     }
-    ::operator delete[](elems_);
+    if constexpr (Mode == MPMC_RTS) {
+      producer_handle_.dis_max_ = head_tail_dis_max;
+      consumer_handle_.dis_max_ = head_tail_dis_max;
+    }
+  }
+
+  static auto checkCapacity(uint32_t capacity) -> uint32_t {
+    if (capacity < 1 or capacity > max_capacity) {
+      throw std::runtime_error("invalid capacity of queue");
+    }
+    return capacity;
   }
 
  public:
   static constexpr auto isSPSC() -> bool { return Mode == SPSC; }
+  static constexpr auto isSingleProducer() -> bool {
+    return Mode == SPSC or Mode == SPMC;
+  }
+  static constexpr auto isSingleConsumer() -> bool {
+    return Mode == SPSC or Mode == MPSC;
+  }
+
+  /// bytes taken by the slots of a queue of the given capacity
+  static constexpr auto storageSize(uint32_t capacity) -> size_t {
+    return slot_stride * misc::alignUpPowerOf2(capacity);
+  }
+
+  /// bytes from a slot to the next one, see queue/layout.hh
+  constexpr static size_t slot_stride =
+      Layout::template stride<std::conditional_t<Mode == MPMC_SEQ, SeqCell, ValueType>>();
+
+  constexpr static uint32_t max_capacity = 1U << 30;
+  constexpr static uint32_t tail_wait_spin_limit = 1U << 10;
 
  public:
   auto producer() -> ProducerType { return ProducerType(*this); }
   auto consumer() -> ConsumerType { return ConsumerType(*this); }
 
+  auto metrics() -> MetricsType& { return metrics_; }
+  auto metrics() const -> const MetricsType& { return metrics_; }
+
  public:
-  template <typename... Args, QueueMode mode = Mode>
-  auto push(Args&&... args) -> std::enable_if_t<mode == MPMC or mode == SPSC, bool> {
-    uint32_t producer_new_head = 0;
-    uint32_t n_free = 0;
-
-    const uint32_t capacity = capacity_;
-    uint32_t producer_old_head = producer_handle_.head_.load(std::memory_order_consume);
-    // move producer head
-    auto ok = true;
-    do {
-      n_free = capacity + consumer_handle_.tail_.load(std::memory_order_consume) -
-               producer_old_head;
-      if (n_free < 1) return false;
-      producer_new_head = producer_old_head + 1;
-      if constexpr (isSPSC()) {
-        producer_handle_.head_ = producer_new_head;
-      } else {
-        ok = producer_handle_.head_.compare_exchange_strong(
-            producer_old_head, producer_new_head, std::memory_order_relaxed,
-            std::memory_order_relaxed);
-      }
-    } while (not ok);
-    // place element
-    new (&elems_[producer_old_head & mask_]) ValueType(std::forward<Args>(args)...);
+  template <typename... Args>
+  auto push(Args&&... args) -> bool {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    if (moveProducerHead(1, Behavior::Fixed, head, next) == 0) {
+      return false;
+    }
+    new (&slot(head)) ValueType(std::forward<Args>(args)...);
+    updateProducerTail(head, next);
+    not_empty_.notify(1);
+    return true;
+  }
 
-    // wait and update producer tail
-    if constexpr (not isSPSC()) {
-      while (producer_handle_.tail_.load(std::memory_order_relaxed) !=
-             producer_old_head) {
-        misc::pause();
+  auto pop(ValueType& e) -> bool {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    if (moveConsumerHead(1, Behavior::Fixed, head, next) == 0) {
+      return false;
+    }
+    e = std::move(slot(head));
+    slot(head).~ValueType();
+    updateConsumerTail(head, next);
+    not_full_.notify(1);
+    return true;
+  }
+
+ public:
+  /// Block until the element is pushed.
+  template <typename... Args>
+  auto pushWait(Args&&... args) -> void {
+    not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                        util::time_point::max());
+  }
+
+  /// Block until the element is pushed or the timeout expires.
+  template <typename Rep, typename Period, typename... Args>
+  auto pushWaitFor(const std::chrono::duration<Rep, Period>& timeout, Args&&... args)
+      -> bool {
+    return not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                               util::clock::now() + timeout);
+  }
+
+  /// Block until an element is popped.
+  auto popWait(ValueType& e) -> void {
+    not_empty_.waitUntil([&] { return pop(e); }, util::time_point::max());
+  }
+
+  /// Block until an element is popped or the timeout expires.
+  template <typename Rep, typename Period>
+  auto popWaitFor(ValueType& e, const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return not_empty_.waitUntil([&] { return pop(e); }, util::clock::now() + timeout);
+  }
+
+ public:
+  /// All-or-nothing: either all n elements in [first, first + n) are pushed or none.
+  template <typename InputIt>
+  auto pushBulk(InputIt first, uint32_t n) -> bool {
+    return pushN(first, n, Behavior::Fixed) == n;
+  }
+
+  /// Push as many elements of [first, first + n) as fit, returns the number pushed.
+  template <typename InputIt>
+  auto pushBurst(InputIt first, uint32_t n) -> uint32_t {
+    return pushN(first, n, Behavior::Variable);
+  }
+
+  /// All-or-nothing: either n elements are moved into d_first or none.
+  template <typename OutputIt>
+  auto popBulk(OutputIt d_first, uint32_t n) -> bool {
+    return popN(d_first, n, Behavior::Fixed) == n;
+  }
+
+  /// Pop at most n elements into d_first, returns the number popped.
+  template <typename OutputIt>
+  auto popBurst(OutputIt d_first, uint32_t n) -> uint32_t {
+    return popN(d_first, n, Behavior::Variable);
+  }
+
+ public:
+  /// Reserve at most n free slots, every slot of the returned span shall be constructed
+  /// (e.g. by SlotSpan::emplace) before the span is handed back to commit().
+  /// Notice:
+  ///     Other producers can not publish until this reservation is committed, in
+  ///     MPMC_SEQ mode they can, but consumers can not pop past it.
+  auto reserve(uint32_t n) -> SlotSpan<ValueType> {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = moveProducerHead(n, Behavior::Variable, head, next);
+    return makeSpan<ValueType>(head, n);
+  }
+
+  auto commit(const SlotSpan<ValueType>& span) -> void {
+    if (span.empty()) return;
+    updateProducerTail(span.pos(), span.pos() + span.size());
+    not_empty_.notify(span.size());
+  }
+
+  /// Peek at most n ready elements in place, the elements are destroyed and their slots
+  /// are given back to producers by release().
+  /// Notice:
+  ///     Other consumers can not release until this span is released, in MPMC_SEQ mode
+  ///     they can, but producers can not push past it.
+  auto peek(uint32_t n) -> SlotSpan<const ValueType> {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = moveConsumerHead(n, Behavior::Variable, head, next);
+    return makeSpan<const ValueType>(head, n);
+  }
+
+  auto release(const SlotSpan<const ValueType>& span) -> void {
+    if (span.empty()) return;
+    if (not std::is_trivially_destructible<ValueType>()) {
+      for (uint32_t i = 0; i < span.size(); i++) {
+        slot(span.pos() + i).~ValueType();
       }
     }
+    updateConsumerTail(span.pos(), span.pos() + span.size());
+    not_full_.notify(span.size());
+  }
 
-    producer_handle_.tail_.store(producer_new_head, std::memory_order_release);
-    return true;
+ private:
+  /// Fixed reserves exactly n slots or nothing, Variable reserves as many as possible.
+  enum class Behavior {
+    Fixed,
+    Variable,
+  };
+
+  template <typename U>
+  auto makeSpan(uint32_t head, uint32_t n) -> SlotSpan<U> {
+    uint32_t idx = head & mask_;
+    uint32_t n_first = std::min(n, size_ - idx);
+    return SlotSpan<U>(&slot(idx), n_first, elems_.get(), n - n_first, head,
+                       slot_stride);
   }
 
-  template <QueueMode mode = Mode>
-  auto pop(ValueType& e) -> std::enable_if_t<mode == MPMC or mode == SPSC, bool> {
-    uint32_t consumer_new_head = 0;
-    uint32_t n_remain = 0;
+  template <typename InputIt>
+  auto pushN(InputIt first, uint32_t n, Behavior behavior) -> uint32_t {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = moveProducerHead(n, behavior, head, next);
+    if (n == 0) return 0;
+    for (uint32_t i = 0; i < n; i++, ++first) {
+      new (&slot(head + i)) ValueType(*first);
+    }
+    updateProducerTail(head, next);
+    not_empty_.notify(n);
+    return n;
+  }
 
-    // move consumer head
-    uint32_t consumer_old_head = consumer_handle_.head_.load(std::memory_order_consume);
-    auto ok = true;
-    do {
-      n_remain =
-          producer_handle_.tail_.load(std::memory_order_consume) - consumer_old_head;
-      if (n_remain < 1) return false;
-      consumer_new_head = consumer_old_head + 1;
-      if constexpr (isSPSC()) {
-        consumer_handle_.head_ = consumer_new_head;
+  template <typename OutputIt>
+  auto popN(OutputIt d_first, uint32_t n, Behavior behavior) -> uint32_t {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = moveConsumerHead(n, behavior, head, next);
+    if (n == 0) return 0;
+    for (uint32_t i = 0; i < n; i++, ++d_first) {
+      *d_first = std::move(slot(head + i));
+      slot(head + i).~ValueType();
+    }
+    updateConsumerTail(head, next);
+    not_full_.notify(n);
+    return n;
+  }
+
+ private:
+  auto moveProducerHead(uint32_t n, Behavior behavior, uint32_t& old_head,
+                        uint32_t& new_head) -> uint32_t {
+    if constexpr (Mode == MPMC_SEQ) {
+      n = moveSeqHead<true>(producer_handle_, n, behavior, old_head, new_head);
+    } else {
+      n = moveHead<isSingleProducer()>(producer_handle_, consumer_handle_, capacity_, n,
+                                       behavior, old_head, new_head);
+    }
+    if constexpr (Metrics::enabled) {
+      if (n == 0) {
+        metrics_.full();
+      } else if constexpr (Mode == MPMC_SEQ) {
+        metrics_.occupancy(new_head - consumer_handle_.head());
       } else {
-        ok = consumer_handle_.head_.compare_exchange_strong(
-            consumer_old_head, consumer_new_head, std::memory_order_relaxed,
-            std::memory_order_relaxed);
+        metrics_.occupancy(new_head - consumer_handle_.tail());
       }
-    } while (not ok);
+    }
+    return n;
+  }
 
-    // move element
-    uint32_t idx = consumer_old_head & mask_;
-    e = std::move(elems_[idx]);
-    elems_[idx].~ValueType();
+  auto moveConsumerHead(uint32_t n, Behavior behavior, uint32_t& old_head,
+                        uint32_t& new_head) -> uint32_t {
+    if constexpr (Mode == MPMC_SEQ) {
+      n = moveSeqHead<false>(consumer_handle_, n, behavior, old_head, new_head);
+    } else {
+      n = moveHead<isSingleConsumer()>(consumer_handle_, producer_handle_, 0, n,
+                                       behavior, old_head, new_head);
+    }
+    if constexpr (Metrics::enabled) {
+      if (n == 0) metrics_.empty();
+    }
+    return n;
+  }
 
-    if constexpr (not isSPSC()) {
-      // wait and update consumer tail
-      while (consumer_handle_.tail_.load(std::memory_order_relaxed) !=
-             consumer_old_head) {
-        misc::pause();
-      }
+  auto updateProducerTail(uint32_t old_head, uint32_t new_head) -> void {
+    if constexpr (Mode == MPMC_SEQ) {
+      publish(old_head, new_head, 1);
+    } else {
+      updateTail<isSingleProducer()>(producer_handle_, old_head, new_head);
     }
+  }
 
-    consumer_handle_.tail_.store(consumer_new_head, std::memory_order_release);
-    return true;
+  auto updateConsumerTail(uint32_t old_head, uint32_t new_head) -> void {
+    if constexpr (Mode == MPMC_SEQ) {
+      publish(old_head, new_head, size_);
+    } else {
+      updateTail<isSingleConsumer()>(consumer_handle_, old_head, new_head);
+    }
   }
 
-  template <typename... Args, QueueMode mode = Mode>
-  auto push(Args&&... args) -> std::enable_if_t<mode == MPMC_HTS, bool> {
-    RawHandle np;
-    uint32_t n_free = 0;
+  /// bytes from the beginning of a slot to its element, i.e. offsetof(SeqCell, elem_)
+  /// in MPMC_SEQ mode
+  constexpr static size_t elem_offset =
+      Mode == MPMC_SEQ ? misc::alignUp(sizeof(std::atomic_uint32_t), alignof(T)) : 0;
 
+  static auto firstElem(void* storage) -> ValueType* {
+    if (storage == nullptr) return nullptr;
+    return reinterpret_cast<ValueType*>(static_cast<std::byte*>(storage) + elem_offset);
+  }
+
+  auto slot(uint32_t pos) const -> ValueType& {
+    return *reinterpret_cast<ValueType*>(reinterpret_cast<std::byte*>(elems_.get()) +
+                                         size_t{pos & mask_} * slot_stride);
+  }
+
+  auto seq(uint32_t pos) const -> std::atomic_uint32_t& {
+    return *reinterpret_cast<std::atomic_uint32_t*>(
+        reinterpret_cast<std::byte*>(&slot(pos)) - elem_offset);
+  }
+
+  /// In MPMC_SEQ mode the slot of position p is free for its producer when its sequence
+  /// number is p, and ready for its consumer when it is p + 1, which the producer
+  /// publishes. The consumer publishes p + size, i.e. free for the producer of the next
+  /// lap. Claim up to n slots from the head of `d` which are all free, or ready, and for
+  /// producers within the capacity, by a CAS on the head. The sequence numbers of the
+  /// claimed slots can not change until their owner publishes them, so they are checked
+  /// before the CAS.
+  template <bool Producer>
+  auto moveSeqHead(Handle& d, uint32_t n, Behavior behavior, uint32_t& old_head,
+                   uint32_t& new_head) -> uint32_t {
+    const uint32_t max = n;
+    const uint32_t lag = Producer ? 0 : 1;
+
+    old_head = d.head_.load(std::memory_order_relaxed);
     auto ok = false;
-    const uint32_t capacity = capacity_;
-    RawHandle cp = producer_handle_.load(std::memory_order_acquire);
     do {
-      while (not cp.sync()) {
-        misc::pause();
-        cp = producer_handle_.load(std::memory_order_acquire);
+      n = max;
+      if constexpr (Producer) {
+        uint32_t entries =
+            capacity_ + consumer_handle_.head_.load(std::memory_order_relaxed) - old_head;
+        n = std::min(n, entries);
       }
-      n_free =
-          capacity + consumer_handle_.tail_.load(std::memory_order_relaxed) - cp.head_;
-      if (n_free < 1) return false;
-      np.tail_ = cp.tail_;
-      np.head_ = cp.head_ + 1;
-      ok = producer_handle_.compareExchangeStrong(cp.asUint64Ref(), np.asUint64(),
-                                                  std::memory_order_acquire,
-                                                  std::memory_order_acquire);
+      uint32_t ready = 0;
+      for (; ready < n; ready++) {
+        uint32_t pos = old_head + ready;
+        if (seq(pos).load(std::memory_order_acquire) != pos + lag) break;
+      }
+      if (ready < n) {
+        // the slots may have been claimed from under a stale head
+        uint32_t head = d.head_.load(std::memory_order_relaxed);
+        if (head != old_head) {
+          old_head = head;
+          continue;
+        }
+      }
+      n = (behavior == Behavior::Fixed and ready < max) ? 0 : ready;
+      if (n == 0) return 0;
+      new_head = old_head + n;
+      ok = d.head_.compare_exchange_strong(old_head, new_head, std::memory_order_relaxed,
+                                           std::memory_order_relaxed);
+      if (not ok) metrics_.casRetry();
     } while (not ok);
-
-    new (&elems_[cp.head_ & mask_]) ValueType(std::forward<Args>(args)...);
-
-    producer_handle_.tail_.store(np.head_, std::memory_order_release);
-    return true;
+    return n;
   }
 
-  template <QueueMode mode = Mode>
-  auto pop(ValueType& e) -> std::enable_if_t<mode == MPMC_HTS, bool> {
-    RawHandle np;
-    uint32_t n_remain = 0;
+  /// Hand the slots [old_head, new_head) over to the other side, each one on its own.
+  auto publish(uint32_t old_head, uint32_t new_head, uint32_t lap) -> void {
+    for (uint32_t pos = old_head; pos != new_head; pos++) {
+      seq(pos).store(pos + lap, std::memory_order_release);
+    }
+  }
 
-    auto ok = false;
-    RawHandle cp = consumer_handle_.load(std::memory_order_acquire);
+  /// Move the head of `d` forward by up to n slots, `s` is the handle of the other side.
+  /// For producers `capacity` is the queue capacity, for consumers it is 0, so that
+  /// `capacity + s.tail - d.head` is the number of free slots or ready elements.
+  /// Returns the number of reserved slots, [old_head, new_head) is owned by the caller.
+  /// A side of a single thread (`ST`) moves its head and tail by plain stores.
+  template <bool ST>
+  auto moveHead(Handle& d, Handle& s, uint32_t capacity, uint32_t n, Behavior behavior,
+                uint32_t& old_head, uint32_t& new_head) -> uint32_t {
+    const uint32_t max = n;
+    uint32_t entries = 0;
+
+    old_head = d.head_.load(std::memory_order_consume);
+    auto ok = true;
     do {
-      while (not cp.sync()) {
-        misc::pause();
-        cp = consumer_handle_.load(std::memory_order_acquire);
+      n = max;
+      entries = capacity + s.tail_.load(std::memory_order_consume) - old_head;
+      if (n > entries) {
+        n = (behavior == Behavior::Fixed) ? 0 : entries;
+      }
+      if (n == 0) return 0;
+      new_head = old_head + n;
+      if constexpr (ST) {
+        d.head_.store(new_head, std::memory_order_relaxed);
+      } else {
+        ok = d.head_.compare_exchange_strong(old_head, new_head,
+                                             std::memory_order_relaxed,
+                                             std::memory_order_relaxed);
+        if (not ok) metrics_.casRetry();
       }
-      n_remain = producer_handle_.tail_.load(std::memory_order_relaxed) - cp.head_;
-      if (n_remain < 1) return false;
-      np.tail_ = cp.tail_;
-      np.head_ = cp.head_ + 1;
-      ok = consumer_handle_.compareExchangeStrong(cp.asUint64Ref(), np.asUint64(),
-                                                  std::memory_order_acquire,
-                                                  std::memory_order_acquire);
     } while (not ok);
+    return n;
+  }
 
-    uint32_t idx = cp.head_ & mask_;
-    e = std::move(elems_[idx]);
-    elems_[idx].~ValueType();
-
-    consumer_handle_.tail_.store(np.head_, std::memory_order_release);
-    return true;
+  template <bool ST>
+  auto updateTail(Handle& d, uint32_t old_head, uint32_t new_head) -> void {
+    // wait for the preceding reservations to be published, and give the core away now
+    // and then in case their owner has been preempted
+    if constexpr (not ST) {
+      uint32_t i = 1;
+      for (; d.tail_.load(std::memory_order_relaxed) != old_head; i++) {
+        if (i % tail_wait_spin_limit == 0) {
+          std::this_thread::yield();
+        } else {
+          misc::pause();
+        }
+      }
+      if (i > 1) metrics_.tailSpin(i - 1);
+    }
+    d.tail_.store(new_head, std::memory_order_release);
   }
 
-  template <typename... Args, QueueMode mode = Mode>
-  auto push(Args... args) -> std::enable_if_t<mode == MPMC_RTS, bool> {
-    PosRef nh;
-    uint32_t n_free = 0;
+  template <bool /*ST*/>
+  auto moveHead(HTSHandle& d, HTSHandle& s, uint32_t capacity, uint32_t n,
+                Behavior behavior, uint32_t& old_head, uint32_t& new_head) -> uint32_t {
+    const uint32_t max = n;
+    uint32_t entries = 0;
+    RawHandle np;
 
     auto ok = false;
-    const uint32_t capacity = capacity_;
-    PosRef ch = producer_handle_.head_.load(std::memory_order_acquire);
+    RawHandle cp = d.load(std::memory_order_acquire);
     do {
-      while (ch.pos_ - producer_handle_.tail_.pos_ > producer_handle_.dis_max_) {
+      while (not cp.sync()) {
         misc::pause();
-        ch = producer_handle_.head_.load(std::memory_order_acquire);
+        metrics_.tailSpin(1);
+        cp = d.load(std::memory_order_acquire);
       }
-      n_free = capacity + consumer_handle_.tail_.pos_ - ch.pos_;
-      if (n_free < 1) return false;
-      nh.pos_ = ch.pos_ + 1;
-      nh.ref_ = ch.ref_ + 1;
-      ok = producer_handle_.head_.compareExchangeStrong(ch.asUint64Ref(), nh.asUint64(),
-                                                        std::memory_order_acquire,
-                                                        std::memory_order_acquire);
-    } while (not ok);
-
-    new (&elems_[ch.pos_ & mask_]) ValueType(std::forward<Args>(args)...);
-
-    PosRef nt;
-    PosRef h;
-    PosRef ct = producer_handle_.tail_.load(std::memory_order_acquire);
-    do {
-      h = producer_handle_.head_.load(std::memory_order_relaxed);
-      nt = ct;
-      if (++nt.ref_ == h.ref_) {
-        nt.pos_ = h.pos_;
+      n = max;
+      entries = capacity + s.tail_.load(std::memory_order_acquire) - cp.head_;
+      if (n > entries) {
+        n = (behavior == Behavior::Fixed) ? 0 : entries;
       }
-      ok = producer_handle_.tail_.compareExchangeStrong(ct.asUint64Ref(), nt.asUint64(),
-                                                        std::memory_order_release,
-                                                        std::memory_order_acquire);
+      if (n == 0) return 0;
+      np.tail_ = cp.tail_;
+      np.head_ = cp.head_ + n;
+      ok = d.compareExchangeStrong(cp.asUint64Ref(), np.asUint64(),
+                                   std::memory_order_acquire, std::memory_order_acquire);
+      if (not ok) metrics_.casRetry();
     } while (not ok);
 
-    return true;
+    old_head = cp.head_;
+    new_head = np.head_;
+    return n;
   }
 
-  template <QueueMode mode = Mode>
-  auto pop(ValueType& e) -> std::enable_if_t<mode == MPMC_RTS, bool> {
+  template <bool /*ST*/>
+  auto updateTail(HTSHandle& d, uint32_t /*old_head*/, uint32_t new_head) -> void {
+    d.tail_.store(new_head, std::memory_order_release);
+  }
+
+  template <bool /*ST*/>
+  auto moveHead(RTSHandle& d, RTSHandle& s, uint32_t capacity, uint32_t n,
+                Behavior behavior, uint32_t& old_head, uint32_t& new_head) -> uint32_t {
+    const uint32_t max = n;
+    uint32_t entries = 0;
     PosRef nh;
-    uint32_t n_remain = 0;
 
     auto ok = false;
-    PosRef ch = consumer_handle_.head_.load(std::memory_order_acquire);
+    PosRef ch = d.head_.load(std::memory_order_acquire);
     do {
-      while (ch.pos_ - consumer_handle_.tail_.pos_ > consumer_handle_.dis_max_) {
+      while (ch.pos_ - d.tail_.pos_ > d.dis_max_) {
         misc::pause();
-        ch = consumer_handle_.head_.load(std::memory_order_acquire);
+        metrics_.tailSpin(1);
+        ch = d.head_.load(std::memory_order_acquire);
+      }
+      n = max;
+      entries = capacity + s.tail_.load(std::memory_order_acquire).pos_ - ch.pos_;
+      if (n > entries) {
+        n = (behavior == Behavior::Fixed) ? 0 : entries;
       }
-      n_remain = producer_handle_.tail_.pos_ - ch.pos_;
-      if (n_remain < 1) return false;
-      nh.pos_ = ch.pos_ + 1;
+      if (n == 0) return 0;
+      nh.pos_ = ch.pos_ + n;
       nh.ref_ = ch.ref_ + 1;
-      ok = consumer_handle_.head_.compareExchangeStrong(ch.asUint64Ref(), nh.asUint64(),
-                                                        std::memory_order_acquire,
-                                                        std::memory_order_acquire);
+      ok = d.head_.compareExchangeStrong(ch.asUint64Ref(), nh.asUint64(),
+                                         std::memory_order_acquire,
+                                         std::memory_order_acquire);
+      if (not ok) metrics_.casRetry();
     } while (not ok);
 
-    uint32_t idx = ch.pos_ & mask_;
-    e = std::move(elems_[idx]);
-    elems_[idx].~ValueType();
+    old_head = ch.pos_;
+    new_head = nh.pos_;
+    return n;
+  }
 
+  template <bool /*ST*/>
+  auto updateTail(RTSHandle& d, uint32_t /*old_head*/, uint32_t /*new_head*/) -> void {
     PosRef nt;
     PosRef h;
-    PosRef ct = consumer_handle_.tail_.load(std::memory_order_acquire);
+    auto ok = false;
+    PosRef ct = d.tail_.load(std::memory_order_acquire);
     do {
-      h = consumer_handle_.head_.load(std::memory_order_relaxed);
+      h = d.head_.load(std::memory_order_relaxed);
       nt = ct;
       if (++nt.ref_ == h.ref_) {
         nt.pos_ = h.pos_;
       }
-      ok = consumer_handle_.tail_.compareExchangeStrong(ct.asUint64Ref(), nt.asUint64(),
-                                                        std::memory_order_release,
-                                                        std::memory_order_acquire);
+      ok = d.tail_.compareExchangeStrong(ct.asUint64Ref(), nt.asUint64(),
+                                         std::memory_order_release,
+                                         std::memory_order_acquire);
+      if (not ok) metrics_.casRetry();
     } while (not ok);
-
-    return true;
   }
 
  private:
@@ -405,12 +719,18 @@ class Queue {
   alignas(util::cache_line_size) HandleType consumer_handle_{};
   alignas(util::cache_line_size) [[gnu::unused]] char _pad2_[util::cache_line_size]{};
 
+  alignas(util::cache_line_size) Wait not_full_{};
+  Wait not_empty_{};
+
   uint32_t size_{};
   uint32_t mask_{};
   uint32_t capacity_{};
   DescriptorCounter counter_{-1, -1};
 
-  ValueType* const elems_{nullptr};
+  bool owns_elems_{true};
+  const util::OffsetPtr<ValueType> elems_{nullptr};
+
+  Metrics metrics_{};
 };
 
 }  // namespace toolbox::container
\ No newline at end of file
@@ -0,0 +1,457 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <initializer_list>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "descriptor.hh"
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/math.hh"
+#include "util/misc.hh"
+#include "util/timer.hh"
+#include "util/wait.hh"
+
+namespace toolbox::container {
+
+template <typename Queue>
+class MulticastConsumer;
+
+/// A broadcast ring after the LMAX Disruptor: every element published by the producers
+/// is seen by every consumer, instead of being copied into one queue per consumer.
+///
+/// The slots are laid out as in Queue. Each consumer owns a sequence, the number of
+/// elements it has consumed, and producers never reuse a slot before the slowest consumer
+/// has passed it. A consumer may depend on other consumers through its sequence barrier,
+/// then it only sees the elements all of them have consumed, e.g. the business logic
+/// stage after the journaling and replication stages.
+///
+/// Notice:
+///     Slots hold default constructed elements which producers assign to, consumers only
+///     get const references. All the consumers shall be created before the first push.
+template <typename T, uint32_t Size, bool MultiProducer = false,
+          typename Wait = util::SpinWait>
+class MulticastQueue : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using ValueType = T;
+  using QueueType = MulticastQueue<ValueType, Size, MultiProducer, Wait>;
+  using ProducerType = QueueProducer<QueueType>;
+  using ConsumerType = MulticastConsumer<QueueType>;
+
+  static_assert(std::is_default_constructible_v<ValueType>,
+                "slots of a multicast queue are default constructed");
+
+  constexpr static uint32_t max_capacity = 1U << 30;
+  constexpr static uint32_t max_consumer = 16;
+  constexpr static uint32_t tail_wait_spin_limit = 1U << 10;
+
+ public:
+  friend class QueueProducer<QueueType>;
+  friend class MulticastConsumer<QueueType>;
+
+ private:
+  class alignas(util::cache_line_size) Sequence {
+   public:
+    std::atomic_uint32_t pos_{0};
+    /// false once the consumer is gone, then nobody waits for it any more
+    std::atomic_bool active_{false};
+    bool has_dependents_{false};
+  };
+
+  /// The elements a consumer may read: those published and consumed by all the
+  /// consumers it depends on.
+  class SequenceBarrier {
+   public:
+    SequenceBarrier(const std::atomic_uint32_t& cursor, std::vector<const Sequence*> deps)
+        : cursor_(cursor), deps_(std::move(deps)) {}
+    ~SequenceBarrier() = default;
+
+   public:
+    /// number of readable elements from `pos` on
+    auto available(uint32_t pos) const -> uint32_t {
+      uint32_t n = cursor_.load(std::memory_order_acquire) - pos;
+      for (const Sequence* d : deps_) {
+        if (d->active_.load(std::memory_order_relaxed)) {
+          n = std::min(n, d->pos_.load(std::memory_order_acquire) - pos);
+        }
+      }
+      return n;
+    }
+
+   private:
+    const std::atomic_uint32_t& cursor_;
+    std::vector<const Sequence*> deps_;
+  };
+
+ public:
+  template <uint32_t S = Size, std::enable_if_t<S != dynamic_size, int> = 0>
+  MulticastQueue() : MulticastQueue(Size, 0) {}
+
+  /// Only for queues of dynamic_size.
+  template <uint32_t S = Size, std::enable_if_t<S == dynamic_size, int> = 0>
+  explicit MulticastQueue(uint32_t capacity) : MulticastQueue(capacity, 0) {}
+
+  ~MulticastQueue() = default;
+
+ private:
+  MulticastQueue(uint32_t capacity, int /*tag*/)
+      : size_(misc::alignUpPowerOf2(checkCapacity(capacity))),
+        mask_(size_ - 1),
+        capacity_(capacity),
+        elems_(new ValueType[size_]) {}
+
+  static auto checkCapacity(uint32_t capacity) -> uint32_t {
+    if (capacity < 1 or capacity > max_capacity) {
+      throw std::runtime_error("invalid capacity of queue");
+    }
+    return capacity;
+  }
+
+ public:
+  static constexpr auto isSingleProducer() -> bool { return not MultiProducer; }
+
+ public:
+  auto producer() -> ProducerType { return ProducerType(*this); }
+
+  /// A consumer of all the elements, which only sees those already consumed by `deps`.
+  auto consumer(std::initializer_list<const ConsumerType*> deps = {}) -> ConsumerType {
+    return ConsumerType(*this, deps);
+  }
+
+ public:
+  template <typename... Args>
+  auto push(Args&&... args) -> bool {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    if (claim(1, Behavior::Fixed, head, next) == 0) {
+      return false;
+    }
+    assign(elems_[head & mask_], std::forward<Args>(args)...);
+    publish(head, next);
+    return true;
+  }
+
+  /// Block until the element is pushed.
+  template <typename... Args>
+  auto pushWait(Args&&... args) -> void {
+    not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                        util::time_point::max());
+  }
+
+  /// Block until the element is pushed or the timeout expires.
+  template <typename Rep, typename Period, typename... Args>
+  auto pushWaitFor(const std::chrono::duration<Rep, Period>& timeout, Args&&... args)
+      -> bool {
+    return not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                               util::clock::now() + timeout);
+  }
+
+  /// All-or-nothing: either all n elements in [first, first + n) are pushed or none.
+  template <typename InputIt>
+  auto pushBulk(InputIt first, uint32_t n) -> bool {
+    return pushN(first, n, Behavior::Fixed) == n;
+  }
+
+  /// Push as many elements of [first, first + n) as fit, returns the number pushed.
+  template <typename InputIt>
+  auto pushBurst(InputIt first, uint32_t n) -> uint32_t {
+    return pushN(first, n, Behavior::Variable);
+  }
+
+  /// Reserve at most n slots, which still hold the elements consumed before, so they
+  /// shall be assigned through SlotSpan::operator[] instead of SlotSpan::emplace.
+  /// Notice:
+  ///     Other producers can not publish until this reservation is committed.
+  auto reserve(uint32_t n) -> SlotSpan<ValueType> {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = claim(n, Behavior::Variable, head, next);
+    return makeSpan<ValueType>(head, n);
+  }
+
+  auto commit(const SlotSpan<ValueType>& span) -> void {
+    if (span.empty()) return;
+    publish(span.pos(), span.pos() + span.size());
+  }
+
+ public:
+  /// Number of published elements, i.e. the sequence the consumers are heading to.
+  [[nodiscard]] auto cursor() const -> uint32_t {
+    return cursor_.load(std::memory_order_acquire);
+  }
+
+ private:
+  /// Fixed claims exactly n slots or nothing, Variable claims as many as possible.
+  enum class Behavior {
+    Fixed,
+    Variable,
+  };
+
+  template <typename... Args>
+  static auto assign(ValueType& slot, Args&&... args) -> void {
+    if constexpr (sizeof...(Args) == 1 and
+                  (std::is_assignable_v<ValueType&, Args> and ...)) {
+      ((slot = std::forward<Args>(args)), ...);
+    } else {
+      slot = ValueType(std::forward<Args>(args)...);
+    }
+  }
+
+  template <typename U>
+  auto makeSpan(uint32_t head, uint32_t n) -> SlotSpan<U> {
+    uint32_t idx = head & mask_;
+    uint32_t n_first = std::min(n, size_ - idx);
+    return SlotSpan<U>(&elems_[idx], n_first, elems_.get(), n - n_first, head);
+  }
+
+  template <typename InputIt>
+  auto pushN(InputIt first, uint32_t n, Behavior behavior) -> uint32_t {
+    uint32_t head = 0;
+    uint32_t next = 0;
+    n = claim(n, behavior, head, next);
+    if (n == 0) return 0;
+    for (uint32_t i = 0; i < n; i++, ++first) {
+      elems_[(head + i) & mask_] = *first;
+    }
+    publish(head, next);
+    return n;
+  }
+
+  /// Free slots ahead of `head` when the slowest consumer is at `gating`.
+  auto freeSlots(uint32_t head, uint32_t gating) const -> uint32_t {
+    uint32_t used = head - gating;
+    return used < capacity_ ? capacity_ - used : 0;
+  }
+
+  /// Sequence of the slowest consumer, or the head when there is no consumer.
+  auto minSequence() const -> uint32_t {
+    std::array<uint32_t, max_consumer> pos{};
+    for (uint32_t i = 0; i < n_sequence_; i++) {
+      pos[i] = sequences_[i].active_.load(std::memory_order_relaxed)
+                   ? sequences_[i].pos_.load(std::memory_order_acquire)
+                   : std::numeric_limits<uint32_t>::max();
+    }
+    // every sequence read above is behind the head read below
+    uint32_t head = head_.load(std::memory_order_acquire);
+    uint32_t lag = 0;
+    for (uint32_t i = 0; i < n_sequence_; i++) {
+      if (pos[i] != std::numeric_limits<uint32_t>::max()) {
+        lag = std::max(lag, head - pos[i]);
+      }
+    }
+    return head - lag;
+  }
+
+  /// Claim up to n slots, [old_head, new_head) is owned by the caller. The slowest
+  /// consumer is only looked up when the one seen last time does not leave room enough.
+  auto claim(uint32_t n, Behavior behavior, uint32_t& old_head, uint32_t& new_head)
+      -> uint32_t {
+    const uint32_t max = n;
+    uint32_t entries = 0;
+
+    old_head = head_.load(std::memory_order_relaxed);
+    auto ok = true;
+    do {
+      n = max;
+      uint32_t gating = gating_.load(std::memory_order_acquire);
+      if (freeSlots(old_head, gating) < n) {
+        gating = minSequence();
+        gating_.store(gating, std::memory_order_release);
+      }
+      if constexpr (MultiProducer) {
+        // others claimed and got consumed since the head was read, which is then behind
+        // the slowest consumer and does not tell the free slots
+        if (static_cast<int32_t>(old_head - gating) < 0) {
+          old_head = head_.load(std::memory_order_relaxed);
+          ok = false;
+          continue;
+        }
+      }
+      entries = freeSlots(old_head, gating);
+      if (n > entries) {
+        n = (behavior == Behavior::Fixed) ? 0 : entries;
+      }
+      if (n == 0) return 0;
+      new_head = old_head + n;
+      if constexpr (not MultiProducer) {
+        head_.store(new_head, std::memory_order_relaxed);
+      } else {
+        ok = head_.compare_exchange_strong(old_head, new_head, std::memory_order_relaxed,
+                                           std::memory_order_relaxed);
+      }
+    } while (not ok);
+    return n;
+  }
+
+  auto publish(uint32_t old_head, uint32_t new_head) -> void {
+    // as in Queue::updateTail, claims are published in order, acquiring the cursor of the
+    // claims before so that a consumer reading up to this one sees their elements
+    if constexpr (MultiProducer) {
+      for (uint32_t i = 1; cursor_.load(std::memory_order_acquire) != old_head; i++) {
+        if (i % tail_wait_spin_limit == 0) {
+          std::this_thread::yield();
+        } else {
+          misc::pause();
+        }
+      }
+    }
+    cursor_.store(new_head, std::memory_order_release);
+    not_empty_.notify(max_consumer);
+  }
+
+ private:
+  auto attach(std::initializer_list<const ConsumerType*> deps) -> Sequence* {
+    if (head_.load(std::memory_order_relaxed) != 0) {
+      throw std::runtime_error("consumers shall be created before the first push");
+    }
+    if (n_sequence_ == max_consumer) {
+      throw std::runtime_error("too many consumers");
+    }
+    for (const ConsumerType* d : deps) {
+      if (&d->q_ != this) {
+        throw std::runtime_error("dependent consumer of another queue");
+      }
+      d->seq_->has_dependents_ = true;
+    }
+    Sequence* s = &sequences_[n_sequence_++];
+    s->active_.store(true, std::memory_order_release);
+    return s;
+  }
+
+  auto detach(Sequence* s) -> void {
+    s->active_.store(false, std::memory_order_release);
+    not_full_.notify(max_consumer);
+    not_empty_.notify(max_consumer);
+  }
+
+ private:
+  alignas(util::cache_line_size) std::atomic_uint32_t head_{0};
+  alignas(util::cache_line_size) std::atomic_uint32_t gating_{0};
+  alignas(util::cache_line_size) std::atomic_uint32_t cursor_{0};
+
+  std::array<Sequence, max_consumer> sequences_{};
+  uint32_t n_sequence_{0};
+
+  alignas(util::cache_line_size) Wait not_full_{};
+  Wait not_empty_{};
+
+  uint32_t size_{};
+  uint32_t mask_{};
+  uint32_t capacity_{};
+  DescriptorCounter counter_{MultiProducer ? -1 : 1, -1};
+
+  std::unique_ptr<ValueType[]> elems_{nullptr};
+};
+
+/// A consumer of a MulticastQueue, which sees every element in order.
+///
+/// Elements are consumed in batches: the consumer reads as many elements as its barrier
+/// allows, then publishes its new sequence once for the whole batch.
+template <typename Queue>
+class MulticastConsumer : util::Noncopyable {
+ public:
+  using ValueType = typename Queue::ValueType;
+
+  constexpr static uint32_t unlimited = std::numeric_limits<uint32_t>::max();
+
+ public:
+  friend Queue;
+
+ public:
+  MulticastConsumer(Queue& q, std::initializer_list<const MulticastConsumer*> deps)
+      : q_(q), seq_(q.attach(deps)), barrier_(q.cursor_, sequencesOf(deps)) {}
+  ~MulticastConsumer() { q_.detach(seq_); }
+
+ public:
+  /// Call `handler(e, seq, end_of_batch)` for at most `max_batch` readable elements,
+  /// returns the number of elements handled.
+  template <typename Handler>
+  auto poll(Handler&& handler, uint32_t max_batch = unlimited) -> uint32_t {
+    uint32_t n = std::min(ready(), max_batch);
+    for (uint32_t i = 0; i < n; i++) {
+      const ValueType& e = q_.elems_[(pos_ + i) & q_.mask_];
+      handler(e, pos_ + i, i + 1 == n);
+    }
+    advance(n);
+    return n;
+  }
+
+  /// Block until at least one element is handled.
+  template <typename Handler>
+  auto pollWait(Handler&& handler, uint32_t max_batch = unlimited) -> uint32_t {
+    uint32_t n = 0;
+    q_.not_empty_.waitUntil([&] { return (n = poll(handler, max_batch)) != 0; },
+                            util::time_point::max());
+    return n;
+  }
+
+  auto pop(ValueType& e) -> bool {
+    return poll([&e](const ValueType& x, uint32_t, bool) { e = x; }, 1) == 1;
+  }
+
+  auto popWait(ValueType& e) -> void {
+    q_.not_empty_.waitUntil([&] { return pop(e); }, util::time_point::max());
+  }
+
+  template <typename Rep, typename Period>
+  auto popWaitFor(ValueType& e, const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return q_.not_empty_.waitUntil([&] { return pop(e); }, util::clock::now() + timeout);
+  }
+
+  /// Peek at most n readable elements in place, they are passed by release().
+  auto peek(uint32_t n) -> SlotSpan<const ValueType> {
+    return q_.template makeSpan<const ValueType>(pos_, std::min(ready(), n));
+  }
+
+  auto release(const SlotSpan<const ValueType>& span) -> void { advance(span.size()); }
+
+ public:
+  /// Number of elements consumed so far.
+  [[nodiscard]] auto sequence() const -> uint32_t { return pos_; }
+
+ private:
+  static auto sequencesOf(std::initializer_list<const MulticastConsumer*> deps)
+      -> std::vector<const typename Queue::Sequence*> {
+    std::vector<const typename Queue::Sequence*> seqs;
+    for (const MulticastConsumer* d : deps) {
+      seqs.push_back(d->seq_);
+    }
+    return seqs;
+  }
+
+  /// Number of readable elements, the barrier is only checked when all the elements
+  /// seen readable last time are consumed.
+  auto ready() -> uint32_t {
+    if (limit_ == pos_) {
+      limit_ = pos_ + barrier_.available(pos_);
+    }
+    return limit_ - pos_;
+  }
+
+  auto advance(uint32_t n) -> void {
+    if (n == 0) return;
+    pos_ += n;
+    seq_->pos_.store(pos_, std::memory_order_release);
+    q_.not_full_.notify(n);
+    if (seq_->has_dependents_) {
+      q_.not_empty_.notify(Queue::max_consumer);
+    }
+  }
+
+ private:
+  Queue& q_;
+  typename Queue::Sequence* seq_;
+  typename Queue::SequenceBarrier barrier_;
+  uint32_t pos_{0};
+  uint32_t limit_{0};
+};
+
+}  // namespace toolbox::container
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <fcntl.h>
+#include <fmt/core.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+
+#include "mpmc.hh"
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/math.hh"
+
+namespace toolbox::container {
+
+enum class ShmOpen {
+  Create,
+  Attach,
+};
+
+/// A Queue placed in a shared memory region, so that producers and consumers can live
+/// in different processes. The region holds a small header, the queue (handles, metadata
+/// and DescriptorCounter) and then the slots. The queue refers to its slots by offset,
+/// so every process may map the region at a different address, and the descriptor
+/// limits are enforced across all the attached processes.
+///
+/// Notice:
+///     A process which dies while holding a producer or consumer never gives it back.
+template <typename T, uint32_t Size, QueueMode Mode, typename Wait = util::SpinWait>
+class SharedQueue : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using ValueType = T;
+  using QueueType = Queue<ValueType, Size, Mode, Wait>;
+  using ProducerType = typename QueueType::ProducerType;
+  using ConsumerType = typename QueueType::ConsumerType;
+
+  static_assert(std::is_trivially_copyable_v<ValueType>,
+                "only trivially copyable types can be shared between processes");
+  static_assert(std::atomic_uint32_t::is_always_lock_free and
+                    std::atomic_uint64_t::is_always_lock_free,
+                "atomics in shared memory must be lock free");
+
+ private:
+  class Header {
+   public:
+    std::atomic_uint64_t magic_;
+    uint64_t region_size_;
+    uint32_t value_size_;
+    uint32_t queue_size_;
+    uint32_t capacity_;
+    uint32_t mode_;
+  };
+
+  constexpr static uint64_t magic = 0x71786f626c6f6f74;  // "toolboxq"
+  constexpr static size_t queue_offset =
+      misc::alignUp(sizeof(Header), alignof(QueueType));
+  constexpr static size_t slots_offset =
+      misc::alignUp(queue_offset + sizeof(QueueType),
+                    std::max(alignof(ValueType), util::cache_line_size));
+
+ public:
+  /// Create or attach the POSIX shared memory object `name`, see shm_open(3). The
+  /// creator unlinks the name when it is destroyed, attached processes keep working.
+  /// `capacity` is only used to create a queue of dynamic_size.
+  SharedQueue(const std::string& name, ShmOpen flag, uint32_t capacity = Size)
+      : name_(name), flag_(flag), owns_fd_(true) {
+    int oflag = O_RDWR | (flag == ShmOpen::Create ? O_CREAT | O_EXCL : 0);
+    fd_ = ::shm_open(name.c_str(), oflag, 0600);
+    if (fd_ < 0) {
+      throw std::runtime_error(
+          fmt::format("fail to open shared memory {}: {}", name, std::strerror(errno)));
+    }
+    init(capacity);
+  }
+
+  /// Create or attach the queue in any file which can be mapped, e.g. one made by
+  /// memfd_create(2) and passed to children. The descriptor is not owned.
+  SharedQueue(int fd, ShmOpen flag, uint32_t capacity = Size)
+      : fd_(fd), flag_(flag), owns_fd_(false) {
+    init(capacity);
+  }
+
+  ~SharedQueue() { cleanup(); }
+
+ public:
+  auto queue() -> QueueType& { return *queue_; }
+  auto producer() -> ProducerType { return queue_->producer(); }
+  auto consumer() -> ConsumerType { return queue_->consumer(); }
+
+  [[nodiscard]] auto capacity() const -> uint32_t { return header_->capacity_; }
+  [[nodiscard]] auto regionSize() const -> size_t { return region_size_; }
+
+  static auto regionSize(uint32_t capacity) -> size_t {
+    return slots_offset + QueueType::storageSize(capacity);
+  }
+
+ private:
+  auto init(uint32_t capacity) -> void {
+    try {
+      if (flag_ == ShmOpen::Create) {
+        create(capacity);
+      } else {
+        attach();
+      }
+    } catch (...) {
+      cleanup();
+      throw;
+    }
+  }
+
+  auto create(uint32_t capacity) -> void {
+    if (Size != dynamic_size and capacity != Size) {
+      throw std::runtime_error("capacity of shared queue mismatches its size");
+    }
+    region_size_ = regionSize(QueueType::checkCapacity(capacity));
+    if (::ftruncate(fd_, static_cast<off_t>(region_size_)) != 0) {
+      throw std::runtime_error(
+          fmt::format("fail to resize shared memory: {}", std::strerror(errno)));
+    }
+    map();
+    queue_ = new (base_ + queue_offset) QueueType(
+        capacity, capacity / 8, reinterpret_cast<ValueType*>(base_ + slots_offset));
+    header_ = new (base_) Header();
+    header_->region_size_ = region_size_;
+    header_->value_size_ = sizeof(ValueType);
+    header_->queue_size_ = sizeof(QueueType);
+    header_->capacity_ = capacity;
+    header_->mode_ = Mode;
+    // publish the initialized region to attaching processes
+    header_->magic_.store(magic, std::memory_order_release);
+  }
+
+  auto attach() -> void {
+    struct stat st {};
+    if (::fstat(fd_, &st) != 0) {
+      throw std::runtime_error(
+          fmt::format("fail to stat shared memory: {}", std::strerror(errno)));
+    }
+    region_size_ = st.st_size;
+    if (region_size_ < slots_offset) {
+      throw std::runtime_error("shared queue is not initialized");
+    }
+    map();
+    header_ = reinterpret_cast<Header*>(base_);
+    if (header_->magic_.load(std::memory_order_acquire) != magic) {
+      throw std::runtime_error("shared queue is not initialized");
+    }
+    if (header_->value_size_ != sizeof(ValueType) or
+        header_->queue_size_ != sizeof(QueueType) or header_->mode_ != Mode or
+        (Size != dynamic_size and header_->capacity_ != Size) or
+        header_->region_size_ != region_size_ or
+        regionSize(header_->capacity_) != region_size_) {
+      throw std::runtime_error("shared queue has a different type");
+    }
+    queue_ = reinterpret_cast<QueueType*>(base_ + queue_offset);
+  }
+
+  auto map() -> void {
+    void* p = ::mmap(nullptr, region_size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+    if (p == MAP_FAILED) {
+      throw std::runtime_error(
+          fmt::format("fail to map shared memory: {}", std::strerror(errno)));
+    }
+    base_ = static_cast<char*>(p);
+  }
+
+  /// The queue itself is never destroyed, its elements are trivially destructible and
+  /// its storage goes away with the last mapping.
+  auto cleanup() -> void {
+    if (base_ != nullptr) {
+      ::munmap(base_, region_size_);
+      base_ = nullptr;
+    }
+    if (owns_fd_ and fd_ >= 0) {
+      ::close(fd_);
+      fd_ = -1;
+    }
+    if (flag_ == ShmOpen::Create and not name_.empty()) {
+      ::shm_unlink(name_.c_str());
+      name_.clear();
+    }
+  }
+
+ private:
+  std::string name_{};
+  int fd_{-1};
+  ShmOpen flag_;
+  bool owns_fd_;
+  char* base_{nullptr};
+  size_t region_size_{0};
+  Header* header_{nullptr};
+  QueueType* queue_{nullptr};
+};
+
+}  // namespace toolbox::container
@@ -1,19 +1,30 @@
 #pragma once
 
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <limits>
 #include <new>
+#include <type_traits>
 #include <utility>
 
 #include "descriptor.hh"
+#include "memory/page_alloc.hh"
 #include "util/align.hh"
 #include "util/marker.hh"
+#include "util/timer.hh"
+#include "util/wait.hh"
 
 namespace toolbox::container {
 
-template <typename T, uint32_t Size>
+/// Wait is the strategy of the blocking operations, see util/wait.hh.
+/// Alloc places the slots, see memory/page_alloc.hh, e.g. on huge pages of a NUMA node.
+template <typename T, uint32_t Size, typename Wait = util::SpinWait,
+          typename Alloc = memory::HeapAlloc>
 class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
  public:
   using ValueType = T;
-  using QueueType = BoundedSPSCQueue<ValueType, Size>;
+  using QueueType = BoundedSPSCQueue<ValueType, Size, Wait, Alloc>;
   using ProducerType = QueueProducer<QueueType>;
   using ConsumerType = QueueConsumer<QueueType>;
 
@@ -22,16 +33,13 @@ class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
   friend class QueueConsumer<QueueType>;
 
  public:
-  explicit BoundedSPSCQueue()
-      : size_(Size + 1),
-        elems_(static_cast<ValueType*>(::operator new[](sizeof(ValueType) * size_))) {
-    if (size_ < 2) {
-      throw std::runtime_error("size of queue is too small");
-    }
-    if (elems_ == nullptr) {
-      throw std::bad_alloc();
-    }
-  }
+  template <uint32_t S = Size, std::enable_if_t<S != dynamic_size, int> = 0>
+  explicit BoundedSPSCQueue() : BoundedSPSCQueue(Size, Init{}) {}
+
+  /// Only for queues of dynamic_size.
+  template <uint32_t S = Size, std::enable_if_t<S == dynamic_size, int> = 0>
+  explicit BoundedSPSCQueue(uint32_t capacity) : BoundedSPSCQueue(capacity, Init{}) {}
+
   ~BoundedSPSCQueue() {
     if (not std::is_trivially_destructible<ValueType>()) {
       size_t idx = read_idx_;
@@ -43,7 +51,25 @@ class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
         }
       }
     }
-    ::operator delete[](elems_);
+    Alloc::deallocate(elems_, sizeof(ValueType) * size_);
+  }
+
+ private:
+  struct Init {};
+
+  BoundedSPSCQueue(uint32_t capacity, Init /*unused*/)
+      : size_(checkSize(capacity + 1)),
+        elems_(static_cast<ValueType*>(Alloc::allocate(sizeof(ValueType) * size_))) {
+    if (elems_ == nullptr) {
+      throw std::bad_alloc();
+    }
+  }
+
+  static auto checkSize(uint32_t size) -> uint32_t {
+    if (size < 2) {
+      throw std::runtime_error("size of queue is too small");
+    }
+    return size;
   }
 
  public:
@@ -61,6 +87,7 @@ class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
     if (next != read_idx_.load(std::memory_order_acquire)) {
       new (&elems_[cur_write]) ValueType(std::forward<Args>(args)...);
       write_idx_.store(next, std::memory_order_release);
+      not_empty_.notify(1);
       return true;
     }
     return false;
@@ -78,29 +105,111 @@ class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
     e = std::move(elems_[cur_read]);
     elems_[cur_read].~ValueType();
     read_idx_.store(next, std::memory_order_release);
+    not_full_.notify(1);
     return true;
   }
 
-  // auto front() -> ValueType* {
-  //   auto const cur_read = read_idx_.load(std::memory_order_relaxed);
-  //   if (cur_read == write_idx_.load(std::memory_order_acquire)) {
-  //     return nullptr;
-  //   }
-  //   return &elems_[cur_read];
-  // }
-
-  // auto pop() -> void {
-  //   auto const cur_read = read_idx_.load(std::memory_order_relaxed);
-  //   if (cur_read == write_idx_.load(std::memory_order_acquire)) {
-  //     throw std::runtime_error("meet empty queue");
-  //   }
-  //   auto next = cur_read + 1;
-  //   if (next == size_) {
-  //     next = 0;
-  //   }
-  //   elems_[cur_read].~ValueType();
-  //   read_idx_.store(next, std::memory_order_release);
-  // }
+  /// Block until the element is pushed.
+  template <typename... Args>
+  auto pushWait(Args&&... args) -> void {
+    not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                        util::time_point::max());
+  }
+
+  /// Block until the element is pushed or the timeout expires.
+  template <typename Rep, typename Period, typename... Args>
+  auto pushWaitFor(const std::chrono::duration<Rep, Period>& timeout, Args&&... args)
+      -> bool {
+    return not_full_.waitUntil([&] { return push(std::forward<Args>(args)...); },
+                               util::clock::now() + timeout);
+  }
+
+  /// Block until an element is popped.
+  auto popWait(ValueType& e) -> void {
+    not_empty_.waitUntil([&] { return pop(e); }, util::time_point::max());
+  }
+
+  /// Block until an element is popped or the timeout expires.
+  template <typename Rep, typename Period>
+  auto popWaitFor(ValueType& e, const std::chrono::duration<Rep, Period>& timeout)
+      -> bool {
+    return not_empty_.waitUntil([&] { return pop(e); }, util::clock::now() + timeout);
+  }
+
+ public:
+  auto front() -> ValueType* {
+    auto const cur_read = read_idx_.load(std::memory_order_relaxed);
+    if (cur_read == write_idx_.load(std::memory_order_acquire)) {
+      return nullptr;
+    }
+    return &elems_[cur_read];
+  }
+
+  auto pop() -> void {
+    auto const cur_read = read_idx_.load(std::memory_order_relaxed);
+    if (cur_read == write_idx_.load(std::memory_order_acquire)) {
+      throw std::runtime_error("meet empty queue");
+    }
+    auto next = cur_read + 1;
+    if (next == size_) {
+      next = 0;
+    }
+    elems_[cur_read].~ValueType();
+    read_idx_.store(next, std::memory_order_release);
+    not_full_.notify(1);
+  }
+
+ public:
+  /// Reserve at most n free slots, every slot of the returned span shall be constructed
+  /// (e.g. by SlotSpan::emplace) before the span is handed back to commit().
+  auto reserve(uint32_t n) -> SlotSpan<ValueType> {
+    uint32_t const cur_write = write_idx_.load(std::memory_order_relaxed);
+    uint32_t const cur_read = read_idx_.load(std::memory_order_acquire);
+    uint32_t n_free = cur_read + size_ - cur_write - 1;
+    if (n_free >= size_) {
+      n_free -= size_;
+    }
+    return makeSpan<ValueType>(cur_write, std::min(n, n_free));
+  }
+
+  auto commit(const SlotSpan<ValueType>& span) -> void {
+    write_idx_.store(advance(span.pos(), span.size()), std::memory_order_release);
+    not_empty_.notify(span.size());
+  }
+
+  /// Peek at most n ready elements in place, the elements are destroyed and their slots
+  /// are given back to the producer by release().
+  auto peek(uint32_t n) -> SlotSpan<const ValueType> {
+    uint32_t const cur_read = read_idx_.load(std::memory_order_relaxed);
+    uint32_t const cur_write = write_idx_.load(std::memory_order_acquire);
+    uint32_t n_ready = cur_write + size_ - cur_read;
+    if (n_ready >= size_) {
+      n_ready -= size_;
+    }
+    return makeSpan<const ValueType>(cur_read, std::min(n, n_ready));
+  }
+
+  auto release(const SlotSpan<const ValueType>& span) -> void {
+    if (not std::is_trivially_destructible<ValueType>()) {
+      for (uint32_t i = 0; i < span.size(); i++) {
+        const_cast<ValueType&>(span[i]).~ValueType();
+      }
+    }
+    read_idx_.store(advance(span.pos(), span.size()), std::memory_order_release);
+    not_full_.notify(span.size());
+  }
+
+ private:
+  auto advance(uint32_t idx, uint32_t n) const -> uint32_t {
+    idx += n;
+    return idx >= size_ ? idx - size_ : idx;
+  }
+
+  template <typename U>
+  auto makeSpan(uint32_t idx, uint32_t n) -> SlotSpan<U> {
+    uint32_t n_first = std::min(n, size_ - idx);
+    return SlotSpan<U>(&elems_[idx], n_first, elems_, n - n_first, idx);
+  }
 
  public:
   [[nodiscard]] auto isEmpty() const -> bool {
@@ -137,47 +246,78 @@ class BoundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
 
   [[gnu::unused]] char _tail_pad_[util::cache_line_size - sizeof(std::atomic_uint64_t)]{};
 
+  Wait not_full_{};
+  Wait not_empty_{};
   DescriptorCounter counter_{1, 1};
 };
 
-template <typename T>
+/// An unbounded SPSC queue made of a linked list of blocks of BlockSize elements, the
+/// producer fills the tail block and links a new one when it is full, the consumer
+/// drains the head block and then moves on to the next one.
+///
+/// Drained blocks stay in the list before the head block, so the producer reuses them
+/// instead of allocating. At most `max_retained` blocks are kept, the producer frees the
+/// drained blocks beyond that when it moves to a new block.
+template <typename T, uint32_t BlockSize = 256>
 class UnboundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
  public:
   using ValueType = T;
-  using QueueType = UnboundedSPSCQueue<ValueType>;
+  using QueueType = UnboundedSPSCQueue<ValueType, BlockSize>;
   using ProducerType = QueueProducer<QueueType>;
   using ConsumerType = QueueConsumer<QueueType>;
 
+  static_assert(BlockSize >= 1, "block is too small");
+
+  constexpr static uint32_t unlimited = std::numeric_limits<uint32_t>::max();
+
  public:
   friend class QueueProducer<QueueType>;
   friend class QueueConsumer<QueueType>;
 
  private:
-  class Node {
+  class alignas(util::cache_line_size) Block {
    public:
-    Node() : next_(nullptr) {}
-
-    template <typename... Args>
-    Node(Args&&... args) : next_(nullptr), data_(std::forward<Args>(args)...) {}
+    Block() = default;
+    ~Block() = default;
 
-    ~Node() = default;
+   public:
+    auto slot(uint32_t i) -> ValueType* {
+      return std::launder(reinterpret_cast<ValueType*>(&slots_[i]));
+    }
 
    public:
-    std::atomic<Node*> next_;
-    ValueType data_;
+    std::atomic<Block*> next_{nullptr};
+    std::atomic_uint32_t n_written_{0};
+    std::array<std::aligned_storage_t<sizeof(ValueType), alignof(ValueType)>, BlockSize>
+        slots_;
   };
 
  public:
-  UnboundedSPSCQueue()
-      : head_(new Node), tail_(head_), unused_(head_), head_copy_(head_) {}
+  UnboundedSPSCQueue() : UnboundedSPSCQueue(unlimited) {}
+
+  explicit UnboundedSPSCQueue(uint32_t max_retained)
+      : max_retained_(std::max(max_retained, 1U)) {
+    Block* b = new Block;
+    head_.store(b, std::memory_order_relaxed);
+    tail_ = unused_ = head_copy_ = b;
+  }
+
   ~UnboundedSPSCQueue() {
-    Node* p = unused_;
-    while (p != nullptr) {
-      Node* next = p->next_;
-      delete p;
-      p = next;
+    Block* b = head_.load(std::memory_order_relaxed);
+    uint32_t idx = head_idx_;
+    for (; b != nullptr; b = b->next_.load(std::memory_order_relaxed), idx = 0) {
+      uint32_t end = b->n_written_.load(std::memory_order_relaxed);
+      for (; idx < end; idx++) {
+        b->slot(idx)->~ValueType();
+      }
     }
-  };
+    b = unused_;
+    while (b != nullptr) {
+      Block* next = b->next_.load(std::memory_order_relaxed);
+      delete b;
+      b = next;
+    }
+  }
 
  public:
   auto consumer() -> ConsumerType { return ConsumerType(*this); }
@@ -186,58 +326,88 @@ class UnboundedSPSCQueue : public util::Noncopyable, public util::Nonmovable {
  public:
   template <typename... Args>
   auto push(Args&&... args) -> bool {
-    auto n = newNode(std::forward<Args>(args)...);
-    tail_->next_.store(n, std::memory_order_release);
-    tail_ = n;
-    size_++;
+    if (tail_idx_ == BlockSize) {
+      Block* b = newBlock();
+      tail_->next_.store(b, std::memory_order_release);
+      tail_ = b;
+      tail_idx_ = 0;
+    }
+    new (tail_->slot(tail_idx_)) ValueType(std::forward<Args>(args)...);
+    tail_->n_written_.store(++tail_idx_, std::memory_order_release);
+    n_pushed_.store(n_pushed_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
     return true;
   }
 
   auto pop(ValueType& e) -> bool {
-    auto head_next =
-        head_.load(std::memory_order_relaxed)->next_.load(std::memory_order_acquire);
-    if (head_next != nullptr) {
-      e = std::move(head_next->data_);
-      head_.store(head_next, std::memory_order_release);
-      size_--;
-      return true;
+    Block* head = head_.load(std::memory_order_relaxed);
+    if (head_idx_ == head_limit_) {
+      if (head_idx_ == BlockSize) {
+        Block* next = head->next_.load(std::memory_order_acquire);
+        if (next == nullptr) return false;
+        // hand the drained block back to the producer
+        head_.store(next, std::memory_order_release);
+        head = next;
+        head_idx_ = 0;
+      }
+      head_limit_ = head->n_written_.load(std::memory_order_acquire);
+      if (head_idx_ == head_limit_) return false;
     }
-    return false;
+    ValueType* v = head->slot(head_idx_++);
+    e = std::move(*v);
+    v->~ValueType();
+    n_popped_.store(n_popped_.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
+    return true;
+  }
+
+ public:
+  [[nodiscard]] auto approximateSize() const -> size_t {
+    return n_pushed_.load(std::memory_order_relaxed) -
+           n_popped_.load(std::memory_order_relaxed);
   }
 
+  /// Number of blocks held by the queue, only accurate on the producer thread.
+  [[nodiscard]] auto blockCount() const -> uint32_t { return n_block_; }
+
  private:
-  template <typename... Args>
-  auto newNode(Args&&... args) -> Node* {
-    Node* n = nullptr;
-    if (unused_ != head_copy_) {
-      n = unused_;
-      unused_ = unused_->next_.load(std::memory_order_relaxed);
-      n->data_.~ValueType();
-      new (n) Node(std::forward<Args>(args)...);
-      return n;
+  auto newBlock() -> Block* {
+    if (unused_ == head_copy_) {
+      head_copy_ = head_.load(std::memory_order_acquire);
+    }
+    while (n_block_ > max_retained_ and unused_ != head_copy_) {
+      Block* b = unused_;
+      unused_ = b->next_.load(std::memory_order_relaxed);
+      delete b;
+      n_block_--;
     }
-    head_copy_ = head_.load(std::memory_order_acquire);
     if (unused_ != head_copy_) {
-      n = unused_;
-      unused_ = unused_->next_.load(std::memory_order_relaxed);
-      n->data_.~ValueType();
-      new (n) Node(std::forward<Args>(args)...);
-      return n;
+      Block* b = unused_;
+      unused_ = b->next_.load(std::memory_order_relaxed);
+      b->next_.store(nullptr, std::memory_order_relaxed);
+      b->n_written_.store(0, std::memory_order_relaxed);
+      return b;
     }
-    return new Node(std::forward<Args>(args)...);
+    n_block_++;
+    return new Block;
   }
 
- public:
-  [[nodiscard]] auto approximateSize() const -> size_t { return size_; }
-
  private:
-  alignas(util::cache_line_size) std::atomic<Node*> head_;
-  [[gnu::unused]] char _pad_[util::cache_line_size - sizeof(head_)]{};
-  alignas(util::cache_line_size) Node* tail_;
-  Node* unused_;
-  Node* head_copy_;  // between tail_ and unused_tail_
+  // consumer side
+  alignas(util::cache_line_size) std::atomic<Block*> head_{nullptr};
+  uint32_t head_idx_{0};
+  uint32_t head_limit_{0};
+  std::atomic_size_t n_popped_{0};
+
+  // producer side, blocks from unused_ to head_copy_ are drained
+  alignas(util::cache_line_size) Block* tail_{nullptr};
+  uint32_t tail_idx_{0};
+  Block* unused_{nullptr};
+  Block* head_copy_{nullptr};
+  uint32_t n_block_{1};
+  const uint32_t max_retained_;
+  std::atomic_size_t n_pushed_{0};
 
-  std::atomic_uint32_t size_{0};
   DescriptorCounter counter_{1, 1};
 };
 
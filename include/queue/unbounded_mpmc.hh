@@ -0,0 +1,238 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#include "descriptor.hh"
+#include "mpmc.hh"
+#include "util/align.hh"
+#include "util/hazard.hh"
+#include "util/marker.hh"
+
+namespace toolbox::container {
+
+/// An unbounded MPMC queue made of linked ring segments, after the FAAArrayQueue of
+/// Ramalhete and Correia.
+///
+/// Producers and consumers claim slots of the tail and head segment with a single
+/// fetch_add. A consumer which claims a slot before its producer has filled it marks the
+/// slot as taken, then the producer moves its element to another slot. A full tail
+/// segment is followed by a new one, and an exhausted head segment is retired through
+/// hazard pointers, then kept in a bounded pool for the following segments.
+///
+/// Notice:
+///     push() never fails, pop() may fail while a producer is still writing the only
+///     element in the queue.
+template <typename T, uint32_t SegmentSize = 1024>
+class UnboundedMPMCQueue : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using ValueType = T;
+  using QueueType = UnboundedMPMCQueue<ValueType, SegmentSize>;
+  using ProducerType = QueueProducer<QueueType>;
+  using ConsumerType = QueueConsumer<QueueType>;
+
+  static_assert(SegmentSize >= 2, "segment is too small");
+
+  constexpr static uint32_t default_max_pooled = 8;
+
+ public:
+  friend class QueueProducer<QueueType>;
+  friend class QueueConsumer<QueueType>;
+
+ private:
+  enum CellState : uint32_t {
+    Empty = 0,
+    Full,
+    Taken,
+  };
+
+  class Cell {
+   public:
+    auto value() -> ValueType* {
+      return std::launder(reinterpret_cast<ValueType*>(&data_));
+    }
+
+   public:
+    std::atomic_uint32_t state_{Empty};
+    std::aligned_storage_t<sizeof(ValueType), alignof(ValueType)> data_;
+  };
+
+  class Segment {
+   public:
+    Segment() = default;
+    ~Segment() = default;
+
+   public:
+    /// Only for segments without alive elements and not reachable by other threads.
+    auto reset() -> void {
+      enq_.store(0, std::memory_order_relaxed);
+      deq_.store(0, std::memory_order_relaxed);
+      next_.store(nullptr, std::memory_order_relaxed);
+      for (auto& c : cells_) {
+        c.state_.store(Empty, std::memory_order_relaxed);
+      }
+    }
+
+   public:
+    alignas(util::cache_line_size) std::atomic_uint32_t enq_{0};
+    alignas(util::cache_line_size) std::atomic_uint32_t deq_{0};
+    alignas(util::cache_line_size) std::atomic<Segment*> next_{nullptr};
+    std::array<Cell, SegmentSize> cells_{};
+  };
+
+ public:
+  UnboundedMPMCQueue() : UnboundedMPMCQueue(default_max_pooled) {}
+
+  /// At most `max_pooled` retired segments are kept for reuse, the others are freed, 0
+  /// frees them all. Segments are retired once per SegmentSize pops, so they are scanned
+  /// right away to flow back to the pool.
+  explicit UnboundedMPMCQueue(uint32_t max_pooled)
+      : max_pooled_(max_pooled),
+        pool_(std::max(max_pooled, 1U)),
+        hazards_([this](Segment* s) { recycle(s); }, 1) {
+    Segment* s = allocate();
+    head_.store(s, std::memory_order_relaxed);
+    tail_.store(s, std::memory_order_relaxed);
+  }
+
+  ~UnboundedMPMCQueue() {
+    Segment* s = head_.load(std::memory_order_relaxed);
+    while (s != nullptr) {
+      Segment* next = s->next_.load(std::memory_order_relaxed);
+      uint32_t n = std::min(s->enq_.load(std::memory_order_relaxed), SegmentSize);
+      for (uint32_t i = 0; i < n; i++) {
+        if (s->cells_[i].state_.load(std::memory_order_relaxed) == Full) {
+          s->cells_[i].value()->~ValueType();
+        }
+      }
+      delete s;
+      s = next;
+    }
+    hazards_.reclaimAll();
+    while (pool_.pop(s)) {
+      delete s;
+    }
+  }
+
+ public:
+  auto consumer() -> ConsumerType { return ConsumerType(*this); }
+  auto producer() -> ProducerType { return ProducerType(*this); }
+
+ public:
+  template <typename... Args>
+  auto push(Args&&... args) -> bool {
+    Cell* cell = claim();
+    new (cell->value()) ValueType(std::forward<Args>(args)...);
+    while (not publish(cell)) {
+      // a consumer has given up on this cell, move the element to another one
+      ValueType tmp(std::move(*cell->value()));
+      cell->value()->~ValueType();
+      cell = claim();
+      new (cell->value()) ValueType(std::move(tmp));
+    }
+    hazards_.clear(0);
+    return true;
+  }
+
+  auto pop(ValueType& e) -> bool {
+    while (true) {
+      Segment* head = hazards_.protect(0, head_);
+      uint32_t deq = head->deq_.load(std::memory_order_acquire);
+      if (deq < SegmentSize) {
+        // the tail segment is not full, so there is nothing after it
+        if (deq >= head->enq_.load(std::memory_order_acquire)) break;
+        uint32_t idx = head->deq_.fetch_add(1, std::memory_order_acq_rel);
+        if (idx < SegmentSize) {
+          Cell& cell = head->cells_[idx];
+          if (cell.state_.exchange(Taken, std::memory_order_acq_rel) == Full) {
+            e = std::move(*cell.value());
+            cell.value()->~ValueType();
+            hazards_.clear(0);
+            return true;
+          }
+          continue;
+        }
+      }
+      Segment* next = head->next_.load(std::memory_order_acquire);
+      if (next == nullptr) break;
+      // never leave the tail behind a retired segment
+      Segment* expected = head;
+      tail_.compare_exchange_strong(expected, next, std::memory_order_acq_rel,
+                                    std::memory_order_relaxed);
+      expected = head;
+      if (head_.compare_exchange_strong(expected, next, std::memory_order_acq_rel,
+                                        std::memory_order_relaxed)) {
+        hazards_.clear(0);
+        hazards_.retire(head);
+      }
+    }
+    hazards_.clear(0);
+    return false;
+  }
+
+ public:
+  /// Number of segments allocated from the heap so far, reused ones are not counted.
+  [[nodiscard]] auto allocatedSegments() const -> uint32_t {
+    return n_allocated_.load(std::memory_order_relaxed);
+  }
+
+ private:
+  /// Returns a cell of the tail segment, which stays protected until hazards_.clear(0).
+  auto claim() -> Cell* {
+    while (true) {
+      Segment* tail = hazards_.protect(0, tail_);
+      if (tail->enq_.load(std::memory_order_relaxed) < SegmentSize) {
+        uint32_t idx = tail->enq_.fetch_add(1, std::memory_order_acq_rel);
+        if (idx < SegmentSize) return &tail->cells_[idx];
+      }
+      Segment* next = tail->next_.load(std::memory_order_acquire);
+      if (next == nullptr) {
+        Segment* s = allocate();
+        if (tail->next_.compare_exchange_strong(next, s, std::memory_order_acq_rel,
+                                                std::memory_order_acquire)) {
+          next = s;
+        } else {
+          recycle(s);
+        }
+      }
+      tail_.compare_exchange_strong(tail, next, std::memory_order_acq_rel,
+                                    std::memory_order_relaxed);
+    }
+  }
+
+  auto publish(Cell* cell) -> bool {
+    uint32_t expected = Empty;
+    return cell->state_.compare_exchange_strong(expected, Full, std::memory_order_release,
+                                                std::memory_order_relaxed);
+  }
+
+  auto allocate() -> Segment* {
+    Segment* s = nullptr;
+    if (max_pooled_ > 0 and pool_.pop(s)) return s;
+    n_allocated_.fetch_add(1, std::memory_order_relaxed);
+    return new Segment();
+  }
+
+  auto recycle(Segment* s) -> void {
+    s->reset();
+    if (max_pooled_ == 0 or not pool_.push(s)) {
+      delete s;
+    }
+  }
+
+ private:
+  alignas(util::cache_line_size) std::atomic<Segment*> head_{nullptr};
+  alignas(util::cache_line_size) std::atomic<Segment*> tail_{nullptr};
+  alignas(util::cache_line_size) std::atomic_uint32_t n_allocated_{0};
+  const uint32_t max_pooled_;
+  Queue<Segment*, dynamic_size, QueueMode::MPMC> pool_;
+  util::HazardPointers<Segment> hazards_;
+
+  DescriptorCounter counter_{-1, -1};
+};
+
+}  // namespace toolbox::container
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/math.hh"
+
+namespace toolbox::container {
+
+/// The work-stealing deque of Chase and Lev, with the memory orders of Lê et al.,
+/// "Correct and Efficient Work-Stealing for Weak Memory Models".
+///
+/// The owner pushes and pops at the bottom as in a stack, other threads steal from the
+/// top in FIFO order. The ring grows when the owner pushes to a full one, rings left
+/// behind are only freed with the deque, since a thief may still be reading them.
+///
+/// Notice:
+///     push() and pop() shall only be called by the owner thread. Elements are copied
+///     by thieves before they win the race for them, so they shall be trivially
+///     copyable, e.g. pointers to tasks.
+template <typename T>
+class WorkStealingDeque : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using ValueType = T;
+
+  static_assert(std::is_trivially_copyable_v<ValueType>,
+                "elements of a work-stealing deque shall be trivially copyable");
+
+  constexpr static uint32_t default_capacity = 1024;
+
+ private:
+  class Ring {
+   public:
+    explicit Ring(int64_t size)
+        : size_(size), mask_(size - 1), slots_(new std::atomic<ValueType>[size]) {}
+    ~Ring() = default;
+
+   public:
+    auto get(int64_t i) const -> ValueType {
+      return slots_[i & mask_].load(std::memory_order_relaxed);
+    }
+
+    auto put(int64_t i, ValueType e) -> void {
+      slots_[i & mask_].store(e, std::memory_order_relaxed);
+    }
+
+    /// a ring twice as large holding the elements in [top, bottom)
+    auto grow(int64_t top, int64_t bottom) const -> Ring* {
+      auto* r = new Ring(size_ * 2);
+      for (int64_t i = top; i < bottom; i++) {
+        r->put(i, get(i));
+      }
+      return r;
+    }
+
+   public:
+    const int64_t size_;
+    const int64_t mask_;
+    std::unique_ptr<std::atomic<ValueType>[]> slots_;
+  };
+
+ public:
+  WorkStealingDeque() : WorkStealingDeque(default_capacity) {}
+
+  /// The capacity is rounded up to a power of 2 and doubled each time the deque is full.
+  explicit WorkStealingDeque(uint32_t capacity) {
+    if (capacity < 1 or capacity > max_capacity) {
+      throw std::runtime_error("invalid capacity of deque");
+    }
+    rings_.emplace_back(new Ring(misc::alignUpPowerOf2(capacity)));
+    ring_.store(rings_.back().get(), std::memory_order_relaxed);
+  }
+
+  ~WorkStealingDeque() = default;
+
+  constexpr static uint32_t max_capacity = 1U << 30;
+
+ public:
+  /// Only for the owner.
+  auto push(ValueType e) -> void {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_acquire);
+    Ring* r = ring_.load(std::memory_order_relaxed);
+    if (b - t > r->size_ - 1) {
+      rings_.emplace_back(r->grow(t, b));
+      r = rings_.back().get();
+      ring_.store(r, std::memory_order_release);
+    }
+    r->put(b, e);
+    std::atomic_thread_fence(std::memory_order_release);
+    bottom_.store(b + 1, std::memory_order_relaxed);
+  }
+
+  /// Only for the owner, pops the element pushed last.
+  auto pop(ValueType& e) -> bool {
+    int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+    Ring* r = ring_.load(std::memory_order_relaxed);
+    bottom_.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    if (t > b) {
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+    e = r->get(b);
+    if (t == b) {
+      // the last element, race with the thieves for it
+      auto ok = top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                             std::memory_order_relaxed);
+      bottom_.store(b + 1, std::memory_order_relaxed);
+      return ok;
+    }
+    return true;
+  }
+
+  /// Steal the element pushed first, fails if the deque is empty or another thread wins
+  /// the race for the element.
+  auto steal(ValueType& e) -> bool {
+    int64_t t = top_.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = bottom_.load(std::memory_order_acquire);
+    if (t >= b) return false;
+    Ring* r = ring_.load(std::memory_order_acquire);
+    e = r->get(t);
+    return top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                        std::memory_order_relaxed);
+  }
+
+ public:
+  /// May be stale as soon as it returns, unless called by the owner without thieves.
+  [[nodiscard]] auto approximateSize() const -> uint32_t {
+    int64_t b = bottom_.load(std::memory_order_relaxed);
+    int64_t t = top_.load(std::memory_order_relaxed);
+    return b > t ? static_cast<uint32_t>(b - t) : 0;
+  }
+
+  [[nodiscard]] auto empty() const -> bool { return approximateSize() == 0; }
+
+  /// Only for the owner.
+  [[nodiscard]] auto capacity() const -> uint32_t {
+    return static_cast<uint32_t>(ring_.load(std::memory_order_relaxed)->size_);
+  }
+
+ private:
+  alignas(util::cache_line_size) std::atomic<int64_t> top_{0};
+  alignas(util::cache_line_size) std::atomic<int64_t> bottom_{0};
+  alignas(util::cache_line_size) std::atomic<Ring*> ring_{nullptr};
+  std::vector<std::unique_ptr<Ring>> rings_;
+};
+
+}  // namespace toolbox::container
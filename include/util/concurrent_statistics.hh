@@ -0,0 +1,172 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/statistics.hh"
+#include "util/thread_id.hh"
+#include "util/timer.hh"
+
+namespace toolbox {
+namespace util {
+
+/// Statistics recorded by many threads at once.
+///
+/// Each thread records into its own cache line aligned shard, picked by util::ThreadId
+/// and allocated at its first record(). A shard has a single writer, so record() bumps
+/// its counters by a relaxed load and store, no atomic read-modify-write. snapshot()
+/// sums the shards while the writers keep going.
+///
+/// Notice:
+///     A snapshot may miss the samples being recorded while it is taken, and the
+///     counters of a shard are read one by one, so it is not a consistent cut. The
+///     shard of an exited thread is kept, and reused by the next thread taking its index.
+template <uint32_t N, uint32_t scale>
+class ConcurrentStatistics : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using StatisticsType = Statistics<N, scale>;
+
+ private:
+  class alignas(cache_line_size) Shard {
+   public:
+    static auto bump(std::atomic_uint64_t& c) -> void {
+      c.store(c.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+   public:
+    std::array<std::array<std::atomic_uint64_t, scale>, N> s_{};
+    std::atomic_uint64_t s_inf_{0};
+  };
+
+ public:
+  ConcurrentStatistics() : shards_(new std::atomic<Shard*>[ThreadId::max_thread]) {
+    for (uint32_t i = 0; i < ThreadId::max_thread; i++) {
+      shards_[i].store(nullptr, std::memory_order_relaxed);
+    }
+  }
+
+  ~ConcurrentStatistics() {
+    for (uint32_t i = 0; i < ThreadId::max_thread; i++) {
+      delete shards_[i].load(std::memory_order_relaxed);
+    }
+  }
+
+ public:
+  auto record(uint64_t x) -> void {
+    Shard& shard = local();
+    uint32_t i = 0;
+    uint32_t j = 0;
+    if (StatisticsType::locate(x, i, j)) {
+      Shard::bump(shard.s_[i][j]);
+    } else {
+      Shard::bump(shard.s_inf_);
+    }
+  }
+
+  /// All the samples recorded so far, merged from all the shards.
+  auto snapshot() const -> StatisticsType {
+    StatisticsType r;
+    uint32_t n = ThreadId::highWater();
+    for (uint32_t k = 0; k < n; k++) {
+      const Shard* shard = shards_[k].load(std::memory_order_acquire);
+      if (shard == nullptr) continue;
+      for (uint32_t i = 0; i < N; i++) {
+        for (uint32_t j = 0; j < scale; j++) {
+          r.s[i][j] += shard->s_[i][j].load(std::memory_order_relaxed);
+        }
+      }
+      r.s_inf_ += shard->s_inf_.load(std::memory_order_relaxed);
+    }
+    r.recount();
+    return r;
+  }
+
+ private:
+  auto local() -> Shard& {
+    auto& slot = shards_[ThreadId::get()];
+    Shard* shard = slot.load(std::memory_order_relaxed);
+    if (shard == nullptr) {
+      shard = new Shard();
+      slot.store(shard, std::memory_order_release);
+    }
+    return *shard;
+  }
+
+ private:
+  std::unique_ptr<std::atomic<Shard*>[]> shards_;
+};
+
+/// Periodic snapshots of a ConcurrentStatistics, which give the statistics of the
+/// samples recorded in an interval, e.g. p99 over the last 10s, without resetting the
+/// writers. collect() is called by a single collector thread, typically on a timer.
+template <uint32_t N, uint32_t scale>
+class StatisticsCollector {
+ public:
+  using StatisticsType = Statistics<N, scale>;
+
+  constexpr static uint32_t default_max_history = 64;
+
+ public:
+  /// At most `max_history` snapshots are kept, the one taken at construction included.
+  explicit StatisticsCollector(const ConcurrentStatistics<N, scale>& source,
+                               uint32_t max_history = default_max_history)
+      : source_(source), max_history_(max_history) {
+    if (max_history < 2) {
+      throw std::runtime_error("too short history of statistics");
+    }
+    collect();
+  }
+  ~StatisticsCollector() = default;
+
+ public:
+  auto collect(time_point now = clock::now()) -> void {
+    if (history_.size() == max_history_) {
+      history_.pop_front();
+    }
+    history_.emplace_back(now, source_.snapshot());
+  }
+
+  /// Samples recorded between the last two collect().
+  auto interval() const -> StatisticsType {
+    return between(history_[std::max<size_t>(history_.size(), 2) - 2]);
+  }
+
+  /// Samples recorded from `window` before the last collect() on, at the granularity of
+  /// the collect() period. The window is cut at the oldest snapshot kept.
+  template <typename Rep, typename Period>
+  auto over(const std::chrono::duration<Rep, Period>& window) const -> StatisticsType {
+    time_point since = history_.back().first - window;
+    auto it = history_.rbegin();
+    while (std::next(it) != history_.rend() and it->first > since) {
+      ++it;
+    }
+    return between(*it);
+  }
+
+  /// All the samples as of the last collect().
+  auto total() const -> StatisticsType { return history_.back().second; }
+
+ private:
+  auto between(const std::pair<time_point, StatisticsType>& from) const
+      -> StatisticsType {
+    StatisticsType r = history_.back().second;
+    r -= from.second;
+    return r;
+  }
+
+ private:
+  const ConcurrentStatistics<N, scale>& source_;
+  const uint32_t max_history_;
+  std::deque<std::pair<time_point, StatisticsType>> history_;
+};
+
+}  // namespace util
+}  // namespace toolbox
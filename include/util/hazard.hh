@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include "util/align.hh"
+#include "util/marker.hh"
+#include "util/thread_id.hh"
+
+namespace toolbox {
+namespace util {
+
+/// Hazard pointers guarding the nodes of one lock-free data structure.
+///
+/// A thread announces the node it is about to dereference with protect(), and a node
+/// unlinked from the structure is handed to retire(). Retired nodes are passed to the
+/// reclaimer only when no thread announces them any more, so the reclaimer may free or
+/// reuse them. Each thread owns the record at its util::ThreadId.
+///
+/// Notice:
+///     Retired nodes left by exited threads are reclaimed by the next thread that gets
+///     the same index, or at last by the destructor.
+template <typename T, uint32_t NSlot = 1>
+class HazardPointers : public util::Noncopyable, public util::Nonmovable {
+ public:
+  using Reclaimer = std::function<void(T*)>;
+
+  constexpr static uint32_t min_retired = 4;
+
+ private:
+  class alignas(cache_line_size) Record {
+   public:
+    std::array<std::atomic<T*>, NSlot> slots_{};
+    std::vector<T*> retired_{};
+  };
+
+ public:
+  /// Retired nodes of a thread are scanned once there are `scan_threshold` of them, 0
+  /// picks a threshold growing with the number of threads so that scans are amortized.
+  explicit HazardPointers(Reclaimer reclaimer, uint32_t scan_threshold = 0)
+      : reclaimer_(std::move(reclaimer)),
+        scan_threshold_(scan_threshold),
+        records_(new Record[ThreadId::max_thread]) {}
+  ~HazardPointers() { reclaimAll(); }
+
+ public:
+  /// Announce the node in `src` and return it, the node stays alive until clear(slot).
+  auto protect(uint32_t slot, const std::atomic<T*>& src) -> T* {
+    auto& hp = record().slots_[slot];
+    T* p = src.load(std::memory_order_relaxed);
+    while (true) {
+      hp.store(p, std::memory_order_seq_cst);
+      T* again = src.load(std::memory_order_seq_cst);
+      if (again == p) return p;
+      p = again;
+    }
+  }
+
+  auto clear(uint32_t slot) -> void {
+    record().slots_[slot].store(nullptr, std::memory_order_release);
+  }
+
+  auto clearAll() -> void {
+    for (auto& hp : record().slots_) {
+      hp.store(nullptr, std::memory_order_release);
+    }
+  }
+
+  /// `p` must have been unlinked, so that no thread can protect it from now on.
+  auto retire(T* p) -> void {
+    auto& retired = record().retired_;
+    retired.push_back(p);
+    uint32_t threshold = scan_threshold_ != 0
+                             ? scan_threshold_
+                             : std::max(min_retired, 2 * NSlot * ThreadId::highWater());
+    if (retired.size() >= threshold) {
+      scan(retired);
+    }
+  }
+
+  /// Reclaim all the retired nodes, only when no other thread touches the structure.
+  auto reclaimAll() -> void {
+    for (uint32_t i = 0; i < ThreadId::max_thread; i++) {
+      for (auto p : records_[i].retired_) {
+        reclaimer_(p);
+      }
+      records_[i].retired_.clear();
+    }
+  }
+
+ private:
+  auto record() -> Record& { return records_[ThreadId::get()]; }
+
+  auto scan(std::vector<T*>& retired) -> void {
+    std::vector<T*> hazards;
+    uint32_t n = ThreadId::highWater();
+    for (uint32_t i = 0; i < n; i++) {
+      for (auto& hp : records_[i].slots_) {
+        if (T* p = hp.load(std::memory_order_seq_cst); p != nullptr) {
+          hazards.push_back(p);
+        }
+      }
+    }
+    std::sort(hazards.begin(), hazards.end());
+    auto it = std::partition(retired.begin(), retired.end(), [&hazards](T* p) {
+      return std::binary_search(hazards.begin(), hazards.end(), p);
+    });
+    std::for_each(it, retired.end(), [this](T* p) { reclaimer_(p); });
+    retired.erase(it, retired.end());
+  }
+
+ private:
+  Reclaimer reclaimer_;
+  uint32_t scan_threshold_;
+  std::unique_ptr<Record[]> records_;
+};
+
+}  // namespace util
+}  // namespace toolbox
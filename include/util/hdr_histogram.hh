@@ -0,0 +1,566 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <zlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace toolbox {
+namespace util {
+
+/// A high dynamic range histogram, laid out as the HdrHistogram of Gil Tene.
+///
+/// Values in [lowest, highest] are recorded with `significant_digits` decimal digits of
+/// precision, i.e. the relative error of any reported value is below 10 ^ -digits over
+/// the whole range, e.g. 1ns to 1h at 3 digits. A bucket is a power of 2 range split
+/// into sub-buckets of the same width, the first bucket covers [0, 2 * 10 ^ digits)
+/// units at unit resolution, and every next bucket doubles the width of its half as
+/// many sub-buckets. The slot of a value is found in closed form by a clz, and the
+/// counts are one flat array of (bucket count + 1) * sub-bucket count / 2 Count, about
+/// 270KB for 1ns to 1h at 3 digits with uint64_t counts.
+///
+/// encode() and encodeCompressed() write the HdrHistogram V2 encoding, which the Java,
+/// C and Go HdrHistogram read, and HdrHistogramLogWriter writes it to a histogram log.
+///
+/// Notice:
+///     Values beyond the last bucket are not recorded, record() returns false and they
+///     are counted by overflow() instead.
+template <typename Count = uint64_t>
+class HdrHistogram {
+  static_assert(std::is_unsigned_v<Count>, "Count shall be an unsigned integer");
+
+ public:
+  constexpr static int32_t v2_encoding_cookie = 0x1c849303 | 0x10;
+  constexpr static int32_t v2_compressed_encoding_cookie = 0x1c849304 | 0x10;
+  constexpr static uint32_t v2_header_size = 40;
+  constexpr static uint32_t max_significant_digits = 5;
+
+ public:
+  HdrHistogram(uint64_t lowest, uint64_t highest, uint32_t significant_digits)
+      : lowest_(lowest), highest_(highest), significant_digits_(significant_digits) {
+    if (lowest < 1) {
+      throw std::runtime_error("lowest trackable value shall be at least 1");
+    }
+    if (significant_digits < 1 or significant_digits > max_significant_digits) {
+      throw std::runtime_error("significant digits shall be in [1, 5]");
+    }
+    if (highest < 2 * lowest or highest > uint64_t{std::numeric_limits<int64_t>::max()}) {
+      throw std::runtime_error("invalid highest trackable value");
+    }
+    uint64_t largest_single_unit = 2;
+    for (uint32_t i = 0; i < significant_digits; i++) {
+      largest_single_unit *= 10;
+    }
+    unit_magnitude_ = 63 - __builtin_clzll(lowest);
+    // ceil(log2(largest_single_unit)), at least 2
+    uint32_t sub_bucket_count_magnitude = 64 - __builtin_clzll(largest_single_unit - 1);
+    sub_bucket_half_count_magnitude_ = std::max(sub_bucket_count_magnitude, 2U) - 1;
+    if (unit_magnitude_ + sub_bucket_half_count_magnitude_ > 61) {
+      throw std::runtime_error("lowest trackable value is too large for the digits");
+    }
+    sub_bucket_count_ = 1U << (sub_bucket_half_count_magnitude_ + 1);
+    sub_bucket_half_count_ = sub_bucket_count_ / 2;
+    sub_bucket_mask_ = (uint64_t{sub_bucket_count_} - 1) << unit_magnitude_;
+
+    // buckets needed for the smallest untrackable value to exceed highest
+    uint64_t smallest_untrackable = uint64_t{sub_bucket_count_} << unit_magnitude_;
+    bucket_count_ = 1;
+    while (smallest_untrackable <= highest) {
+      if (smallest_untrackable > uint64_t{std::numeric_limits<int64_t>::max()} / 2) {
+        bucket_count_++;
+        break;
+      }
+      smallest_untrackable <<= 1;
+      bucket_count_++;
+    }
+    counts_.assign((bucket_count_ + 1) * sub_bucket_half_count_, 0);
+    reset();
+  }
+  ~HdrHistogram() = default;
+
+ public:
+  auto reset() -> void {
+    std::fill(counts_.begin(), counts_.end(), 0);
+    total_ = 0;
+    overflow_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+  }
+
+ public:
+  /// Record `n` samples of `value`, returns false if value is beyond the last bucket.
+  auto record(uint64_t value, Count n = 1) -> bool {
+    uint64_t i = indexOf(value);
+    if (i >= counts_.size()) {
+      overflow_ += n;
+      return false;
+    }
+    counts_[i] += n;
+    total_ += n;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+    return true;
+  }
+
+ public:
+  [[nodiscard]] auto lowest() const -> uint64_t { return lowest_; }
+  [[nodiscard]] auto highest() const -> uint64_t { return highest_; }
+  [[nodiscard]] auto significantDigits() const -> uint32_t { return significant_digits_; }
+
+  /// Number of counters, the memory of the histogram is about
+  /// footprint() * sizeof(Count).
+  [[nodiscard]] auto footprint() const -> size_t { return counts_.size(); }
+
+  // sample number
+  [[nodiscard]] auto count() const -> uint64_t { return total_; }
+
+  // samples dropped by record() for being beyond the last bucket
+  [[nodiscard]] auto overflow() const -> uint64_t { return overflow_; }
+
+  // the lowest value equivalent to the smallest sample
+  [[nodiscard]] auto min() const -> uint64_t {
+    return total_ == 0 ? 0 : lowestEquivalent(min_);
+  }
+
+  // the highest value equivalent to the largest sample
+  [[nodiscard]] auto max() const -> uint64_t {
+    return total_ == 0 ? 0 : highestEquivalent(max_);
+  }
+
+  // approximate avg, taking the middle of each sub-bucket
+  [[nodiscard]] auto mean() const -> double {
+    if (total_ == 0) return 0;
+    double sum = 0;
+    forEach([&sum](uint64_t lo, uint64_t hi, uint64_t n) {
+      sum += static_cast<double>(lo + (hi - lo + 1) / 2) * static_cast<double>(n);
+    });
+    return sum / static_cast<double>(total_);
+  }
+
+  /// The p-th (in [0, 1]) percentile sample, reported as the highest value equivalent to
+  /// it, so that the result is never below the actual one, but by the resolution.
+  [[nodiscard]] auto percentile(double p) const -> uint64_t {
+    if (total_ == 0) return 0;
+    p = std::clamp(p, 0.0, 1.0);
+    auto threshold = static_cast<uint64_t>(p * static_cast<double>(total_) + 0.5);
+    threshold = std::max<uint64_t>(threshold, 1);
+    uint64_t acc = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      acc += counts_[i];
+      if (acc >= threshold) {
+        uint64_t v = valueAt(i);
+        return p == 0 ? lowestEquivalent(v) : highestEquivalent(v);
+      }
+    }
+    return max();
+  }
+
+  /// Call f(lowest, highest, count) in ascending order for every sub-bucket with
+  /// samples, where [lowest, highest] is the range of values it stands for.
+  template <typename F>
+  auto forEach(F&& f) const -> void {
+    for (size_t i = 0; i < counts_.size(); i++) {
+      if (counts_[i] == 0) continue;
+      uint64_t v = valueAt(i);
+      f(v, highestEquivalent(v), uint64_t{counts_[i]});
+    }
+  }
+
+ public:
+  // values mapped to the same sub-bucket are equivalent
+  [[nodiscard]] auto lowestEquivalent(uint64_t value) const -> uint64_t {
+    uint32_t b = bucketOf(value);
+    return valueOf(b, subBucketOf(value, b));
+  }
+
+  [[nodiscard]] auto highestEquivalent(uint64_t value) const -> uint64_t {
+    uint32_t b = bucketOf(value);
+    uint32_t s = subBucketOf(value, b);
+    uint32_t shift = unit_magnitude_ + b + (s >= sub_bucket_count_ ? 1 : 0);
+    return valueOf(b, s) + (uint64_t{1} << shift) - 1;
+  }
+
+ public:
+  auto dump() const -> std::string {
+    return fmt::format(
+        "count: {}\n"
+        "avg:   {}\n"
+        "min:   {}\n"
+        "max:   {}\n"
+        "p50:   {}\n"
+        "p90:   {}\n"
+        "p99:   {}\n"
+        "p999:  {}\n"
+        "p9999: {}\n",
+        count(), mean(), min(), max(), percentile(0.5), percentile(0.9),
+        percentile(0.99), percentile(0.999), percentile(0.9999));
+  }
+
+ public:
+  /// Add the samples of `r`, which may have another range or precision, in which case
+  /// each of its sub-buckets is recorded at its lowest equivalent value.
+  auto operator+=(const HdrHistogram& r) -> HdrHistogram& {
+    if (sameLayout(r)) {
+      for (size_t i = 0; i < counts_.size(); i++) {
+        counts_[i] += r.counts_[i];
+      }
+      total_ += r.total_;
+      overflow_ += r.overflow_;
+      if (r.total_ > 0) {
+        min_ = std::min(min_, r.min_);
+        max_ = std::max(max_, r.max_);
+      }
+      return *this;
+    }
+    r.forEach([this](uint64_t lo, uint64_t /*hi*/, uint64_t n) {
+      record(lo, static_cast<Count>(n));
+    });
+    overflow_ += r.overflow_;
+    return *this;
+  }
+
+ public:
+  /// The V2 encoding: a 40 bytes big-endian header, then the counts up to the largest
+  /// sample as ZigZag LEB128 varints, where a run of k > 1 empty counts is written as -k.
+  [[nodiscard]] auto encode() const -> std::vector<uint8_t> {
+    std::vector<uint8_t> buf(v2_header_size);
+    size_t limit = total_ == 0 ? 0 : indexOf(max_) + 1;
+    for (size_t i = 0; i < limit;) {
+      auto n = static_cast<int64_t>(counts_[i++]);
+      int64_t zeros = 0;
+      if (n == 0) {
+        for (zeros = 1; i < limit and counts_[i] == 0; i++) {
+          zeros++;
+        }
+      }
+      // a single empty count is written as 0
+      putVarint(buf, zeros > 1 ? -zeros : n);
+    }
+    putBigEndian(buf.data(), static_cast<uint32_t>(v2_encoding_cookie));
+    putBigEndian(buf.data() + 4, static_cast<uint32_t>(buf.size() - v2_header_size));
+    putBigEndian(buf.data() + 8, uint32_t{0});  // normalizing index offset
+    putBigEndian(buf.data() + 12, significant_digits_);
+    putBigEndian(buf.data() + 16, lowest_);
+    putBigEndian(buf.data() + 24, highest_);
+    double ratio = 1.0;  // integer to double value conversion ratio
+    uint64_t ratio_bits = 0;
+    memcpy(&ratio_bits, &ratio, sizeof(ratio));
+    putBigEndian(buf.data() + 32, ratio_bits);
+    return buf;
+  }
+
+  /// encode() deflated by zlib, behind the compressed cookie and length.
+  [[nodiscard]] auto encodeCompressed(int level = Z_DEFAULT_COMPRESSION) const
+      -> std::vector<uint8_t> {
+    std::vector<uint8_t> raw = encode();
+    uLongf n = compressBound(raw.size());
+    std::vector<uint8_t> buf(8 + n);
+    if (compress2(buf.data() + 8, &n, raw.data(), raw.size(), level) != Z_OK) {
+      throw std::runtime_error("failed to compress histogram");
+    }
+    buf.resize(8 + n);
+    putBigEndian(buf.data(), static_cast<uint32_t>(v2_compressed_encoding_cookie));
+    putBigEndian(buf.data() + 4, static_cast<uint32_t>(n));
+    return buf;
+  }
+
+  /// Decode a V2 encoding, compressed or not.
+  static auto decode(const uint8_t* data, size_t size) -> HdrHistogram {
+    if (size < 8) {
+      throw std::runtime_error("truncated histogram encoding");
+    }
+    auto cookie = static_cast<int32_t>(getBigEndian<uint32_t>(data));
+    if ((cookie & ~0xf0) == (v2_compressed_encoding_cookie & ~0xf0)) {
+      uint32_t n = getBigEndian<uint32_t>(data + 4);
+      if (n > size - 8) {
+        throw std::runtime_error("truncated histogram encoding");
+      }
+      std::vector<uint8_t> raw = inflateAll(data + 8, n);
+      return decode(raw.data(), raw.size());
+    }
+    if ((cookie & ~0xf0) != (v2_encoding_cookie & ~0xf0)) {
+      throw std::runtime_error("not a V2 histogram encoding");
+    }
+    if (size < v2_header_size) {
+      throw std::runtime_error("truncated histogram encoding");
+    }
+    uint32_t payload = getBigEndian<uint32_t>(data + 4);
+    if (getBigEndian<uint32_t>(data + 8) != 0) {
+      throw std::runtime_error("normalizing index offset is not supported");
+    }
+    if (payload > size - v2_header_size) {
+      throw std::runtime_error("truncated histogram encoding");
+    }
+    HdrHistogram h(getBigEndian<uint64_t>(data + 16), getBigEndian<uint64_t>(data + 24),
+                   getBigEndian<uint32_t>(data + 12));
+    const uint8_t* p = data + v2_header_size;
+    const uint8_t* end = p + payload;
+    size_t i = 0;
+    while (p < end) {
+      int64_t n = getVarint(p, end);
+      if (n < 0) {
+        // a run of -n zeros, negated unsigned as -n overflows for INT64_MIN
+        uint64_t zeros = 0 - static_cast<uint64_t>(n);
+        if (zeros > h.counts_.size() - i) {
+          throw std::runtime_error("histogram encoding out of range");
+        }
+        i += zeros;
+        continue;
+      }
+      if (i >= h.counts_.size()) {
+        throw std::runtime_error("histogram encoding out of range");
+      }
+      if (static_cast<uint64_t>(n) > std::numeric_limits<Count>::max()) {
+        throw std::runtime_error("count overflows the counter type");
+      }
+      h.counts_[i++] = static_cast<Count>(n);
+    }
+    h.recount();
+    return h;
+  }
+
+  /// Base64 of encodeCompressed(), as an interval of a histogram log.
+  [[nodiscard]] auto toBase64() const -> std::string {
+    constexpr static char alphabet[] =
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::vector<uint8_t> buf = encodeCompressed();
+    std::string s;
+    s.reserve((buf.size() + 2) / 3 * 4);
+    for (size_t i = 0; i < buf.size(); i += 3) {
+      uint32_t n = uint32_t{buf[i]} << 16;
+      if (i + 1 < buf.size()) n |= uint32_t{buf[i + 1]} << 8;
+      if (i + 2 < buf.size()) n |= buf[i + 2];
+      s += alphabet[(n >> 18) & 0x3f];
+      s += alphabet[(n >> 12) & 0x3f];
+      s += i + 1 < buf.size() ? alphabet[(n >> 6) & 0x3f] : '=';
+      s += i + 2 < buf.size() ? alphabet[n & 0x3f] : '=';
+    }
+    return s;
+  }
+
+  static auto fromBase64(const std::string& s) -> HdrHistogram {
+    auto digit = [](char c) -> int32_t {
+      if (c >= 'A' and c <= 'Z') return c - 'A';
+      if (c >= 'a' and c <= 'z') return c - 'a' + 26;
+      if (c >= '0' and c <= '9') return c - '0' + 52;
+      if (c == '+') return 62;
+      if (c == '/') return 63;
+      return -1;
+    };
+    std::vector<uint8_t> buf;
+    buf.reserve(s.size() / 4 * 3);
+    uint32_t acc = 0;
+    uint32_t bits = 0;
+    for (char c : s) {
+      if (c == '=') break;
+      int32_t d = digit(c);
+      if (d < 0) {
+        throw std::runtime_error("invalid base64 histogram");
+      }
+      acc = (acc << 6) | static_cast<uint32_t>(d);
+      bits += 6;
+      if (bits >= 8) {
+        bits -= 8;
+        buf.push_back(static_cast<uint8_t>(acc >> bits));
+      }
+    }
+    return decode(buf.data(), buf.size());
+  }
+
+ private:
+  [[nodiscard]] auto bucketOf(uint64_t value) const -> uint32_t {
+    // the mask keeps the values of the first bucket in it
+    uint32_t pow2_ceiling = 64 - __builtin_clzll(value | sub_bucket_mask_);
+    return pow2_ceiling - unit_magnitude_ - (sub_bucket_half_count_magnitude_ + 1);
+  }
+
+  [[nodiscard]] auto subBucketOf(uint64_t value, uint32_t bucket) const -> uint32_t {
+    return static_cast<uint32_t>(value >> (bucket + unit_magnitude_));
+  }
+
+  [[nodiscard]] auto indexOf(uint64_t value) const -> uint64_t {
+    uint32_t b = bucketOf(value);
+    uint32_t s = subBucketOf(value, b);
+    // sub-buckets below the half are only used by the first bucket
+    return (uint64_t{b + 1} << sub_bucket_half_count_magnitude_) + s -
+           sub_bucket_half_count_;
+  }
+
+  [[nodiscard]] auto valueOf(uint32_t bucket, uint32_t sub_bucket) const -> uint64_t {
+    return uint64_t{sub_bucket} << (bucket + unit_magnitude_);
+  }
+
+  /// The lowest value of the i-th counter.
+  [[nodiscard]] auto valueAt(size_t i) const -> uint64_t {
+    auto b = static_cast<int64_t>(i >> sub_bucket_half_count_magnitude_) - 1;
+    auto s = static_cast<uint32_t>(i & (sub_bucket_half_count_ - 1)) +
+             sub_bucket_half_count_;
+    if (b < 0) {
+      s -= sub_bucket_half_count_;
+      b = 0;
+    }
+    return valueOf(static_cast<uint32_t>(b), s);
+  }
+
+  [[nodiscard]] auto sameLayout(const HdrHistogram& r) const -> bool {
+    return unit_magnitude_ == r.unit_magnitude_ and
+           sub_bucket_half_count_magnitude_ == r.sub_bucket_half_count_magnitude_ and
+           counts_.size() == r.counts_.size();
+  }
+
+  /// Recount total_, min_ and max_ after the counts are written directly.
+  auto recount() -> void {
+    total_ = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+    for (size_t i = 0; i < counts_.size(); i++) {
+      if (counts_[i] == 0) continue;
+      total_ += counts_[i];
+      min_ = std::min(min_, valueAt(i));
+      max_ = valueAt(i);
+    }
+  }
+
+  template <typename T>
+  static auto putBigEndian(uint8_t* p, T x) -> void {
+    for (size_t i = 0; i < sizeof(T); i++) {
+      p[i] = static_cast<uint8_t>(x >> (8 * (sizeof(T) - 1 - i)));
+    }
+  }
+
+  template <typename T>
+  static auto getBigEndian(const uint8_t* p) -> T {
+    T x = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+      x = static_cast<T>((x << 8) | p[i]);
+    }
+    return x;
+  }
+
+  /// ZigZag LEB128 of at most 9 bytes, the last one carries 8 bits.
+  static auto putVarint(std::vector<uint8_t>& buf, int64_t x) -> void {
+    uint64_t z = (static_cast<uint64_t>(x) << 1) ^ static_cast<uint64_t>(x >> 63);
+    for (uint32_t i = 0; i < 8; i++) {
+      if ((z >> 7) == 0) {
+        buf.push_back(static_cast<uint8_t>(z));
+        return;
+      }
+      buf.push_back(static_cast<uint8_t>((z & 0x7f) | 0x80));
+      z >>= 7;
+    }
+    buf.push_back(static_cast<uint8_t>(z));
+  }
+
+  static auto getVarint(const uint8_t*& p, const uint8_t* end) -> int64_t {
+    uint64_t z = 0;
+    for (uint32_t shift = 0;; shift += 7) {
+      if (p == end) {
+        throw std::runtime_error("truncated histogram encoding");
+      }
+      uint8_t b = *p++;
+      if (shift == 56) {
+        z |= uint64_t{b} << 56;
+        break;
+      }
+      z |= uint64_t{b & 0x7fU} << shift;
+      if ((b & 0x80) == 0) break;
+    }
+    return static_cast<int64_t>((z >> 1) ^ (~(z & 1) + 1));
+  }
+
+  static auto inflateAll(const uint8_t* data, size_t size) -> std::vector<uint8_t> {
+    z_stream zs{};
+    if (inflateInit(&zs) != Z_OK) {
+      throw std::runtime_error("failed to init zlib");
+    }
+    std::vector<uint8_t> out(std::max<size_t>(size * 4, 256));
+    zs.next_in = const_cast<Bytef*>(data);
+    zs.avail_in = static_cast<uInt>(size);
+    int rc = Z_OK;
+    while (rc == Z_OK) {
+      if (zs.total_out == out.size()) {
+        out.resize(out.size() * 2);
+      }
+      zs.next_out = out.data() + zs.total_out;
+      zs.avail_out = static_cast<uInt>(out.size() - zs.total_out);
+      rc = inflate(&zs, Z_NO_FLUSH);
+    }
+    out.resize(zs.total_out);
+    inflateEnd(&zs);
+    if (rc != Z_STREAM_END) {
+      throw std::runtime_error("failed to decompress histogram");
+    }
+    return out;
+  }
+
+ private:
+  const uint64_t lowest_;
+  const uint64_t highest_;
+  const uint32_t significant_digits_;
+  uint32_t unit_magnitude_{0};
+  uint32_t sub_bucket_half_count_magnitude_{0};
+  uint32_t sub_bucket_count_{0};
+  uint32_t sub_bucket_half_count_{0};
+  uint64_t sub_bucket_mask_{0};
+  uint64_t bucket_count_{0};
+
+  std::vector<Count> counts_;
+  uint64_t total_{0};
+  uint64_t overflow_{0};
+  uint64_t min_{0};
+  uint64_t max_{0};
+};
+
+/// Writes histograms as the intervals of a HdrHistogram log, version 1.3, which
+/// HistogramLogReader, HistogramLogProcessor and the HdrHistogram plotters read.
+///
+/// Timestamps are in seconds, those of the intervals relative to the start time.
+class HdrHistogramLogWriter {
+ public:
+  /// Interval_Max is the max value divided by this, e.g. ns recorded and ms reported.
+  constexpr static double default_max_value_unit_ratio = 1000000.0;
+
+ public:
+  explicit HdrHistogramLogWriter(std::ostream& os) : os_(os) {}
+  ~HdrHistogramLogWriter() = default;
+
+ public:
+  /// `start_time` is in seconds since epoch.
+  auto writeHeader(double start_time) -> void {
+    auto t = static_cast<std::time_t>(start_time);
+    std::tm tm{};
+    gmtime_r(&t, &tm);
+    char date[64];
+    std::strftime(date, sizeof(date), "%a %b %d %H:%M:%S UTC %Y", &tm);
+    os_ << "#[Histogram log format version 1.3]\n"
+        << fmt::format("#[StartTime: {:.3f} (seconds since epoch), {}]\n", start_time,
+                       date)
+        << "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\","
+           "\"Interval_Compressed_Histogram\"\n";
+  }
+
+  template <typename Count>
+  auto writeInterval(const HdrHistogram<Count>& h, double start, double length,
+                     double max_value_unit_ratio = default_max_value_unit_ratio)
+      -> void {
+    os_ << fmt::format("{:.3f},{:.3f},{:.3f},{}\n", start, length,
+                       static_cast<double>(h.max()) / max_value_unit_ratio,
+                       h.toBase64());
+  }
+
+ private:
+  std::ostream& os_;
+};
+
+}  // namespace util
+}  // namespace toolbox
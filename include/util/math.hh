@@ -24,5 +24,11 @@ namespace misc {
   return x + 1;
 }
 
+/// align must be a power of 2
+[[gnu::unused]] constexpr static inline auto alignUp(uint64_t x, uint64_t align)
+    -> uint64_t {
+  return (x + align - 1) & ~(align - 1);
+}
+
 }  // namespace misc
 }  // namespace toolbox
\ No newline at end of file
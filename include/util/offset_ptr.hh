@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace toolbox {
+namespace util {
+
+/// A pointer stored as the distance from itself to the pointee, so that an object and
+/// what it points to can be mapped at different addresses by different processes, as
+/// long as they are mapped together (e.g. in one shared memory region).
+template <typename T>
+class OffsetPtr {
+  // 1 can never be the distance to a properly aligned pointee
+  constexpr static std::ptrdiff_t null_offset = 1;
+
+ public:
+  OffsetPtr() = default;
+  OffsetPtr(T* p) { set(p); }  // NOLINT(google-explicit-constructor)
+  OffsetPtr(const OffsetPtr& r) { set(r.get()); }
+  auto operator=(const OffsetPtr& r) -> OffsetPtr& {
+    set(r.get());
+    return *this;
+  }
+  auto operator=(T* p) -> OffsetPtr& {
+    set(p);
+    return *this;
+  }
+  ~OffsetPtr() = default;
+
+ public:
+  auto get() const -> T* { return off_ == null_offset ? nullptr : raw(); }
+
+  // the following ones shall not be used on null, so they skip the check
+  auto operator[](size_t i) const -> T& { return raw()[i]; }
+  auto operator*() const -> T& { return *raw(); }
+  auto operator->() const -> T* { return raw(); }
+  explicit operator bool() const { return off_ != null_offset; }
+
+ private:
+  auto raw() const -> T* {
+    return reinterpret_cast<T*>(reinterpret_cast<uintptr_t>(this) + off_);
+  }
+
+  auto set(T* p) -> void {
+    if (p == nullptr) {
+      off_ = null_offset;
+      return;
+    }
+    off_ = static_cast<std::ptrdiff_t>(reinterpret_cast<uintptr_t>(p) -
+                                       reinterpret_cast<uintptr_t>(this));
+  }
+
+ private:
+  std::ptrdiff_t off_{null_offset};
+};
+
+}  // namespace util
+}  // namespace toolbox
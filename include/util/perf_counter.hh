@@ -0,0 +1,135 @@
+#pragma once
+
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+#include "util/marker.hh"
+
+namespace toolbox {
+namespace util {
+
+/// Hardware counters of the calling thread, read with perf_event_open(2) as a single
+/// group, so that all the events count over the same region.
+///
+/// The events which fail to open, e.g. an event the cpu lacks, are left out, and if none
+/// opens, e.g. perf_event_paranoid forbids it or in a container without perf, the
+/// counters are not available() and read() gives nothing, so that a caller can measure
+/// the same way with or without them. The counts are scaled by the time the group ran
+/// over the time it was enabled, if the kernel had to multiplex the counters.
+///
+/// Notice:
+///     Only user space is counted, and only on the thread which built the counters.
+class PerfCounters : public util::Noncopyable, public util::Nonmovable {
+ public:
+  struct Event {
+    std::string name_;
+    uint32_t type_;  // PERF_TYPE_*
+    uint64_t config_;
+  };
+
+  /// cycles, instructions, LLC misses, and on Intel the loads hitting a modified line in
+  /// the cache of another core (HITM), i.e. the cache to cache transfers.
+  static auto defaultEvents() -> std::vector<Event> {
+    std::vector<Event> events{
+        {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        {"instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        {"llc-misses", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    };
+    if (isIntel()) {
+      // MEM_LOAD_L3_HIT_RETIRED.XSNP_HITM, XSNP_FWD since Ice Lake, same encoding
+      events.push_back({"hitm", PERF_TYPE_RAW, 0x04d2});
+    }
+    return events;
+  }
+
+ public:
+  explicit PerfCounters(const std::vector<Event>& events = defaultEvents()) {
+    for (const Event& e : events) {
+      perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.size = sizeof(attr);
+      attr.type = e.type_;
+      attr.config = e.config_;
+      attr.disabled = leader_ < 0 ? 1 : 0;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                         PERF_FORMAT_TOTAL_TIME_RUNNING;
+      auto fd = static_cast<int>(
+          ::syscall(SYS_perf_event_open, &attr, 0, -1, leader_, PERF_FLAG_FD_CLOEXEC));
+      if (fd < 0) continue;
+      if (leader_ < 0) leader_ = fd;
+      fds_.push_back(fd);
+      names_.push_back(e.name_);
+    }
+  }
+
+  ~PerfCounters() {
+    for (int fd : fds_) ::close(fd);
+  }
+
+ public:
+  auto available() const -> bool { return leader_ >= 0; }
+
+  auto start() -> void {
+    if (not available()) return;
+    ::ioctl(leader_, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+    ::ioctl(leader_, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  auto stop() -> void {
+    if (not available()) return;
+    ::ioctl(leader_, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  }
+
+  /// The counts since the last start(), by the names of the events.
+  auto read() const -> std::vector<std::pair<std::string, double>> {
+    std::vector<std::pair<std::string, double>> r;
+    if (not available()) return r;
+    // nr, time enabled, time running, then a value per event
+    std::vector<uint64_t> buf(3 + fds_.size());
+    auto size = static_cast<ssize_t>(buf.size() * sizeof(uint64_t));
+    if (::read(leader_, buf.data(), buf.size() * sizeof(uint64_t)) != size) return r;
+    double scale = 0;
+    if (buf[2] > 0) scale = static_cast<double>(buf[1]) / static_cast<double>(buf[2]);
+    for (size_t i = 0; i < buf[0] and i < names_.size(); i++) {
+      r.emplace_back(names_[i], static_cast<double>(buf[3 + i]) * scale);
+    }
+    return r;
+  }
+
+ private:
+  static auto isIntel() -> bool {
+#if defined(__x86_64__)
+    uint32_t eax = 0;
+    uint32_t ebx = 0;
+    uint32_t ecx = 0;
+    uint32_t edx = 0;
+    if (__get_cpuid(0, &eax, &ebx, &ecx, &edx) == 0) return false;
+    // "GenuineIntel" in ebx, edx, ecx
+    return ebx == 0x756e6547 and edx == 0x49656e69 and ecx == 0x6c65746e;
+#else
+    return false;
+#endif
+  }
+
+ private:
+  int leader_{-1};
+  std::vector<int> fds_;
+  std::vector<std::string> names_;
+};
+
+}  // namespace util
+}  // namespace toolbox
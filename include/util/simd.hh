@@ -0,0 +1,222 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define TOOLBOX_SIMD_X86 1
+#endif
+
+namespace toolbox {
+namespace util {
+
+/// Kernels over arrays of uint64_t counters, e.g. the buckets of a histogram.
+///
+/// Each kernel has a scalar version, an SSE2 one, which is the baseline of x86-64, and an
+/// AVX2 one picked at runtime if the cpu supports it, so that no -march is needed. The
+/// dispatching one, e.g. addArray(), is the one to call, the others are kept for tests
+/// and benchmarks.
+
+inline auto hasAVX2() -> bool {
+#if defined(TOOLBOX_SIMD_X86)
+  static const bool has = [] {
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") != 0;
+  }();
+  return has;
+#else
+  return false;
+#endif
+}
+
+/// dst[i] += src[i]
+inline auto addArrayScalar(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] += src[i];
+  }
+}
+
+/// dst[i] -= src[i]
+inline auto subArrayScalar(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+  for (size_t i = 0; i < n; i++) {
+    dst[i] -= src[i];
+  }
+}
+
+/// sum of src[i]
+inline auto sumArrayScalar(const uint64_t* src, size_t n) -> uint64_t {
+  uint64_t acc = 0;
+  for (size_t i = 0; i < n; i++) {
+    acc += src[i];
+  }
+  return acc;
+}
+
+/// dst[i] = src[0] + ... + src[i], returns the total
+inline auto prefixSumScalar(const uint64_t* src, uint64_t* dst, size_t n) -> uint64_t {
+  uint64_t acc = 0;
+  for (size_t i = 0; i < n; i++) {
+    acc += src[i];
+    dst[i] = acc;
+  }
+  return acc;
+}
+
+#if defined(TOOLBOX_SIMD_X86)
+
+inline auto addArraySSE2(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi64(a, b));
+  }
+  addArrayScalar(dst + i, src + i, n - i);
+}
+
+inline auto subArraySSE2(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(dst + i));
+    __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_sub_epi64(a, b));
+  }
+  subArrayScalar(dst + i, src + i, n - i);
+}
+
+inline auto sumArraySSE2(const uint64_t* src, size_t n) -> uint64_t {
+  __m128i acc = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    acc = _mm_add_epi64(acc, _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i)));
+  }
+  acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) + sumArrayScalar(src + i, n - i);
+}
+
+inline auto prefixSumSSE2(const uint64_t* src, uint64_t* dst, size_t n) -> uint64_t {
+  __m128i carry = _mm_setzero_si128();
+  size_t i = 0;
+  for (; i + 2 <= n; i += 2) {
+    __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+    // [a, b] -> [a, a + b]
+    v = _mm_add_epi64(v, _mm_slli_si128(v, 8));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + i), _mm_add_epi64(v, carry));
+    // the carry chain is a single add, the prefix of the next block does not wait
+    carry = _mm_add_epi64(carry, _mm_unpackhi_epi64(v, v));
+  }
+  auto acc = static_cast<uint64_t>(_mm_cvtsi128_si64(carry));
+  for (; i < n; i++) {
+    acc += src[i];
+    dst[i] = acc;
+  }
+  return acc;
+}
+
+[[gnu::target("avx2")]] inline auto addArrayAVX2(uint64_t* dst, const uint64_t* src,
+                                                 size_t n) -> void {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi64(a, b));
+  }
+  addArrayScalar(dst + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]] inline auto subArrayAVX2(uint64_t* dst, const uint64_t* src,
+                                                 size_t n) -> void {
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(dst + i));
+    __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_sub_epi64(a, b));
+  }
+  subArrayScalar(dst + i, src + i, n - i);
+}
+
+[[gnu::target("avx2")]] inline auto sumArrayAVX2(const uint64_t* src, size_t n)
+    -> uint64_t {
+  // two accumulators to hide the latency of the adds
+  __m256i acc0 = _mm256_setzero_si256();
+  __m256i acc1 = _mm256_setzero_si256();
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_epi64(
+        acc0, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i)));
+    acc1 = _mm256_add_epi64(
+        acc1, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i + 4)));
+  }
+  acc0 = _mm256_add_epi64(acc0, acc1);
+  __m128i acc = _mm_add_epi64(_mm256_castsi256_si128(acc0),
+                              _mm256_extracti128_si256(acc0, 1));
+  acc = _mm_add_epi64(acc, _mm_unpackhi_epi64(acc, acc));
+  return static_cast<uint64_t>(_mm_cvtsi128_si64(acc)) + sumArrayScalar(src + i, n - i);
+}
+
+[[gnu::target("avx2")]] inline auto prefixSumAVX2(const uint64_t* src, uint64_t* dst,
+                                                  size_t n) -> uint64_t {
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i carry = zero;
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4) {
+    __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + i));
+    // [a, b, c, d] -> [a, a + b, b + c, c + d]
+    v = _mm256_add_epi64(
+        v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x90), zero, 0x03));
+    // -> [a, a + b, a + b + c, a + b + c + d]
+    v = _mm256_add_epi64(
+        v, _mm256_blend_epi32(_mm256_permute4x64_epi64(v, 0x40), zero, 0x0f));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + i), _mm256_add_epi64(v, carry));
+    // the carry chain is a single add, the prefix of the next block does not wait
+    carry = _mm256_add_epi64(carry, _mm256_permute4x64_epi64(v, 0xff));
+  }
+  auto acc = static_cast<uint64_t>(_mm256_extract_epi64(carry, 0));
+  for (; i < n; i++) {
+    acc += src[i];
+    dst[i] = acc;
+  }
+  return acc;
+}
+
+#endif
+
+inline auto addArray(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+#if defined(TOOLBOX_SIMD_X86)
+  if (hasAVX2()) return addArrayAVX2(dst, src, n);
+  return addArraySSE2(dst, src, n);
+#else
+  return addArrayScalar(dst, src, n);
+#endif
+}
+
+inline auto subArray(uint64_t* dst, const uint64_t* src, size_t n) -> void {
+#if defined(TOOLBOX_SIMD_X86)
+  if (hasAVX2()) return subArrayAVX2(dst, src, n);
+  return subArraySSE2(dst, src, n);
+#else
+  return subArrayScalar(dst, src, n);
+#endif
+}
+
+inline auto sumArray(const uint64_t* src, size_t n) -> uint64_t {
+#if defined(TOOLBOX_SIMD_X86)
+  if (hasAVX2()) return sumArrayAVX2(src, n);
+  return sumArraySSE2(src, n);
+#else
+  return sumArrayScalar(src, n);
+#endif
+}
+
+inline auto prefixSum(const uint64_t* src, uint64_t* dst, size_t n) -> uint64_t {
+#if defined(TOOLBOX_SIMD_X86)
+  if (hasAVX2()) return prefixSumAVX2(src, dst, n);
+  return prefixSumSSE2(src, dst, n);
+#else
+  return prefixSumScalar(src, dst, n);
+#endif
+}
+
+}  // namespace util
+}  // namespace toolbox
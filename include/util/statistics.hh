@@ -3,129 +3,138 @@
 #include <fmt/core.h>
 
 #include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <string>
 
+#include "util/simd.hh"
+
 namespace toolbox {
 namespace util {
 
+template <uint32_t N, uint32_t scale>
+class ConcurrentStatistics;
+
 /// Suggestion:
 ///     (2 ^ N - 1) * scale >= upper bound of the data
 /// Notice:
 ///     The results are always smaller or equal to the actual statistics.
+///
+/// Level i has `scale` buckets of width 2 ^ i starting from (2 ^ i - 1) * scale, so the
+/// bucket of a sample is found in closed form by a clz. count() and sum() are kept up to
+/// date by record(), and the other queries binary search the cumulative counts, which
+/// are rebuilt on the first query after a change. Merging and rebuilding walk the
+/// buckets as one flat array with the SIMD kernels of util/simd.hh.
 template <uint32_t N, uint32_t scale>
 class Statistics {
   static_assert(N >= 1, "N is too small");
+  static_assert(N < 32, "N is too large");
   static_assert(scale > 1, "scale is too small");
 
+  constexpr static uint32_t n_bucket = N * scale;
+
  public:
   Statistics() { reset(); }
   ~Statistics() = default;
 
  public:
-  auto reset() -> void { memset(this, 0, sizeof(Statistics)); }
+  auto reset() -> void {
+    // the cumulative counts are left as they are, and rebuilt by the next query
+    memset(s, 0, sizeof(s));
+    s_inf_ = 0;
+    count_ = 0;
+    sum_ = 0;
+    dirty_ = true;
+  }
 
  public:
   auto record(uint64_t x) -> void {
-    uint32_t n = 0;
-    uint32_t y = 0;
-    for (uint32_t i = 0; i < N; i++) {
-      n = (1 << i);
-      y = x / n;
-      if (y < scale) {
-        s[i][y]++;
-        return;
-      }
-      x -= scale * n;
+    uint32_t i = 0;
+    uint32_t j = 0;
+    if (locate(x, i, j)) {
+      s[i][j]++;
+      sum_ += lowerBound(i, j);
+    } else {
+      s_inf_++;
+      sum_ += upperBound();
     }
-    s_inf_++;
+    count_++;
+    dirty_ = true;
+  }
+
+  /// The bucket s[i][j] of x, returns false if x is beyond the last bucket.
+  static auto locate(uint64_t x, uint32_t& i, uint32_t& j) -> bool {
+    // x lies in level i iff 2 ^ i <= x / scale + 1 < 2 ^ (i + 1)
+    uint64_t q = x / scale + 1;
+    i = 63 - __builtin_clzll(q);
+    if (i >= N) return false;
+    j = static_cast<uint32_t>((x - scale * ((uint64_t{1} << i) - 1)) >> i);
+    return true;
   }
 
  public:
   // sample number
-  auto count() -> uint64_t {
-    uint64_t cnt = s_inf_;
-    for (uint32_t i = 0; i < N; i++) {
-      for (uint32_t j = 0; j < scale; j++) {
-        cnt += s[i][j];
-      }
-    }
-    return cnt;
-  }
+  auto count() -> uint64_t { return count_; }
 
   // approximate sum
-  auto sum() -> double {
-    double sum = 0;
-    uint32_t base = 0;
-    uint32_t n = 0;
-    for (uint32_t i = 0; i < N; i++) {
-      n = (1 << i);
-      for (uint32_t j = 0; j < scale; j++) {
-        sum += s[i][j] * (double)(n * j + base);
-      }
-      base += n * scale;
-    }
-    sum += (double)s_inf_ * base;
-    return sum;
-  }
+  auto sum() -> double { return static_cast<double>(sum_); }
 
   // approximate avg
   auto avg() -> double { return sum() / std::max(1UL, count()); }
 
   // approximate max
   auto max() -> uint64_t {
-    uint64_t base = ((1 << N) - 1) * scale;
     if (s_inf_ > 0) {
-      return base;
+      return upperBound();
     }
-    uint32_t n = 0;
-    for (int32_t i = N - 1; i >= 0; i--) {
-      n = (1 << i);
-      base -= n * scale;
-      for (int32_t j = scale - 1; j >= 0; j--) {
-        if (s[i][j] > 0) {
-          return base + n * j;
-        }
-      }
+    if (count_ == 0) {
+      return 0;
     }
-    return 0;
+    // the last bucket reaching the total
+    const uint64_t* c = cumulative();
+    return valueOf(std::lower_bound(c, c + n_bucket, c[n_bucket - 1]) - c);
   }
 
   // approximate min
   auto min() -> uint64_t {
-    uint64_t base = 0;
-    uint32_t n = 0;
-    for (uint32_t i = 0; i < N; i++) {
-      n = (1 << i);
-      for (uint32_t j = 0; j < scale; j++) {
-        if (s[i][j] > 0) {
-          return base + n * j;
-        }
-      }
-      base += n * scale;
-    }
-    return base;
+    const uint64_t* c = cumulative();
+    return valueOf(std::upper_bound(c, c + n_bucket, 0) - c);
   }
 
   // approximate p-th percentile sample
   auto percentile(double p) -> uint64_t {
-    int64_t threshold = (int64_t)(p * (double)count());
-    uint64_t base = 0;
-    uint32_t n = 0;
-    for (uint32_t i = 0; i < N; i++) {
-      n = (1 << i);
-      for (uint32_t j = 0; j < scale; j++) {
-        threshold -= s[i][j];
-        if (threshold < 0) return base + j * n;
-      }
-      base += n * scale;
+    auto threshold = (int64_t)(p * (double)count());
+    if (threshold < 0) {
+      return 0;
     }
-    return base;
+    const uint64_t* c = cumulative();
+    return valueOf(std::upper_bound(c, c + n_bucket, threshold) - c);
+  }
+
+  /// percentile() of each of `ps`, searching the cumulative counts from where the
+  /// previous one stopped, so that ascending `ps` take a single pass.
+  template <size_t K>
+  auto percentiles(const std::array<double, K>& ps) -> std::array<uint64_t, K> {
+    std::array<uint64_t, K> r{};
+    const uint64_t* c = cumulative();
+    const uint64_t* from = c;
+    int64_t last = 0;
+    for (size_t k = 0; k < K; k++) {
+      auto threshold = (int64_t)(ps[k] * (double)count());
+      if (threshold < 0) continue;
+      if (threshold < last) from = c;
+      from = std::upper_bound(from, c + n_bucket, threshold);
+      last = threshold;
+      r[k] = valueOf(from - c);
+    }
+    return r;
   }
 
  public:
   auto dump() -> std::string {
+    auto p = percentiles(std::array<double, 5>{0.5, 0.9, 0.95, 0.99, 0.999});
     return fmt::format(
         "count: {}\n"
         "sum:   {}\n"
@@ -137,24 +146,73 @@ class Statistics {
         "p95:   {}\n"
         "p99:   {}\n"
         "p999:  {}\n",
-        count(), sum(), avg(), min(), max(), percentile(0.5), percentile(0.9),
-        percentile(0.95), percentile(0.99), percentile(0.999));
+        count(), sum(), avg(), min(), max(), p[0], p[1], p[2], p[3], p[4]);
   }
 
  public:
   auto operator+=(const Statistics<N, scale>& r) -> Statistics<N, scale>& {
+    util::addArray(&s[0][0], &r.s[0][0], n_bucket);
+    s_inf_ += r.s_inf_;
+    count_ += r.count_;
+    sum_ += r.sum_;
+    dirty_ = true;
+    return *this;
+  }
+
+  /// Only for `r` recorded before this, e.g. an earlier snapshot of the same source.
+  auto operator-=(const Statistics<N, scale>& r) -> Statistics<N, scale>& {
+    util::subArray(&s[0][0], &r.s[0][0], n_bucket);
+    s_inf_ -= r.s_inf_;
+    count_ -= r.count_;
+    sum_ -= r.sum_;
+    dirty_ = true;
+    return *this;
+  }
+
+ private:
+  friend class ConcurrentStatistics<N, scale>;
+
+  static constexpr auto lowerBound(uint32_t i, uint32_t j) -> uint64_t {
+    return scale * ((uint64_t{1} << i) - 1) + (uint64_t{j} << i);
+  }
+
+  static constexpr auto upperBound() -> uint64_t {
+    return scale * ((uint64_t{1} << N) - 1);
+  }
+
+  /// value of the k-th bucket in the flattened order, n_bucket for beyond the last one
+  static auto valueOf(ptrdiff_t k) -> uint64_t {
+    if (k >= static_cast<ptrdiff_t>(n_bucket)) return upperBound();
+    return lowerBound(static_cast<uint32_t>(k / scale), static_cast<uint32_t>(k % scale));
+  }
+
+  /// Recount count_ and sum_ after the buckets are written directly.
+  auto recount() -> void {
+    count_ = s_inf_ + util::sumArray(&s[0][0], n_bucket);
+    sum_ = s_inf_ * upperBound();
     for (uint32_t i = 0; i < N; i++) {
       for (uint32_t j = 0; j < scale; j++) {
-        s[i][j] += r.s[i][j];
+        sum_ += s[i][j] * lowerBound(i, j);
       }
     }
-    s_inf_ += r.s_inf_;
-    return *this;
+    dirty_ = true;
+  }
+
+  auto cumulative() -> const uint64_t* {
+    if (dirty_) {
+      util::prefixSum(&s[0][0], cumulative_, n_bucket);
+      dirty_ = false;
+    }
+    return cumulative_;
   }
 
  private:
   uint64_t s[N][scale];
   uint64_t s_inf_;
+  uint64_t count_;
+  uint64_t sum_;
+  uint64_t cumulative_[n_bucket];
+  bool dirty_;
 };
 
 template <uint32_t upperbound>
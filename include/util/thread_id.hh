@@ -0,0 +1,63 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <stdexcept>
+
+namespace toolbox {
+namespace util {
+
+/// A small dense index of the calling thread, which can be used to pick per-thread
+/// state out of a fixed array. The index is taken at the first call of get() and given
+/// back when the thread exits, so that it can be reused by later threads.
+class ThreadId {
+ public:
+  constexpr static uint32_t max_thread = 256;
+
+ public:
+  static auto get() -> uint32_t {
+    thread_local Holder holder;
+    return holder.id_;
+  }
+
+  /// Every index ever handed out is below highWater(), so per-thread arrays only need to
+  /// be scanned up to it.
+  static auto highWater() -> uint32_t {
+    return high_water_.load(std::memory_order_acquire);
+  }
+
+ private:
+  class Holder {
+   public:
+    Holder() : id_(acquire()) {}
+    ~Holder() { used_[id_].store(false, std::memory_order_release); }
+
+   public:
+    uint32_t id_;
+  };
+
+  static auto acquire() -> uint32_t {
+    for (uint32_t i = 0; i < max_thread; i++) {
+      bool expected = false;
+      if (not used_[i].load(std::memory_order_relaxed) and
+          used_[i].compare_exchange_strong(expected, true, std::memory_order_acquire,
+                                           std::memory_order_relaxed)) {
+        uint32_t hw = high_water_.load(std::memory_order_relaxed);
+        while (hw < i + 1 and not high_water_.compare_exchange_weak(
+                                  hw, i + 1, std::memory_order_release,
+                                  std::memory_order_relaxed)) {
+        }
+        return i;
+      }
+    }
+    throw std::runtime_error("too many threads");
+  }
+
+ private:
+  inline static std::array<std::atomic_bool, max_thread> used_{};
+  inline static std::atomic_uint32_t high_water_{0};
+};
+
+}  // namespace util
+}  // namespace toolbox
@@ -1,8 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <utility>
 #include <vector>
 
+#if defined(__x86_64__) || defined(__i386__)
+#include <cpuid.h>
+#endif
+
+#include "util/marker.hh"
+
 namespace toolbox {
 namespace util {
 
@@ -35,21 +47,233 @@ class Timer {
   time_point end_{};
 };
 
+/// The cycle counter: the TSC on x86, the virtual counter of the generic timer on
+/// aarch64, and the ticks of the steady clock elsewhere.
 inline auto tsc() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
   uint64_t a, d;
   asm volatile("rdtsc" : "=a"(a), "=d"(d));
   return (d << 32) | a;
+#elif defined(__aarch64__)
+  uint64_t c;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(c));
+  return c;
+#else
+  return static_cast<uint64_t>(clock::now().time_since_epoch().count());
+#endif
 }
 
+/// tsc(), waiting for the instructions before it to complete.
 inline auto tscp() -> uint64_t {
+#if defined(__x86_64__) || defined(__i386__)
   uint64_t a, d;
-  asm volatile("rdtscp" : "=a"(a), "=d"(d));
+  asm volatile("rdtscp" : "=a"(a), "=d"(d) : : "rcx");
   return (d << 32) | a;
+#elif defined(__aarch64__)
+  uint64_t c;
+  asm volatile("isb\n\tmrs %0, cntvct_el0" : "=r"(c) : : "memory");
+  return c;
+#else
+  return tsc();
+#endif
 }
 
+/// Nanoseconds from cycles of tsc(), on the epoch of the steady clock, so that
+/// TscClock::now() is comparable with clock::now() at the cost of a rdtsc.
+///
+/// The frequency is calibrated against the steady clock at the first use, which takes
+/// calibration_time, except on aarch64 where it is read from cntfrq_el0. ns are cycles
+/// times a 32.32 fixed-point ns per cycle. A now() coming recalibration_period after
+/// the last calibration takes a new sample and slews the rate, so that the clock
+/// converges to the steady clock over the next period without ever going back.
+///
+/// Notice:
+///     If the TSC is not invariant, i.e. it stops or changes its rate with the power
+///     state of the cpu, now() falls back to the steady clock, and toNanos() is only a
+///     rough estimation.
+class TscClock : public util::Noncopyable, public util::Nonmovable {
+  __extension__ typedef unsigned __int128 uint128;
+
+ public:
+  constexpr static uint32_t shift = 32;
+  constexpr static milliseconds calibration_time{10};
+  constexpr static milliseconds recalibration_period{1000};
+
+ public:
+  static auto instance() -> TscClock& {
+    static TscClock clock;
+    return clock;
+  }
+
+  /// Nanoseconds since the epoch of the steady clock.
+  static auto now() -> uint64_t {
+    TscClock& c = instance();
+    if (not c.invariant_) return steadyNanos();
+    uint64_t t = tsc();
+    uint64_t ns = c.convert(t);
+    uint64_t due = c.base_tsc_.load(std::memory_order_relaxed) +
+                   c.period_cycles_.load(std::memory_order_relaxed);
+    if (t > due) {
+      c.tryRecalibrate();
+    }
+    return ns;
+  }
+
+  /// Nanoseconds of a number of cycles, e.g. the difference of two tsc().
+  static auto toNanos(uint64_t cycles) -> uint64_t {
+    return mulShift(cycles, instance().mult_.load(std::memory_order_relaxed));
+  }
+
+  static auto invariant() -> bool { return instance().invariant_; }
+
+  static auto cyclesPerNano() -> double {
+    return static_cast<double>(uint64_t{1} << shift) /
+           static_cast<double>(instance().mult_.load(std::memory_order_relaxed));
+  }
+
+  /// Take a new sample now, which now() does by itself every recalibration_period.
+  static auto recalibrate() -> void {
+    TscClock& c = instance();
+    std::lock_guard<std::mutex> guard(c.mutex_);
+    c.recalibrateLocked();
+  }
+
+ private:
+  TscClock() : invariant_(detectInvariant()) {
+    auto [t0, ns0] = sample();
+#if defined(__aarch64__)
+    uint64_t frequency = 0;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    uint64_t mult = static_cast<uint64_t>(
+        (static_cast<uint128>(1000000000) << shift) / frequency);
+#else
+    std::this_thread::sleep_for(calibration_time);
+    auto [t1, ns1] = sample();
+    uint64_t mult = rateOf(ns1 - ns0, t1 - t0);
+#endif
+    anchor_tsc_ = t0;
+    anchor_ns_ = ns0;
+    long_mult_ = mult;
+    period_cycles_.store(cyclesOf(recalibration_period, mult), std::memory_order_relaxed);
+    publish(t0, ns0, mult);
+  }
+  ~TscClock() = default;
+
+ private:
+  static auto steadyNanos() -> uint64_t {
+    return static_cast<uint64_t>(
+        std::chrono::duration_cast<nanoseconds>(clock::now().time_since_epoch())
+            .count());
+  }
+
+  static auto detectInvariant() -> bool {
+#if defined(__x86_64__) || defined(__i386__)
+    uint32_t a = 0, b = 0, c = 0, d = 0;
+    // CPUID.80000007H:EDX[8], invariant TSC
+    return __get_cpuid(0x80000007, &a, &b, &c, &d) != 0 and (d & (1U << 8)) != 0;
+#elif defined(__aarch64__)
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /// A tsc() and the steady clock read at the same time, the closest of a few tries.
+  static auto sample() -> std::pair<uint64_t, uint64_t> {
+    std::pair<uint64_t, uint64_t> best{};
+    uint64_t best_gap = UINT64_MAX;
+    for (uint32_t i = 0; i < 5; i++) {
+      uint64_t before = tscp();
+      uint64_t ns = steadyNanos();
+      uint64_t after = tscp();
+      if (after - before < best_gap) {
+        best_gap = after - before;
+        best = {before + (after - before) / 2, ns};
+      }
+    }
+    return best;
+  }
+
+  static auto mulShift(uint64_t x, uint64_t mult) -> uint64_t {
+    return static_cast<uint64_t>((static_cast<uint128>(x) * mult) >> shift);
+  }
+
+  static auto rateOf(uint64_t ns, uint64_t cycles) -> uint64_t {
+    return static_cast<uint64_t>((static_cast<uint128>(ns) << shift) /
+                                 std::max<uint64_t>(cycles, 1));
+  }
+
+  static auto cyclesOf(milliseconds period, uint64_t mult) -> uint64_t {
+    auto ns = static_cast<uint64_t>(nanoseconds(period).count());
+    return static_cast<uint64_t>((static_cast<uint128>(ns) << shift) /
+                                 std::max<uint64_t>(mult, 1));
+  }
+
+  /// The parameters are published under a sequence lock, now() retries if it reads
+  /// them in the middle of a recalibration.
+  auto convert(uint64_t t) const -> uint64_t {
+    while (true) {
+      uint32_t seq = seq_.load(std::memory_order_acquire);
+      uint64_t base_tsc = base_tsc_.load(std::memory_order_relaxed);
+      uint64_t base_ns = base_ns_.load(std::memory_order_relaxed);
+      uint64_t mult = mult_.load(std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if ((seq & 1) == 0 and seq_.load(std::memory_order_relaxed) == seq) {
+        // a t taken before the last recalibration by another thread is clamped
+        return base_ns + (t > base_tsc ? mulShift(t - base_tsc, mult) : 0);
+      }
+    }
+  }
+
+  auto publish(uint64_t base_tsc, uint64_t base_ns, uint64_t mult) -> void {
+    uint32_t seq = seq_.load(std::memory_order_relaxed);
+    seq_.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    base_tsc_.store(base_tsc, std::memory_order_relaxed);
+    base_ns_.store(base_ns, std::memory_order_relaxed);
+    mult_.store(mult, std::memory_order_relaxed);
+    seq_.store(seq + 2, std::memory_order_release);
+  }
+
+  auto tryRecalibrate() -> void {
+    std::unique_lock<std::mutex> guard(mutex_, std::try_to_lock);
+    if (guard.owns_lock()) {
+      recalibrateLocked();
+    }
+  }
+
+  auto recalibrateLocked() -> void {
+    auto [t, ns] = sample();
+    uint64_t current = convert(t);
+    // the rate since the first sample, which averages out the jitter of the samples
+    long_mult_ = rateOf(ns - anchor_ns_, t - anchor_tsc_);
+    period_cycles_.store(cyclesOf(recalibration_period, long_mult_),
+                         std::memory_order_relaxed);
+    // cover the offset to the steady clock along with the next period
+    auto period_ns = static_cast<uint64_t>(nanoseconds(recalibration_period).count());
+    uint64_t target = ns + period_ns > current ? ns + period_ns - current : 0;
+    uint64_t mult = rateOf(target, period_cycles_);
+    mult = std::clamp(mult, long_mult_ / 2, long_mult_ * 2);
+    publish(t, current, mult);
+  }
+
+ private:
+  const bool invariant_;
+  uint64_t anchor_tsc_{0};
+  uint64_t anchor_ns_{0};
+  uint64_t long_mult_{0};
+  std::mutex mutex_{};
+
+  std::atomic_uint64_t period_cycles_{0};
+  std::atomic_uint32_t seq_{0};
+  std::atomic_uint64_t base_tsc_{0};
+  std::atomic_uint64_t base_ns_{0};
+  std::atomic_uint64_t mult_{0};
+};
+
 /// Notice:
-///    Before you use this timer, you shall check your cpu have constant_tsc flag
-///    by using command: `cat /proc/cpuinfo | grep constant_tsc`.
+///    elapsed() is in cycles, elapsed<T>() converts them by TscClock, which assumes an
+///    invariant TSC, see TscClock::invariant().
 class ClockTimer {
  public:
   ClockTimer() = default;
@@ -61,6 +285,12 @@ class ClockTimer {
   auto reset() -> void { begin_ = end_ = 0; }
   auto elapsed() -> uint64_t { return end_ - begin_; }
 
+  template <typename T>
+  auto elapsed() -> uint64_t {
+    return std::chrono::duration_cast<T>(nanoseconds(TscClock::toNanos(elapsed())))
+        .count();
+  }
+
  private:
   uint64_t begin_{};
   uint64_t end_{};
@@ -71,7 +301,7 @@ class TraceTimer {
   TraceTimer() = default;
   ~TraceTimer() = default;
 
- private:
+ public:
   auto tick() -> void { trace_.emplace_back(clock::now()); }
 
   auto reset() -> void { trace_.resize(0); }
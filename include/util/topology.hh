@@ -0,0 +1,257 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "util/marker.hh"
+
+namespace toolbox {
+namespace util {
+
+/// A logical cpu, the ids of its core, L3 and node are the ones of sysfs, the core being
+/// the lowest cpu among its SMT siblings so that it is unique over the packages.
+struct Cpu {
+  uint32_t id_;
+  uint32_t core_;
+  uint32_t package_;
+  uint32_t l3_;    // the lowest cpu sharing the L3, the package without L3
+  uint32_t node_;  // 0 without NUMA
+};
+
+/// Where the threads of a pair, e.g. a producer and a consumer, are placed relative to
+/// each other.
+enum class Placement : uint8_t {
+  SMTSiblings,  // the hardware threads of a single core
+  SameL3,       // distinct cores sharing an L3
+  CrossNUMA,    // cores of two NUMA nodes, alternating
+};
+
+inline auto toString(Placement p) -> const char* {
+  switch (p) {
+    case Placement::SMTSiblings:
+      return "SMTSiblings";
+    case Placement::SameL3:
+      return "SameL3";
+    case Placement::CrossNUMA:
+      return "CrossNUMA";
+  }
+  return "Unknown";
+}
+
+/// The cpus of the machine as sysfs describes them under /sys/devices/system/cpu, and
+/// the choice of cpus for a Placement.
+///
+/// Notice:
+///     instance() only keeps the cpus the process is allowed to run on, e.g. by its
+///     cpuset, a Topology built from a root keeps all the online ones.
+class Topology {
+ public:
+  explicit Topology(const std::string& root = "/sys/devices/system/cpu") {
+    for (uint32_t id : parseCpuList(read(root + "/online"))) {
+      std::string dir = fmt::format("{}/cpu{}", root, id);
+      Cpu cpu{id, id, 0, 0, 0};
+      std::string siblings = read(dir + "/topology/thread_siblings_list", "");
+      if (not siblings.empty()) cpu.core_ = parseCpuList(siblings).front();
+      cpu.package_ = readUint(dir + "/topology/physical_package_id", 0);
+      cpu.l3_ = cpu.package_;
+      for (uint32_t i = 0; exists(fmt::format("{}/cache/index{}", dir, i)); i++) {
+        std::string index = fmt::format("{}/cache/index{}", dir, i);
+        if (readUint(index + "/level", 0) == 3) {
+          cpu.l3_ = parseCpuList(read(index + "/shared_cpu_list")).front();
+        }
+      }
+      for (const auto& entry : std::filesystem::directory_iterator(dir)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("node", 0) == 0 and name.size() > 4) {
+          cpu.node_ = static_cast<uint32_t>(std::stoul(name.substr(4)));
+        }
+      }
+      cpus_.push_back(cpu);
+    }
+  }
+
+  /// The cpus this process may run on.
+  static auto instance() -> const Topology& {
+    static const Topology topology = [] {
+      Topology t;
+      std::vector<uint32_t> allowed = affinity();
+      std::set<uint32_t> s(allowed.begin(), allowed.end());
+      std::vector<Cpu> cpus;
+      for (const Cpu& cpu : t.cpus_) {
+        if (s.count(cpu.id_) != 0) cpus.push_back(cpu);
+      }
+      t.cpus_ = std::move(cpus);
+      return t;
+    }();
+    return topology;
+  }
+
+ public:
+  auto cpus() const -> const std::vector<Cpu>& { return cpus_; }
+
+  auto nodes() const -> uint32_t {
+    std::set<uint32_t> nodes;
+    for (const Cpu& cpu : cpus_) nodes.insert(cpu.node_);
+    return static_cast<uint32_t>(nodes.size());
+  }
+
+  /// `n` cpus placed as `p`, the i-th one for the i-th thread, or none if the machine
+  /// has no such cpus. For CrossNUMA, the even threads run on a node and the odd ones on
+  /// another.
+  auto pick(Placement p, uint32_t n) const -> std::vector<uint32_t> {
+    switch (p) {
+      case Placement::SMTSiblings: {
+        for (auto& [core, cpus] : groupBy(&Cpu::core_, false)) {
+          if (cpus.size() >= n) return {cpus.begin(), cpus.begin() + n};
+        }
+        return {};
+      }
+      case Placement::SameL3: {
+        for (auto& [l3, cpus] : groupBy(&Cpu::l3_, true)) {
+          if (cpus.size() >= n) return {cpus.begin(), cpus.begin() + n};
+        }
+        return {};
+      }
+      case Placement::CrossNUMA: {
+        auto nodes = groupBy(&Cpu::node_, true);
+        if (nodes.size() < 2) return {};
+        const auto& even = nodes.begin()->second;
+        const auto& odd = std::next(nodes.begin())->second;
+        if (even.size() < (n + 1) / 2 or odd.size() < n / 2) return {};
+        std::vector<uint32_t> r;
+        for (uint32_t i = 0; i < n; i++) {
+          r.push_back(i % 2 == 0 ? even[i / 2] : odd[i / 2]);
+        }
+        return r;
+      }
+    }
+    return {};
+  }
+
+ public:
+  /// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+  static auto parseCpuList(const std::string& list) -> std::vector<uint32_t> {
+    std::vector<uint32_t> r;
+    size_t pos = 0;
+    while (pos < list.size()) {
+      size_t end = list.find(',', pos);
+      if (end == std::string::npos) end = list.size();
+      std::string range = list.substr(pos, end - pos);
+      size_t dash = range.find('-');
+      auto lo = static_cast<uint32_t>(std::stoul(range.substr(0, dash)));
+      uint32_t hi = lo;
+      if (dash != std::string::npos) {
+        hi = static_cast<uint32_t>(std::stoul(range.substr(dash + 1)));
+      }
+      for (uint32_t i = lo; i <= hi; i++) r.push_back(i);
+      pos = end + 1;
+    }
+    return r;
+  }
+
+  /// The cpus the calling thread may run on.
+  static auto affinity() -> std::vector<uint32_t> {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    int rc = pthread_getaffinity_np(pthread_self(), sizeof(set), &set);
+    if (rc != 0) {
+      throw std::runtime_error(
+          fmt::format("fail to get thread affinity, error: {}", strerror(rc)));
+    }
+    std::vector<uint32_t> r;
+    for (uint32_t i = 0; i < CPU_SETSIZE; i++) {
+      if (CPU_ISSET(i, &set)) r.push_back(i);
+    }
+    return r;
+  }
+
+  /// Restrict a thread to `cpus`.
+  static auto setAffinity(pthread_t thread, const std::vector<uint32_t>& cpus) -> void {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (uint32_t cpu : cpus) CPU_SET(cpu, &set);
+    int rc = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (rc != 0) {
+      throw std::runtime_error(
+          fmt::format("fail to set thread affinity, error: {}", strerror(rc)));
+    }
+  }
+
+  /// Pin the calling thread, or `thread`, to a single cpu.
+  static auto pin(uint32_t cpu) -> void { setAffinity(pthread_self(), {cpu}); }
+  static auto pin(std::thread& thread, uint32_t cpu) -> void {
+    setAffinity(thread.native_handle(), {cpu});
+  }
+
+ private:
+  /// The cpus grouped by `key`, keeping a single cpu per core if `distinct_core`.
+  auto groupBy(uint32_t Cpu::*key, bool distinct_core) const
+      -> std::map<uint32_t, std::vector<uint32_t>> {
+    std::map<uint32_t, std::vector<uint32_t>> groups;
+    std::set<uint32_t> cores;
+    for (const Cpu& cpu : cpus_) {
+      if (distinct_core and not cores.insert(cpu.core_).second) continue;
+      groups[cpu.*key].push_back(cpu.id_);
+    }
+    return groups;
+  }
+
+  static auto exists(const std::string& path) -> bool {
+    return std::filesystem::exists(path);
+  }
+
+  static auto read(const std::string& path) -> std::string {
+    std::ifstream in(path);
+    std::string s;
+    if (not(in >> s)) {
+      throw std::runtime_error(fmt::format("fail to read {}", path));
+    }
+    return s;
+  }
+
+  static auto read(const std::string& path, const std::string& fallback) -> std::string {
+    return exists(path) ? read(path) : fallback;
+  }
+
+  static auto readUint(const std::string& path, uint32_t fallback) -> uint32_t {
+    return exists(path) ? static_cast<uint32_t>(std::stoul(read(path))) : fallback;
+  }
+
+ private:
+  std::vector<Cpu> cpus_;
+};
+
+/// Pin the calling thread to a cpu for the lifetime of the guard, then give it back the
+/// cpus it had before.
+class ScopedAffinity : public util::Noncopyable, public util::Nonmovable {
+ public:
+  explicit ScopedAffinity(uint32_t cpu) : saved_(Topology::affinity()) {
+    Topology::pin(cpu);
+  }
+  ~ScopedAffinity() {
+    try {
+      Topology::setAffinity(pthread_self(), saved_);
+    } catch (const std::runtime_error&) {
+      // the saved cpus went offline, nothing better to do
+    }
+  }
+
+ private:
+  const std::vector<uint32_t> saved_;
+};
+
+}  // namespace util
+}  // namespace toolbox
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <fmt/core.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "queue/spsc.hh"
+#include "util/marker.hh"
+#include "util/timer.hh"
+
+namespace toolbox {
+namespace util {
+
+/// A span recorded by TRACE_SCOPE, in cycles of tsc().
+struct TraceRecord {
+  uint64_t begin_;
+  uint64_t end_;
+  uint32_t name_;  // see Tracer::intern()
+  uint32_t tid_;
+};
+
+/// Collects the spans of TRACE_SCOPE and exports them as a Chrome trace, which
+/// chrome://tracing and Perfetto open.
+///
+/// Each thread writes its spans into its own SPSC ring, allocated at its first span, so
+/// the hot path is a tsc() at both ends of the scope and a push, without allocation or
+/// lock. drain() moves the spans of all the rings into the tracer, either by hand or by
+/// the background drainer of start(). A span is dropped if the ring of its thread is
+/// full, which dropped() counts, so the drain period shall be short enough for the rate
+/// of spans.
+///
+/// Notice:
+///     The tracer lives until the program exits, stop() the drainer before then. The
+///     ring of an exited thread is released once drained.
+class Tracer : public util::Noncopyable, public util::Nonmovable {
+ public:
+  constexpr static uint32_t ring_size = 1 << 12;
+  constexpr static size_t max_record = 1 << 22;
+
+ private:
+  class Ring {
+   public:
+    explicit Ring(uint32_t tid) : tid_(tid) {}
+
+   public:
+    container::BoundedSPSCQueue<TraceRecord, ring_size> q_{};
+    const uint32_t tid_;
+    std::atomic_bool retired_{false};
+  };
+
+  class Holder {
+   public:
+    ~Holder() {
+      if (ring_ != nullptr) ring_->retired_.store(true, std::memory_order_release);
+    }
+
+   public:
+    Ring* ring_{nullptr};
+  };
+
+ public:
+  static auto instance() -> Tracer& {
+    // never destroyed, so that threads exiting after main() still see it
+    static auto* tracer = new Tracer();
+    return *tracer;
+  }
+
+  /// Spans are only recorded when enabled, which they are by default.
+  static auto enabled() -> bool {
+    return instance().enabled_.load(std::memory_order_relaxed);
+  }
+  static auto enable(bool on) -> void {
+    instance().enabled_.store(on, std::memory_order_relaxed);
+  }
+
+ public:
+  /// The id of a span name, TRACE_SCOPE interns its name once per call site.
+  auto intern(const std::string& name) -> uint32_t {
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto [it, inserted] = ids_.try_emplace(name, static_cast<uint32_t>(names_.size()));
+    if (inserted) names_.push_back(name);
+    return it->second;
+  }
+
+  auto record(uint64_t begin, uint64_t end, uint32_t name) -> void {
+    Ring& ring = local();
+    if (not ring.q_.push(TraceRecord{begin, end, name, ring.tid_})) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  /// Move the spans of all the rings into the tracer, returns the number of spans moved.
+  auto drain() -> size_t {
+    std::lock_guard<std::mutex> guard(mutex_);
+    size_t n = 0;
+    for (auto it = rings_.begin(); it != rings_.end();) {
+      // retired before draining, so nothing is pushed after the drain
+      bool retired = (*it)->retired_.load(std::memory_order_acquire);
+      TraceRecord r{};
+      while ((*it)->q_.pop(r)) {
+        if (records_.size() < max_record) {
+          records_.push_back(r);
+          n++;
+        } else {
+          dropped_.fetch_add(1, std::memory_order_relaxed);
+        }
+      }
+      it = retired ? rings_.erase(it) : std::next(it);
+    }
+    return n;
+  }
+
+  /// Drain every `period` on a background thread until stop().
+  template <typename Rep, typename Period>
+  auto start(const std::chrono::duration<Rep, Period>& period) -> void {
+    std::lock_guard<std::mutex> guard(drainer_mutex_);
+    if (drainer_.joinable()) return;
+    stop_ = false;
+    drainer_ = std::thread([this, period] {
+      std::unique_lock<std::mutex> lock(drainer_mutex_);
+      while (not stop_) {
+        stopped_.wait_for(lock, period, [this] { return stop_; });
+        drain();
+      }
+    });
+  }
+
+  auto stop() -> void {
+    std::thread drainer;
+    {
+      std::lock_guard<std::mutex> guard(drainer_mutex_);
+      stop_ = true;
+      drainer = std::move(drainer_);
+    }
+    stopped_.notify_all();
+    if (drainer.joinable()) drainer.join();
+  }
+
+  /// Drop the spans drained so far.
+  auto clear() -> void {
+    std::lock_guard<std::mutex> guard(mutex_);
+    records_.clear();
+  }
+
+  auto size() -> size_t {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return records_.size();
+  }
+
+  auto dropped() const -> uint64_t { return dropped_.load(std::memory_order_relaxed); }
+
+ public:
+  /// Drain, and write the spans drained so far as complete events ("ph": "X") of the
+  /// Chrome trace event format, timestamps being microseconds since the tracer started.
+  auto writeChromeTrace(std::ostream& os) -> void {
+    drain();
+    std::lock_guard<std::mutex> guard(mutex_);
+    auto pid = static_cast<uint32_t>(::getpid());
+    os << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    for (size_t i = 0; i < records_.size(); i++) {
+      const TraceRecord& r = records_[i];
+      uint64_t begin = r.begin_ > origin_ ? r.begin_ - origin_ : 0;
+      uint64_t end = r.end_ > r.begin_ ? r.end_ - r.begin_ : 0;
+      os << (i == 0 ? "\n" : ",\n")
+         << fmt::format(
+                "{{\"name\":\"{}\",\"cat\":\"toolbox\",\"ph\":\"X\",\"ts\":{:.3f},"
+                "\"dur\":{:.3f},\"pid\":{},\"tid\":{}}}",
+                escape(names_[r.name_]),
+                static_cast<double>(TscClock::toNanos(begin)) / 1000.0,
+                static_cast<double>(TscClock::toNanos(end)) / 1000.0, pid, r.tid_);
+    }
+    os << "\n]}\n";
+  }
+
+ private:
+  Tracer() : origin_(tsc()) {}
+  ~Tracer() { stop(); }
+
+  auto local() -> Ring& {
+    thread_local Holder holder;
+    if (holder.ring_ == nullptr) {
+      auto ring = std::make_unique<Ring>(static_cast<uint32_t>(::syscall(SYS_gettid)));
+      holder.ring_ = ring.get();
+      std::lock_guard<std::mutex> guard(mutex_);
+      rings_.push_back(std::move(ring));
+    }
+    return *holder.ring_;
+  }
+
+  static auto escape(const std::string& s) -> std::string {
+    std::string r;
+    r.reserve(s.size());
+    for (char c : s) {
+      if (c == '"' or c == '\\') {
+        r += '\\';
+        r += c;
+      } else if (static_cast<unsigned char>(c) < 0x20) {
+        r += fmt::format("\\u{:04x}", static_cast<int>(c));
+      } else {
+        r += c;
+      }
+    }
+    return r;
+  }
+
+ private:
+  const uint64_t origin_;
+  std::atomic_bool enabled_{true};
+  std::atomic_uint64_t dropped_{0};
+
+  // guards the rings, the names and the drained spans
+  std::mutex mutex_;
+  std::vector<std::unique_ptr<Ring>> rings_;
+  std::unordered_map<std::string, uint32_t> ids_;
+  std::vector<std::string> names_;
+  std::vector<TraceRecord> records_;
+
+  std::mutex drainer_mutex_;
+  std::condition_variable stopped_;
+  bool stop_{false};
+  std::thread drainer_;
+};
+
+/// Records a span from its construction to its destruction, see TRACE_SCOPE.
+class TraceScope : public util::Noncopyable, public util::Nonmovable {
+ public:
+  explicit TraceScope(uint32_t name)
+      : name_(name), begin_(Tracer::enabled() ? tsc() : 0) {}
+  ~TraceScope() {
+    if (begin_ != 0) Tracer::instance().record(begin_, tsc(), name_);
+  }
+
+ private:
+  const uint32_t name_;
+  const uint64_t begin_;
+};
+
+}  // namespace util
+}  // namespace toolbox
+
+#define TOOLBOX_TRACE_CONCAT_IMPL(a, b) a##b
+#define TOOLBOX_TRACE_CONCAT(a, b) TOOLBOX_TRACE_CONCAT_IMPL(a, b)
+
+/// Trace the enclosing scope as a span named `name`, define TOOLBOX_DISABLE_TRACE to
+/// compile the spans out.
+#ifndef TOOLBOX_DISABLE_TRACE
+#define TRACE_SCOPE(name)                                                           \
+  static const uint32_t TOOLBOX_TRACE_CONCAT(toolbox_trace_name_, __LINE__) =       \
+      ::toolbox::util::Tracer::instance().intern(name);                             \
+  ::toolbox::util::TraceScope TOOLBOX_TRACE_CONCAT(toolbox_trace_scope_, __LINE__)( \
+      TOOLBOX_TRACE_CONCAT(toolbox_trace_name_, __LINE__))
+#else
+#define TRACE_SCOPE(name) \
+  do {                    \
+  } while (0)
+#endif
@@ -0,0 +1,171 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <ctime>
+#endif
+
+#include "util/marker.hh"
+#include "util/misc.hh"
+#include "util/timer.hh"
+
+namespace toolbox {
+namespace util {
+
+/// Wait strategies of the blocking queue operations.
+///
+/// A strategy object is shared by all the threads waiting for the same condition,
+/// e.g. consumers waiting for a non-empty queue. `waitUntil(ready, deadline)` retries
+/// `ready()` until it returns true or the deadline expires, and the other side calls
+/// `notify(n)` after each change which may let n waiters make progress.
+
+namespace detail {
+
+/// sample the clock once every `deadline_check_interval` retries
+constexpr uint32_t deadline_check_interval = 64;
+
+inline auto expired(uint32_t i, time_point deadline) -> bool {
+  return i % deadline_check_interval == 0 and deadline != time_point::max() and
+         clock::now() >= deadline;
+}
+
+#if defined(__linux__)
+
+/// Futexes are not private, so that waiters can be parked on a queue in shared memory.
+inline auto futexWait(std::atomic_uint32_t* addr, uint32_t expected, time_point deadline)
+    -> void {
+  static_assert(sizeof(std::atomic_uint32_t) == sizeof(uint32_t));
+  if (deadline == time_point::max()) {
+    syscall(SYS_futex, addr, FUTEX_WAIT, expected, nullptr, nullptr, 0);
+    return;
+  }
+  auto ns = std::chrono::duration_cast<nanoseconds>(deadline - clock::now()).count();
+  if (ns <= 0) return;
+  timespec ts{static_cast<time_t>(ns / 1'000'000'000),
+              static_cast<long>(ns % 1'000'000'000)};
+  syscall(SYS_futex, addr, FUTEX_WAIT, expected, &ts, nullptr, 0);
+}
+
+inline auto futexWake(std::atomic_uint32_t* addr, uint32_t n) -> void {
+  syscall(SYS_futex, addr, FUTEX_WAKE, n, nullptr, nullptr, 0);
+}
+
+#else
+
+inline auto futexWait(std::atomic_uint32_t* addr, uint32_t expected, time_point deadline)
+    -> void {
+  while (addr->load(std::memory_order_acquire) == expected and clock::now() < deadline) {
+    std::this_thread::yield();
+  }
+}
+
+inline auto futexWake(std::atomic_uint32_t*, uint32_t) -> void {}
+
+#endif
+
+}  // namespace detail
+
+/// Busy loop on misc::pause(), lowest latency and a whole core per waiter.
+class SpinWait {
+ public:
+  template <typename Ready>
+  auto waitUntil(Ready&& ready, time_point deadline) -> bool {
+    for (uint32_t i = 1; not ready(); i++) {
+      if (detail::expired(i, deadline)) return false;
+      misc::pause();
+    }
+    return true;
+  }
+
+  auto notify(uint32_t /*n*/) -> void {}
+};
+
+/// Spin for a while, then give the core away with sched_yield between retries.
+class YieldWait {
+ public:
+  constexpr static uint32_t spin_limit = 1 << 10;
+
+ public:
+  template <typename Ready>
+  auto waitUntil(Ready&& ready, time_point deadline) -> bool {
+    for (uint32_t i = 1; not ready(); i++) {
+      if (detail::expired(i, deadline)) return false;
+      if (i < spin_limit) {
+        misc::pause();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+    return true;
+  }
+
+  auto notify(uint32_t /*n*/) -> void {}
+};
+
+/// Spin, then yield, then park on a futex until notified.
+///
+/// Notice:
+///     notify() costs a full fence and a load on every successful operation of the
+///     other side, and a syscall only when somebody is parked.
+class ParkWait : util::Noncopyable {
+ public:
+  constexpr static uint32_t spin_limit = 1 << 10;
+  constexpr static uint32_t yield_limit = spin_limit + (1 << 4);
+
+ public:
+  ParkWait() = default;
+  ~ParkWait() = default;
+
+ public:
+  template <typename Ready>
+  auto waitUntil(Ready&& ready, time_point deadline) -> bool {
+    for (uint32_t i = 1; i < yield_limit; i++) {
+      if (ready()) return true;
+      if (detail::expired(i, deadline)) return false;
+      if (i < spin_limit) {
+        misc::pause();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+
+    n_waiter_.fetch_add(1, std::memory_order_seq_cst);
+    // pairs with the fence in notify(): either we observe the new state in ready(),
+    // or the notifier observes us in n_waiter_
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    auto ok = true;
+    while (true) {
+      uint32_t seq = seq_.load(std::memory_order_acquire);
+      if (ready()) break;
+      if (deadline != time_point::max() and clock::now() >= deadline) {
+        ok = false;
+        break;
+      }
+      detail::futexWait(&seq_, seq, deadline);
+    }
+    n_waiter_.fetch_sub(1, std::memory_order_relaxed);
+    return ok;
+  }
+
+  auto notify(uint32_t n) -> void {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (n_waiter_.load(std::memory_order_relaxed) == 0) return;
+    seq_.fetch_add(1, std::memory_order_release);
+    detail::futexWake(&seq_, n);
+  }
+
+ private:
+  std::atomic_uint32_t seq_{0};
+  std::atomic_uint32_t n_waiter_{0};
+};
+
+}  // namespace util
+}  // namespace toolbox
@@ -0,0 +1,91 @@
+#include "executor/thread_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using toolbox::executor::ThreadPool;
+
+TEST(ThreadPool, SubmitTest) {
+  ThreadPool pool(4);
+  EXPECT_EQ(pool.size(), 4);
+  EXPECT_EQ(pool.currentWorker(), -1);
+
+  auto sum = pool.submit([](int a, int b) { return a + b; }, 1, 2);
+  auto str = pool.submit([](const std::string& s) { return s + s; }, std::string("ab"));
+  std::atomic_int n{0};
+  auto done = pool.submit([&n] { n++; });
+  auto worker = pool.submit([&pool] { return pool.currentWorker(); });
+  EXPECT_EQ(sum.get(), 3);
+  EXPECT_EQ(str.get(), "abab");
+  done.get();
+  EXPECT_EQ(n.load(), 1);
+  int32_t w = worker.get();
+  EXPECT_GE(w, 0);
+  EXPECT_LT(w, 4);
+
+  auto failed = pool.submit([] { throw std::runtime_error("failed"); });
+  EXPECT_THROW(failed.get(), std::runtime_error);
+
+  EXPECT_THROW(ThreadPool(0), std::runtime_error);
+}
+
+/// Tasks spawned by the workers go to their own deques and are stolen by the others.
+TEST(ThreadPool, NestedTest) {
+  constexpr uint32_t depth = 14;
+  std::atomic_uint64_t n_leaf{0};
+  std::atomic_uint64_t n_outside{0};
+  {
+    // declared before the pool, so that it outlives the tasks
+    std::function<void(uint32_t)> spawn;
+    ThreadPool pool(4);
+    spawn = [&](uint32_t d) {
+      if (pool.currentWorker() < 0) n_outside++;
+      if (d == 0) {
+        n_leaf++;
+        return;
+      }
+      pool.execute([&spawn, d] { spawn(d - 1); });
+      pool.execute([&spawn, d] { spawn(d - 1); });
+    };
+    pool.execute([&spawn] { spawn(depth); });
+    while (n_leaf.load() < (1U << depth)) {
+      std::this_thread::yield();
+    }
+  }
+  EXPECT_EQ(n_leaf.load(), 1U << depth);
+  EXPECT_EQ(n_outside.load(), 0);
+}
+
+TEST(ThreadPool, DtorTest) {
+  constexpr uint32_t n_task = 1 << 16;
+  std::atomic_uint32_t n{0};
+  {
+    // a small injection queue makes submit wait for the workers
+    ThreadPool pool(2, 64);
+    for (uint32_t i = 0; i < n_task; i++) {
+      pool.execute([&n] { n++; });
+    }
+  }
+  EXPECT_EQ(n.load(), n_task);
+}
+
+TEST(ThreadPool, ParkTest) {
+  ThreadPool pool(3);
+  for (uint32_t round = 0; round < 3; round++) {
+    // let all the workers park
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::vector<std::future<uint32_t>> futures;
+    for (uint32_t i = 0; i < 100; i++) {
+      futures.push_back(pool.submit([i] { return i * i; }));
+    }
+    for (uint32_t i = 0; i < 100; i++) {
+      EXPECT_EQ(futures[i].get(), i * i);
+    }
+  }
+}
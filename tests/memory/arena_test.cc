@@ -0,0 +1,135 @@
+#include "memory/arena.hh"
+
+#include <fmt/core.h>
+#include <gtest/gtest.h>
+
+#include <array>
+#include <cstring>
+#include <memory_resource>
+#include <string>
+#include <vector>
+
+using toolbox::memory::Arena;
+using toolbox::memory::ArenaAllocator;
+
+/// Counts what an arena takes from its upstream resource.
+class CountingResource : public std::pmr::memory_resource {
+ public:
+  int64_t alive_{0};
+  int64_t n_alloc_{0};
+
+ private:
+  auto do_allocate(size_t n, size_t align) -> void* override {
+    alive_++;
+    n_alloc_++;
+    return std::pmr::new_delete_resource()->allocate(n, align);
+  }
+  auto do_deallocate(void* p, size_t n, size_t align) -> void override {
+    alive_--;
+    std::pmr::new_delete_resource()->deallocate(p, n, align);
+  }
+  auto do_is_equal(const std::pmr::memory_resource& r) const noexcept -> bool override {
+    return this == &r;
+  }
+};
+
+TEST(Arena, AllocateTest) {
+  CountingResource upstream;
+  {
+    Arena arena(1024, &upstream);
+    EXPECT_EQ(arena.footprint(), 0);
+    for (size_t align : {1, 2, 8, 16, 64}) {
+      void* p = arena.allocate(3, align);
+      EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % align, 0);
+    }
+    EXPECT_EQ(upstream.n_alloc_, 1);
+    // contiguous within a chunk
+    auto* a = static_cast<char*>(arena.allocate(8, 8));
+    auto* b = static_cast<char*>(arena.allocate(8, 8));
+    EXPECT_EQ(b, a + 8);
+
+    for (int i = 0; i < 200; i++) {
+      arena.allocate(16);
+    }
+    EXPECT_GT(upstream.n_alloc_, 1);
+    // larger than a chunk
+    void* big = arena.allocate(10000, 64);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(big) % 64, 0);
+    memset(big, 0xff, 10000);
+    EXPECT_GE(arena.footprint(), 10000 + 1024);
+  }
+  EXPECT_EQ(upstream.alive_, 0);
+}
+
+TEST(Arena, RewindTest) {
+  CountingResource upstream;
+  Arena arena(1024, &upstream);
+  arena.allocate(100);
+  auto m = arena.mark();
+  void* first = arena.allocate(100);
+  for (int i = 0; i < 100; i++) {
+    arena.allocate(100);
+  }
+  size_t footprint = arena.footprint();
+  int64_t n_alloc = upstream.n_alloc_;
+
+  // the same memory again, from the kept chunks
+  arena.rewind(m);
+  EXPECT_EQ(arena.allocate(100), first);
+  for (int i = 0; i < 100; i++) {
+    arena.allocate(100);
+  }
+  EXPECT_EQ(arena.footprint(), footprint);
+  EXPECT_EQ(upstream.n_alloc_, n_alloc);
+
+  arena.reset();
+  for (int i = 0; i < 102; i++) {
+    arena.allocate(100);
+  }
+  EXPECT_EQ(upstream.n_alloc_, n_alloc);
+  // a larger allocation than the kept chunk is inserted before it
+  arena.reset();
+  arena.allocate(5000);
+  EXPECT_EQ(upstream.n_alloc_, n_alloc + 1);
+
+  arena.release();
+  EXPECT_EQ(arena.footprint(), 0);
+  EXPECT_EQ(upstream.alive_, 0);
+}
+
+TEST(Arena, BufferTest) {
+  CountingResource upstream;
+  alignas(64) std::array<std::byte, 512> buffer;
+  Arena arena(buffer.data(), buffer.size(), 1024, &upstream);
+  auto in = [&](void* p) { return p >= buffer.data() and p < buffer.data() + 512; };
+  void* p = arena.allocate(100);
+  EXPECT_TRUE(in(p));
+  EXPECT_EQ(upstream.n_alloc_, 0);
+  EXPECT_FALSE(in(arena.allocate(500)));
+  EXPECT_EQ(upstream.n_alloc_, 1);
+  arena.release();
+  EXPECT_EQ(upstream.alive_, 0);
+  EXPECT_EQ(arena.allocate(100), p);
+}
+
+TEST(Arena, ContainerTest) {
+  CountingResource upstream;
+  Arena arena(4096, &upstream);
+  {
+    std::pmr::vector<std::pmr::string> strings(&arena);
+    for (int i = 0; i < 100; i++) {
+      strings.emplace_back(fmt::format("a string longer than the small buffer {}", i));
+    }
+    EXPECT_EQ(strings[42], "a string longer than the small buffer 42");
+
+    std::vector<uint64_t, ArenaAllocator<uint64_t>> v{ArenaAllocator<uint64_t>(arena)};
+    for (uint64_t i = 0; i < 1000; i++) {
+      v.push_back(i);
+    }
+    EXPECT_EQ(v[999], 999);
+    EXPECT_TRUE(arena.is_equal(*strings.get_allocator().resource()));
+    EXPECT_TRUE(v.get_allocator() == ArenaAllocator<int>(arena));
+  }
+  arena.release();
+  EXPECT_EQ(upstream.alive_, 0);
+}
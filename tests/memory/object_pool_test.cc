@@ -0,0 +1,111 @@
+#include "memory/object_pool.hh"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <thread>
+#include <vector>
+
+#include "queue/spsc.hh"
+
+using toolbox::memory::ObjectPool;
+using toolbox::memory::PoolPtr;
+
+class Msg {
+ public:
+  explicit Msg(uint64_t seq) : seq_(seq) { alive++; }
+  ~Msg() { alive--; }
+
+ public:
+  inline static std::atomic_int64_t alive{0};
+  uint64_t seq_;
+  char payload_[48]{};
+};
+
+TEST(ObjectPool, SlotTest) {
+  static_assert(ObjectPool<Msg>::slot_size == toolbox::util::cache_line_size);
+  ObjectPool<Msg> pool(100);
+  std::vector<Msg*> msgs;
+  std::set<uintptr_t> lines;
+  for (uint64_t i = 0; i < 100; i++) {
+    Msg* m = pool.create(i);
+    ASSERT_NE(m, nullptr);
+    EXPECT_TRUE(pool.owns(m));
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(m) % toolbox::util::cache_line_size, 0);
+    lines.insert(reinterpret_cast<uintptr_t>(m) / toolbox::util::cache_line_size);
+    msgs.push_back(m);
+  }
+  // every object on its own cache line
+  EXPECT_EQ(lines.size(), 100);
+  EXPECT_EQ(pool.create(100), nullptr);
+  EXPECT_EQ(Msg::alive, 100);
+
+  pool.destroy(msgs.back());
+  msgs.pop_back();
+  Msg* m = pool.create(101);
+  ASSERT_NE(m, nullptr);
+  EXPECT_EQ(m->seq_, 101);
+  msgs.push_back(m);
+  for (Msg* msg : msgs) {
+    pool.destroy(msg);
+  }
+  EXPECT_EQ(Msg::alive, 0);
+  EXPECT_FALSE(pool.owns(&lines));
+}
+
+TEST(ObjectPool, PoolPtrTest) {
+  ObjectPool<Msg> pool(4);
+  {
+    PoolPtr<Msg> a = pool.make(1);
+    ASSERT_TRUE(a);
+    EXPECT_EQ(a->seq_, 1);
+    PoolPtr<Msg> b = std::move(a);
+    EXPECT_FALSE(a);
+    EXPECT_EQ((*b).seq_, 1);
+    b = pool.make(2);
+    EXPECT_EQ(Msg::alive, 1);
+
+    Msg* raw = b.release();
+    EXPECT_FALSE(b);
+    PoolPtr<Msg> c(pool, raw);
+    EXPECT_EQ(c->seq_, 2);
+    c.reset();
+    EXPECT_EQ(Msg::alive, 0);
+
+    std::vector<PoolPtr<Msg>> all;
+    for (uint64_t i = 0; i < 4; i++) {
+      all.push_back(pool.make(i));
+    }
+    EXPECT_FALSE(pool.make(4));
+  }
+  EXPECT_EQ(Msg::alive, 0);
+}
+
+/// Allocated by a producer, freed by a consumer, as the messages passed through a queue.
+TEST(ObjectPool, CrossThreadTest) {
+  constexpr uint64_t n_ops = 1 << 20;
+  ObjectPool<Msg> pool(2048);
+  toolbox::container::BoundedSPSCQueue<Msg*, 1024> q;
+  std::thread consumer([&] {
+    for (uint64_t i = 0; i < n_ops; i++) {
+      Msg* raw = nullptr;
+      while (not q.pop(raw)) {
+        std::this_thread::yield();
+      }
+      PoolPtr<Msg> m(pool, raw);
+      ASSERT_EQ(m->seq_, i);
+    }
+  });
+  for (uint64_t i = 0; i < n_ops; i++) {
+    PoolPtr<Msg> m;
+    while (not(m = pool.make(i))) {
+      std::this_thread::yield();
+    }
+    while (not q.push(m.get())) {
+      std::this_thread::yield();
+    }
+    m.release();
+  }
+  consumer.join();
+  EXPECT_EQ(Msg::alive, 0);
+}
@@ -0,0 +1,81 @@
+#include "memory/page_alloc.hh"
+
+#include <gtest/gtest.h>
+
+#include <cstring>
+#include <thread>
+
+#include "queue/mpmc.hh"
+#include "queue/spsc.hh"
+
+using namespace toolbox::memory;
+
+template <typename Alloc>
+auto RunAllocTest(size_t bytes) -> void {
+  void* p = Alloc::allocate(bytes);
+  ASSERT_NE(p, nullptr);
+  std::memset(p, 0xab, bytes);
+  EXPECT_EQ(static_cast<unsigned char*>(p)[bytes - 1], 0xab);
+  Alloc::deallocate(p, bytes);
+}
+
+TEST(PageAlloc, AllocTest) {
+  RunAllocTest<HeapAlloc>(100);
+  RunAllocTest<MmapAlloc<Pages::Normal>>(100);
+  RunAllocTest<MmapAlloc<Pages::Normal, any_node, false>>(3 << 20);
+  RunAllocTest<MmapAlloc<Pages::Transparent>>(3 << 20);
+  RunAllocTest<HugePageAlloc>(100);
+  RunAllocTest<HugePageAlloc>(5 << 20);
+  // every machine has node 0
+  RunAllocTest<NumaAlloc<0>>(3 << 20);
+
+  EXPECT_EQ(MmapAlloc<Pages::Normal>::mappingSize(1), 4 << 10);
+  EXPECT_EQ(MmapAlloc<Pages::Normal>::mappingSize(4 << 10), 4 << 10);
+  EXPECT_EQ(HugePageAlloc::mappingSize(1), 2 << 20);
+  EXPECT_EQ(HugePageAlloc::mappingSize((2 << 20) + 1), 4 << 20);
+}
+
+TEST(PageAlloc, AlignTest) {
+  // huge pages back only the whole 2M pages of a mapping
+  for (int i = 0; i < 8; i++) {
+    void* p = MmapAlloc<Pages::Transparent>::allocate(1 << 20);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % (2 << 20), 0);
+    MmapAlloc<Pages::Transparent>::deallocate(p, 1 << 20);
+  }
+  void* p = HugePageAlloc::allocate(1 << 20);
+  EXPECT_EQ(reinterpret_cast<uintptr_t>(p) % (2 << 20), 0);
+  HugePageAlloc::deallocate(p, 1 << 20);
+}
+
+TEST(PageAlloc, QueueTest) {
+  constexpr uint64_t n = 1 << 20;
+  toolbox::container::Queue<uint64_t, 1 << 16, toolbox::container::QueueMode::MPMC,
+                            toolbox::util::SpinWait, toolbox::container::NoMetrics,
+                            HugePageAlloc>
+      q;
+  toolbox::container::BoundedSPSCQueue<uint64_t, 1 << 16, toolbox::util::SpinWait,
+                                       NumaAlloc<0>>
+      sq;
+  EXPECT_EQ(sq.capacity(), 1 << 16);
+
+  std::thread producer([&] {
+    for (uint64_t i = 0; i < n; i++) {
+      while (not q.push(i)) std::this_thread::yield();
+    }
+  });
+  std::thread relay([&] {
+    for (uint64_t i = 0; i < n; i++) {
+      uint64_t v = 0;
+      while (not q.pop(v)) std::this_thread::yield();
+      while (not sq.push(v)) std::this_thread::yield();
+    }
+  });
+  for (uint64_t i = 0; i < n; i++) {
+    uint64_t v = 0;
+    while (not sq.pop(v)) std::this_thread::yield();
+    ASSERT_EQ(v, i);
+  }
+  producer.join();
+  relay.join();
+  EXPECT_TRUE(sq.isEmpty());
+}
@@ -69,4 +69,63 @@ TEST(BoundedSPSCQueue, MiscTest) {
 
   EXPECT_FALSE(queue.push(3));
   EXPECT_EQ(queue.approximateSize(), 2);
-}
\ No newline at end of file
+}
+
+TEST(BoundedSPSCQueue, BulkTest) {
+  AnotherBoundedSPSCQueue<uint64_t, 16> q;
+  CheckBulkSemantics(q);
+}
+
+TEST(BoundedSPSCQueue, ZeroCopyTest) {
+  BoundedSPSC<uint64_t, 16> q;
+  CheckZeroCopySemantics(q);
+  AnotherBoundedSPSCQueue<uint64_t, 16> aq;
+  CheckZeroCopySemantics(aq);
+  BoundedSPSC<std::string, 1024> sq;
+  RunSPSCZeroCopyCorrectnessTest(sq, 1 << 20);
+  AnotherBoundedSPSCQueue<std::string, 1024> asq;
+  RunSPSCZeroCopyCorrectnessTest(asq, 1 << 20);
+}
+
+TEST(BoundedSPSCQueue, FrontTest) {
+  BoundedSPSC<DtorCounter, 4> q;
+  EXPECT_EQ(q.front(), nullptr);
+  EXPECT_THROW(q.pop(), std::runtime_error);
+  EXPECT_TRUE(q.push(DtorCounter()));
+  EXPECT_TRUE(q.push(DtorCounter()));
+  EXPECT_EQ(DtorCounter::get(), 2);
+  EXPECT_NE(q.front(), nullptr);
+  q.pop();
+  EXPECT_EQ(DtorCounter::get(), 1);
+  q.pop();
+  EXPECT_EQ(DtorCounter::get(), 0);
+  EXPECT_EQ(q.front(), nullptr);
+}
+
+TEST(BoundedSPSCQueue, BlockingTest) {
+  using Park = toolbox::util::ParkWait;
+  toolbox::container::BoundedSPSCQueue<uint64_t, 16, Park> q;
+  CheckBlockingSemantics(q);
+  toolbox::container::Queue<uint64_t, 16, toolbox::container::SPSC, Park> aq;
+  CheckBlockingSemantics(aq);
+  toolbox::container::BoundedSPSCQueue<uint64_t, 64, Park> pq;
+  RunBlockingCorrectnessTest(pq, 1, 1, 1 << 18);
+  toolbox::container::Queue<uint64_t, 64, toolbox::container::SPSC, Park> apq;
+  RunBlockingCorrectnessTest(apq, 1, 1, 1 << 18);
+}
+
+TEST(BoundedSPSCQueue, DynamicSizeTest) {
+  using toolbox::container::dynamic_size;
+  EXPECT_THROW((BoundedSPSC<uint64_t, dynamic_size>(0)), std::runtime_error);
+  EXPECT_THROW((AnotherBoundedSPSCQueue<uint64_t, dynamic_size>(0)), std::runtime_error);
+  BoundedSPSC<uint64_t, dynamic_size> q(2);
+  EXPECT_EQ(q.capacity(), 2);
+  BoundedSPSC<uint64_t, dynamic_size> zq(16);
+  CheckZeroCopySemantics(zq);
+  AnotherBoundedSPSCQueue<uint64_t, dynamic_size> aq(16);
+  CheckBulkSemantics(aq);
+  BoundedSPSC<std::string, dynamic_size> sq(1024);
+  RunSPSCCorrectnessTest(sq, 1 << 20);
+  AnotherBoundedSPSCQueue<std::string, dynamic_size> asq(1024);
+  RunSPSCCorrectnessTest(asq, 1 << 20);
+}
@@ -0,0 +1,63 @@
+#include "queue/metrics.hh"
+
+#include "queue/mpmc.hh"
+
+#include "test_util.hh"
+
+using toolbox::container::NoMetrics;
+using toolbox::container::QueueMetrics;
+
+template <typename T, uint32_t Size, toolbox::container::QueueMode Mode>
+using InstrumentedQueue =
+    toolbox::container::Queue<T, Size, Mode, toolbox::util::SpinWait, QueueMetrics<>>;
+
+#define MetricsTest(Mode)                                                         \
+  TEST(Mode##Metrics, CountTest) {                                                \
+    InstrumentedQueue<uint64_t, 16, toolbox::container::QueueMode::Mode> q;       \
+    uint64_t e = 0;                                                               \
+    EXPECT_FALSE(q.pop(e));                                                       \
+    for (uint64_t i = 0; i < 16; i++) {                                           \
+      EXPECT_TRUE(q.push(i));                                                     \
+    }                                                                             \
+    EXPECT_FALSE(q.push(16));                                                     \
+    EXPECT_FALSE(q.pushBulk(std::array<uint64_t, 2>{}.begin(), 2));               \
+    auto s = q.metrics().snapshot();                                              \
+    EXPECT_EQ(s.empty_, 1);                                                       \
+    EXPECT_EQ(s.full_, 2);                                                        \
+    EXPECT_EQ(s.high_water_, 16);                                                 \
+    EXPECT_EQ(s.cas_retries_, 0);                                                 \
+    EXPECT_EQ(s.tail_spins_, 0);                                                  \
+    EXPECT_EQ(s.occupancy_.count(), 16);                                          \
+    EXPECT_EQ(s.occupancy_.min(), 1);                                             \
+    EXPECT_EQ(s.occupancy_.max(), 16);                                            \
+  }                                                                               \
+  TEST(Mode##Metrics, ConcurrentTest) {                                           \
+    constexpr uint32_t n_ops = 1 << 18;                                           \
+    InstrumentedQueue<uint64_t, 1024, toolbox::container::QueueMode::Mode> q;     \
+    RunMPMCCorrectnessTest(q, 4, n_ops);                                          \
+    auto s = q.metrics().snapshot();                                              \
+    spdlog::info("cas retries: {}, tail spins: {}, full: {}, empty: {}, "         \
+                 "high water: {}, p99 occupancy: {}",                             \
+                 s.cas_retries_, s.tail_spins_, s.full_, s.empty_, s.high_water_, \
+                 s.occupancy_.percentile(0.99));                                  \
+    /* every push is sampled once */                                              \
+    EXPECT_EQ(s.occupancy_.count(), n_ops);                                       \
+    EXPECT_LE(s.high_water_, 1024);                                               \
+    EXPECT_GT(s.high_water_, 0);                                                  \
+  }
+
+MetricsTest(MPMC);
+MetricsTest(MPMC_HTS);
+MetricsTest(MPMC_RTS);
+MetricsTest(MPMC_SEQ);
+
+TEST(NoMetrics, LayoutTest) {
+  using Default = toolbox::container::Queue<uint64_t, 16, toolbox::container::MPMC>;
+  using Explicit = toolbox::container::Queue<uint64_t, 16, toolbox::container::MPMC,
+                                             toolbox::util::SpinWait, NoMetrics>;
+  static_assert(std::is_same_v<Default, Explicit>);
+  static_assert(not Default::MetricsType::enabled);
+  // the handles take 4 lines with their pads, and the rest one, which NoMetrics does not
+  // spill over, so the instrumentation takes no line of its own when disabled
+  static_assert(sizeof(Default) == 5 * toolbox::util::cache_line_size);
+}
@@ -1,5 +1,7 @@
 #include "queue/mpmc.hh"
 
+#include "queue/unbounded_mpmc.hh"
+
 #include "test_util.hh"
 
 #define MPMCQueue(Mode) Mode##Queue
@@ -44,8 +46,236 @@
       EXPECT_EQ(DtorCounter::get(), 3);                                        \
     }                                                                          \
     EXPECT_EQ(DtorCounter::get(), 0);                                          \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), BulkTest) {                                            \
+    MPMCQueue(Mode)<uint64_t, 16> q;                                           \
+    CheckBulkSemantics(q);                                                     \
+    MPMCQueue(Mode)<uint64_t, 1024> iq;                                        \
+    for (uint32_t i = 1; i <= std::thread::hardware_concurrency(); i++) {      \
+      RunMPMCBulkCorrectnessTest(iq, i, 1 << 20, 32);                          \
+    }                                                                          \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), ZeroCopyTest) {                                        \
+    MPMCQueue(Mode)<uint64_t, 16> q;                                           \
+    CheckZeroCopySemantics(q);                                                 \
+    MPMCQueue(Mode)<uint64_t, 1024> iq;                                        \
+    for (uint32_t i = 1; i <= std::thread::hardware_concurrency(); i++) {      \
+      RunMPMCZeroCopyCorrectnessTest(iq, i, 1 << 20, 32);                      \
+    }                                                                          \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), BlockingTest) {                                        \
+    using toolbox::container::Queue;                                           \
+    using toolbox::util::ParkWait;                                             \
+    using toolbox::util::YieldWait;                                            \
+    Queue<uint64_t, 16, toolbox::container::Mode, ParkWait> q;                 \
+    CheckBlockingSemantics(q);                                                 \
+    Queue<uint64_t, 64, toolbox::container::Mode, YieldWait> yq;               \
+    RunBlockingCorrectnessTest(yq, 2, 2, 1 << 18);                             \
+    Queue<uint64_t, 64, toolbox::container::Mode, ParkWait> pq;                \
+    RunBlockingCorrectnessTest(pq, 2, 2, 1 << 18);                             \
+    RunBlockingCorrectnessTest(pq, 3, 1, 1 << 18);                             \
+    RunBlockingCorrectnessTest(pq, 1, 3, 1 << 18);                             \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), DynamicSizeTest) {                                     \
+    using toolbox::container::dynamic_size;                                    \
+    using DynamicQueue = MPMCQueue(Mode)<uint64_t, dynamic_size>;              \
+    EXPECT_THROW(DynamicQueue(0), std::runtime_error);                         \
+    DynamicQueue q(16);                                                        \
+    CheckBulkSemantics(q);                                                     \
+    DynamicQueue iq(1024);                                                     \
+    DynamicQueue wq(1024, 1);                                                  \
+    for (uint32_t i = 1; i <= std::thread::hardware_concurrency(); i++) {      \
+      RunMPMCCorrectnessTest(iq, i, 1 << 20);                                  \
+      RunMPMCCorrectnessTest(wq, i, 1 << 20);                                  \
+    }                                                                          \
   }
 
 MPMCTest(MPMC);
 MPMCTest(MPMC_HTS);
 MPMCTest(MPMC_RTS);
+MPMCTest(MPMC_SEQ);
+
+template <typename T, uint32_t Size, toolbox::container::QueueMode Mode>
+using PaddedQueue =
+    toolbox::container::Queue<T, Size, Mode, toolbox::util::SpinWait,
+                              toolbox::container::NoMetrics, toolbox::memory::HeapAlloc,
+                              toolbox::container::PaddedLayout>;
+
+#define PaddedTest(Mode)                                                      \
+  TEST(PaddedQueue, Mode##Test) {                                             \
+    using toolbox::container::Mode;                                           \
+    PaddedQueue<uint64_t, 16, Mode> q;                                        \
+    CheckBulkSemantics(q);                                                    \
+    CheckZeroCopySemantics(q);                                                \
+    /* the slots are a cache line apart and the spans walk them so */         \
+    auto span = q.reserve(2);                                                 \
+    ASSERT_EQ(span.size(), 2);                                                \
+    EXPECT_EQ(span.stride(), toolbox::util::cache_line_size);                 \
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(&span[1]) -                         \
+                  reinterpret_cast<uintptr_t>(&span[0]),                      \
+              toolbox::util::cache_line_size);                                \
+    /* each one within its own line, after the sequence number in MPMC_SEQ */ \
+    EXPECT_LE(reinterpret_cast<uintptr_t>(&span[0]) %                         \
+                      toolbox::util::cache_line_size +                        \
+                  sizeof(uint64_t),                                           \
+              toolbox::util::cache_line_size);                                \
+    span.emplace(0, 1);                                                       \
+    span.emplace(1, 2);                                                       \
+    q.commit(span);                                                           \
+    {                                                                         \
+      PaddedQueue<DtorCounter, 16, Mode> dq;                                  \
+      EXPECT_TRUE(dq.push(DtorCounter()));                                    \
+      EXPECT_TRUE(dq.push(DtorCounter()));                                    \
+      EXPECT_EQ(DtorCounter::get(), 2);                                       \
+    }                                                                         \
+    EXPECT_EQ(DtorCounter::get(), 0);                                         \
+    PaddedQueue<uint64_t, 1024, Mode> iq;                                     \
+    for (uint32_t i = 1; i <= std::thread::hardware_concurrency(); i++) {     \
+      RunMPMCCorrectnessTest(iq, i, 1 << 20);                                 \
+    }                                                                         \
+  }
+
+PaddedTest(MPMC);
+PaddedTest(MPMC_SEQ);
+
+TEST(MPMC_SEQQueue, StalledProducerTest) {
+  MPMC_SEQQueue<uint64_t, 16> q;
+  // a producer stalled between its claim and its publish
+  auto span = q.reserve(1);
+  ASSERT_EQ(span.size(), 1);
+  // a slot is its sequence number next to its element
+  EXPECT_EQ(span.stride(), 2 * sizeof(uint64_t));
+  // does not hold up the others, which would spin on the tail in the other modes
+  std::thread producer([&q] {
+    for (uint64_t i = 1; i < 16; i++) {
+      EXPECT_TRUE(q.push(i));
+    }
+    EXPECT_FALSE(q.push(16));
+  });
+  producer.join();
+  // but consumers pop in order
+  uint64_t got = 0;
+  EXPECT_FALSE(q.pop(got));
+  span.emplace(0, 0);
+  q.commit(span);
+  for (uint64_t i = 0; i < 16; i++) {
+    EXPECT_TRUE(q.pop(got));
+    EXPECT_EQ(got, i);
+  }
+  EXPECT_FALSE(q.pop(got));
+}
+
+template <typename Queue>
+auto CheckDescriptorLimits(Queue &q, bool single_producer, bool single_consumer) -> void {
+  auto p = q.producer();
+  auto c = q.consumer();
+  if (single_producer) {
+    EXPECT_THROW(q.producer(), std::runtime_error);
+  } else {
+    EXPECT_NO_THROW(q.producer());
+  }
+  if (single_consumer) {
+    EXPECT_THROW(q.consumer(), std::runtime_error);
+  } else {
+    EXPECT_NO_THROW(q.consumer());
+  }
+}
+
+/// Queues with one single threaded side, which can not be driven by MPMCCorrectnessTest
+#define AsymmetricTest(Mode, n_producer, n_consumer)                           \
+  TEST(MPMCQueue(Mode), CorrectnessTest) {                                     \
+    using toolbox::container::Queue;                                           \
+    using toolbox::util::ParkWait;                                             \
+    Queue<uint64_t, 1024, toolbox::container::Mode, ParkWait> q;               \
+    RunBlockingCorrectnessTest(q, n_producer, n_consumer, 1 << 20);            \
+    Queue<uint64_t, 16, toolbox::container::Mode, ParkWait> sq;                \
+    RunBlockingCorrectnessTest(sq, n_producer, n_consumer, 1 << 18);           \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), DescriptorTest) {                                      \
+    toolbox::container::Queue<uint64_t, 16, toolbox::container::Mode> q;       \
+    CheckDescriptorLimits(q, n_producer == 1, n_consumer == 1);                \
+  }                                                                            \
+  TEST(MPMCQueue(Mode), SemanticsTest) {                                       \
+    using toolbox::container::Queue;                                           \
+    Queue<uint64_t, 16, toolbox::container::Mode> bq;                          \
+    CheckBulkSemantics(bq);                                                    \
+    Queue<uint64_t, 16, toolbox::container::Mode> zq;                          \
+    CheckZeroCopySemantics(zq);                                                \
+    Queue<uint64_t, 16, toolbox::container::Mode, toolbox::util::ParkWait> pq; \
+    CheckBlockingSemantics(pq);                                                \
+  }
+
+AsymmetricTest(MPSC, 3, 1);
+AsymmetricTest(SPMC, 1, 3);
+
+// small segments, so that segments are linked, retired and reused all the time
+using UnboundedQueue = toolbox::container::UnboundedMPMCQueue<uint64_t, 32>;
+
+TEST(UnboundedMPMCQueue, MPMCCorrectnessTest) {
+  UnboundedQueue iq;
+  for (uint32_t i = 1; i <= std::max(4U, std::thread::hardware_concurrency()); i++) {
+    RunMPMCCorrectnessTest(iq, i, 1 << 20);
+  }
+}
+
+TEST(UnboundedMPMCQueue, DtorTest) {
+  {
+    toolbox::container::UnboundedMPMCQueue<DtorCounter, 4> q;
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_TRUE(q.push(DtorCounter()));
+    }
+    EXPECT_EQ(DtorCounter::get(), 10);
+    {
+      DtorCounter dummy;
+      for (int i = 0; i < 6; ++i) {
+        EXPECT_TRUE(q.pop(dummy));
+      }
+    }
+    EXPECT_EQ(DtorCounter::get(), 4);
+  }
+  EXPECT_EQ(DtorCounter::get(), 0);
+}
+
+TEST(UnboundedMPMCQueue, RecycleTest) {
+  UnboundedQueue q(4);
+  uint64_t got = 0;
+  EXPECT_FALSE(q.pop(got));
+  // a burst much larger than one segment
+  for (uint64_t i = 0; i < 1024; i++) {
+    EXPECT_TRUE(q.push(i));
+  }
+  for (uint64_t i = 0; i < 1024; i++) {
+    EXPECT_TRUE(q.pop(got));
+    EXPECT_EQ(got, i);
+  }
+  EXPECT_FALSE(q.pop(got));
+  auto n_allocated = q.allocatedSegments();
+  EXPECT_GE(n_allocated, 1024 / 32);
+
+  // steady state runs on pooled segments
+  for (uint64_t i = 0; i < (1 << 20); i++) {
+    EXPECT_TRUE(q.push(i));
+    EXPECT_TRUE(q.pop(got));
+  }
+  EXPECT_EQ(q.allocatedSegments(), n_allocated);
+}
+
+TEST(UnboundedMPMCQueue, NoPoolTest) {
+  UnboundedQueue q(0);
+  uint64_t got = 0;
+  for (uint64_t i = 0; i < 1024; i++) {
+    EXPECT_TRUE(q.push(i));
+  }
+  for (uint64_t i = 0; i < 1024; i++) {
+    EXPECT_TRUE(q.pop(got));
+    EXPECT_EQ(got, i);
+  }
+  EXPECT_FALSE(q.pop(got));
+  auto n_allocated = q.allocatedSegments();
+  // every segment is freed when retired, so the next ones are allocated again
+  for (uint64_t i = 0; i < 1024; i++) {
+    EXPECT_TRUE(q.push(i));
+    EXPECT_TRUE(q.pop(got));
+  }
+  EXPECT_GE(q.allocatedSegments(), n_allocated + 1024 / 32 - 1);
+}
@@ -0,0 +1,290 @@
+#include "queue/multicast.hh"
+
+#include <vector>
+
+#include "test_util.hh"
+
+template <typename T, uint32_t Size, bool MultiProducer = false,
+          typename Wait = toolbox::util::SpinWait>
+using MulticastQueue = toolbox::container::MulticastQueue<T, Size, MultiProducer, Wait>;
+
+TEST(MulticastQueue, BroadcastTest) {
+  constexpr uint32_t n_consumer = 3;
+  constexpr uint64_t n_ops = 1 << 18;
+  MulticastQueue<uint64_t, 1024, false, toolbox::util::YieldWait> q;
+  std::vector<std::unique_ptr<decltype(q)::ConsumerType>> consumers;
+  for (uint32_t i = 0; i < n_consumer; i++) {
+    consumers.emplace_back(new decltype(q)::ConsumerType(q, {}));
+  }
+  auto p = q.producer();
+
+  std::vector<std::thread> threads;
+  for (auto& c : consumers) {
+    threads.emplace_back([&c] {
+      uint64_t expect = 0;
+      while (expect < n_ops) {
+        c->pollWait([&expect](const uint64_t& e, uint32_t seq, bool /*end_of_batch*/) {
+          EXPECT_EQ(seq, static_cast<uint32_t>(expect));
+          EXPECT_EQ(e, expect++);
+        });
+      }
+    });
+  }
+  for (uint64_t i = 0; i < n_ops; i++) {
+    p.pushWait(i);
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  for (auto& c : consumers) {
+    EXPECT_EQ(c->sequence(), n_ops);
+  }
+}
+
+TEST(MulticastQueue, BarrierTest) {
+  constexpr uint64_t n_ops = 1 << 18;
+  MulticastQueue<uint64_t, 64, false, toolbox::util::YieldWait> q;
+  auto journal = q.consumer();
+  auto replication = q.consumer();
+  auto logic = q.consumer({&journal, &replication});
+  auto p = q.producer();
+
+  std::atomic_uint64_t n_journaled{0};
+  std::atomic_uint64_t n_replicated{0};
+  auto stage = [](decltype(journal)& c, std::atomic_uint64_t& n) {
+    while (n.load() < n_ops) {
+      c.pollWait([&n](const uint64_t& e, uint32_t, bool) {
+        EXPECT_EQ(e, n.load());
+        n.store(e + 1);
+      });
+    }
+  };
+  std::thread t1([&] { stage(journal, n_journaled); });
+  std::thread t2([&] { stage(replication, n_replicated); });
+  std::thread t3([&] {
+    uint64_t expect = 0;
+    while (expect < n_ops) {
+      logic.pollWait([&](const uint64_t& e, uint32_t, bool) {
+        EXPECT_EQ(e, expect++);
+        EXPECT_GT(n_journaled.load(), e);
+        EXPECT_GT(n_replicated.load(), e);
+      });
+    }
+  });
+  for (uint64_t i = 0; i < n_ops; i++) {
+    p.pushWait(i);
+  }
+  t1.join();
+  t2.join();
+  t3.join();
+}
+
+TEST(MulticastQueue, MultiProducerTest) {
+  constexpr uint32_t n_producer = 3;
+  constexpr uint64_t n_ops = 1 << 16;
+  MulticastQueue<uint64_t, 256, true, toolbox::util::YieldWait> q;
+  auto c1 = q.consumer();
+  auto c2 = q.consumer();
+
+  auto consume = [](decltype(c1)& c) {
+    std::array<uint64_t, n_producer> next{};
+    for (uint64_t i = 0; i < n_producer * n_ops; i++) {
+      uint64_t e = 0;
+      c.popWait(e);
+      // elements of one producer keep their order
+      EXPECT_EQ(e % n_ops, next[e / n_ops]++);
+    }
+  };
+  std::thread t1([&] { consume(c1); });
+  std::thread t2([&] { consume(c2); });
+  std::vector<std::thread> producers;
+  for (uint64_t id = 0; id < n_producer; id++) {
+    producers.emplace_back([&q, id] {
+      auto p = q.producer();
+      for (uint64_t i = 0; i < n_ops; i++) {
+        p.pushWait(id * n_ops + i);
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  t1.join();
+  t2.join();
+}
+
+TEST(MulticastQueue, StaleHeadTest) {
+  constexpr uint32_t n_producer = 3;
+  constexpr uint64_t n_ops = 1 << 14;
+  // more slots than producers, each of which has one element in flight at most, so that
+  // no push shall fail even when others published and got consumed since its last look
+  MulticastQueue<uint64_t, 4, true, toolbox::util::YieldWait> q;
+  auto c = q.consumer();
+  std::array<std::atomic_uint64_t, n_producer> consumed{};
+
+  std::thread consumer([&] {
+    for (uint64_t i = 0; i < n_producer * n_ops; i++) {
+      uint64_t e = 0;
+      c.popWait(e);
+      consumed[e / n_ops].fetch_add(1, std::memory_order_release);
+    }
+  });
+  std::atomic_uint64_t n_full{0};
+  std::vector<std::thread> producers;
+  for (uint64_t id = 0; id < n_producer; id++) {
+    producers.emplace_back([&, id] {
+      auto p = q.producer();
+      for (uint64_t i = 0; i < n_ops; i++) {
+        while (not p.push(id * n_ops + i)) {
+          n_full.fetch_add(1, std::memory_order_relaxed);
+        }
+        while (consumed[id].load(std::memory_order_acquire) != i + 1) {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  for (auto& t : producers) {
+    t.join();
+  }
+  consumer.join();
+  EXPECT_EQ(n_full.load(), 0);
+}
+
+TEST(MulticastQueue, BatchTest) {
+  MulticastQueue<uint64_t, 15> q;
+  auto c = q.consumer();
+  std::array<uint64_t, 10> src{0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  EXPECT_TRUE(q.pushBulk(src.begin(), 10));
+
+  std::vector<uint64_t> got;
+  uint32_t n_end = 0;
+  auto handler = [&](const uint64_t& e, uint32_t seq, bool end_of_batch) {
+    EXPECT_EQ(e, seq);
+    got.push_back(e);
+    n_end += end_of_batch;
+  };
+  EXPECT_EQ(c.poll(handler, 4), 4);
+  EXPECT_EQ(n_end, 1);
+  EXPECT_EQ(got.back(), 3);
+  EXPECT_EQ(c.sequence(), 4);
+  EXPECT_EQ(c.poll(handler), 6);
+  EXPECT_EQ(n_end, 2);
+  EXPECT_EQ(got.back(), 9);
+  EXPECT_EQ(c.poll(handler), 0);
+  EXPECT_EQ(n_end, 2);
+
+  // zero-copy on both sides, across the end of the ring
+  auto span = q.reserve(20);
+  EXPECT_EQ(span.size(), 15);
+  for (uint32_t i = 0; i < span.size(); i++) {
+    span[i] = 100 + i;
+  }
+  q.commit(span);
+  auto view = c.peek(32);
+  EXPECT_EQ(view.size(), 15);
+  EXPECT_EQ(view.firstSize(), 6);
+  for (uint32_t i = 0; i < view.size(); i++) {
+    EXPECT_EQ(view[i], 100 + i);
+  }
+  c.release(view);
+  EXPECT_EQ(c.sequence(), 25);
+}
+
+TEST(MulticastQueue, GatingTest) {
+  MulticastQueue<uint64_t, 16> q;
+  auto fast = q.consumer();
+  uint64_t e = 0;
+  {
+    auto slow = q.consumer();
+    for (uint64_t i = 0; i < 16; i++) {
+      EXPECT_TRUE(q.push(i));
+    }
+    EXPECT_FALSE(q.push(16));
+    while (fast.pop(e)) {
+    }
+    EXPECT_EQ(e, 15);
+    // the slowest consumer holds all the slots
+    EXPECT_FALSE(q.push(16));
+    EXPECT_TRUE(slow.pop(e));
+    EXPECT_EQ(e, 0);
+    EXPECT_TRUE(q.push(16));
+    EXPECT_FALSE(q.push(17));
+  }
+  // a consumer gone is not waited for any more
+  EXPECT_TRUE(fast.pop(e));
+  EXPECT_EQ(e, 16);
+  for (uint64_t i = 17; i < 33; i++) {
+    EXPECT_TRUE(q.push(i));
+  }
+  EXPECT_FALSE(q.push(33));
+}
+
+TEST(MulticastQueue, DependencyTest) {
+  MulticastQueue<uint64_t, 16> q;
+  auto first = q.consumer();
+  std::unique_ptr<decltype(q)::ConsumerType> second(
+      new decltype(q)::ConsumerType(q, {&first}));
+  auto third = q.consumer({second.get()});
+  uint64_t e = 0;
+  for (uint64_t i = 0; i < 3; i++) {
+    EXPECT_TRUE(q.push(i));
+  }
+  EXPECT_FALSE(second->pop(e));
+  EXPECT_TRUE(first.pop(e));
+  EXPECT_TRUE(first.pop(e));
+  EXPECT_TRUE(second->pop(e));
+  EXPECT_EQ(e, 0);
+  EXPECT_TRUE(second->pop(e));
+  EXPECT_EQ(e, 1);
+  EXPECT_FALSE(second->pop(e));
+  EXPECT_TRUE(third.pop(e));
+  EXPECT_TRUE(third.pop(e));
+  EXPECT_FALSE(third.pop(e));
+  second.reset();
+  // a consumer gone no longer holds back the consumers depending on it
+  EXPECT_TRUE(third.pop(e));
+  EXPECT_EQ(e, 2);
+  EXPECT_FALSE(third.pop(e));
+}
+
+TEST(MulticastQueue, DescriptorTest) {
+  {
+    MulticastQueue<uint64_t, 16> q;
+    auto c = q.consumer();
+    auto p = q.producer();
+    EXPECT_THROW(q.producer(), std::runtime_error);
+    EXPECT_TRUE(p.push(1));
+    EXPECT_THROW(q.consumer(), std::runtime_error);
+  }
+  {
+    MulticastQueue<uint64_t, 16, true> q;
+    auto p1 = q.producer();
+    auto p2 = q.producer();
+    std::vector<std::unique_ptr<decltype(q)::ConsumerType>> consumers;
+    for (uint32_t i = 0; i < decltype(q)::max_consumer; i++) {
+      consumers.emplace_back(new decltype(q)::ConsumerType(q, {}));
+    }
+    EXPECT_THROW(q.consumer(), std::runtime_error);
+    MulticastQueue<uint64_t, 16, true> other;
+    EXPECT_THROW(other.consumer({consumers[0].get()}), std::runtime_error);
+  }
+  EXPECT_THROW((MulticastQueue<uint64_t, toolbox::container::dynamic_size>(0)),
+               std::runtime_error);
+}
+
+TEST(MulticastQueue, DtorTest) {
+  {
+    MulticastQueue<DtorCounter, 15> q;
+    EXPECT_EQ(DtorCounter::get(), 16);
+    auto c = q.consumer();
+    for (int i = 0; i < 10; ++i) {
+      EXPECT_TRUE(q.push(DtorCounter()));
+    }
+    EXPECT_EQ(DtorCounter::get(), 16);
+    DtorCounter dummy;
+    EXPECT_TRUE(c.pop(dummy));
+    EXPECT_EQ(DtorCounter::get(), 17);
+  }
+  EXPECT_EQ(DtorCounter::get(), 0);
+}
@@ -0,0 +1,146 @@
+#include "queue/shm.hh"
+
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "test_util.hh"
+
+using toolbox::container::dynamic_size;
+using toolbox::container::QueueMode;
+using toolbox::container::SharedQueue;
+using toolbox::container::ShmOpen;
+
+namespace {
+
+auto uniqueName(const char* tag) -> std::string {
+  return fmt::format("/toolbox-{}-{}", tag, getpid());
+}
+
+/// Run fn in a child process, the child exits with 1 if fn throws.
+template <typename Fn>
+auto spawn(Fn&& fn) -> pid_t {
+  pid_t pid = fork();
+  if (pid == 0) {
+    int code = 0;
+    try {
+      fn();
+    } catch (...) {
+      code = 1;
+    }
+    _exit(code);
+  }
+  return pid;
+}
+
+auto join(pid_t pid) -> int {
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+
+}  // namespace
+
+TEST(SharedQueue, MappingTest) {
+  auto name = uniqueName("mapping");
+  SharedQueue<uint64_t, 1024, QueueMode::SPSC> creator(name, ShmOpen::Create);
+  // the same region is mapped twice at different addresses
+  SharedQueue<uint64_t, 1024, QueueMode::SPSC> attacher(name, ShmOpen::Attach);
+  EXPECT_EQ(attacher.capacity(), 1024);
+  EXPECT_NE(&creator.queue(), &attacher.queue());
+
+  auto p = creator.producer();
+  auto c = attacher.consumer();
+  for (uint64_t i = 0; i < 4096; i++) {
+    EXPECT_TRUE(p.push(i));
+    uint64_t got = 0;
+    EXPECT_TRUE(c.pop(got));
+    EXPECT_EQ(got, i);
+  }
+
+  // descriptor limits are shared by all mappings
+  EXPECT_THROW(attacher.producer(), std::runtime_error);
+  EXPECT_THROW(creator.consumer(), std::runtime_error);
+}
+
+TEST(SharedQueue, AttachTest) {
+  auto name = uniqueName("attach");
+  EXPECT_THROW((SharedQueue<uint64_t, 1024, QueueMode::MPMC>(name, ShmOpen::Attach)),
+               std::runtime_error);
+  SharedQueue<uint64_t, 1024, QueueMode::MPMC> q(name, ShmOpen::Create);
+  EXPECT_THROW((SharedQueue<uint64_t, 1024, QueueMode::MPMC>(name, ShmOpen::Create)),
+               std::runtime_error);
+  EXPECT_THROW((SharedQueue<uint32_t, 1024, QueueMode::MPMC>(name, ShmOpen::Attach)),
+               std::runtime_error);
+  EXPECT_THROW((SharedQueue<uint64_t, 512, QueueMode::MPMC>(name, ShmOpen::Attach)),
+               std::runtime_error);
+  EXPECT_THROW((SharedQueue<uint64_t, 1024, QueueMode::MPMC_HTS>(name, ShmOpen::Attach)),
+               std::runtime_error);
+}
+
+TEST(SharedQueue, SPSCProcessTest) {
+  constexpr uint64_t n_ops = 1 << 20;
+  auto name = uniqueName("spsc");
+  using Queue = SharedQueue<uint64_t, dynamic_size, QueueMode::SPSC>;
+  Queue q(name, ShmOpen::Create, 1024);
+
+  auto pid = spawn([&name] {
+    Queue child(name, ShmOpen::Attach);
+    auto p = child.producer();
+    for (uint64_t i = 0; i < n_ops; i++) {
+      while (not p.push(i)) {
+        toolbox::misc::pause();
+      }
+    }
+  });
+
+  auto c = q.consumer();
+  for (uint64_t i = 0; i < n_ops; i++) {
+    uint64_t got = 0;
+    while (not c.pop(got)) {
+      toolbox::misc::pause();
+    }
+    ASSERT_EQ(got, i);
+  }
+  EXPECT_EQ(join(pid), 0);
+}
+
+template <QueueMode Mode>
+auto RunMPMCProcessTest() -> void {
+  constexpr uint64_t n_ops = 1 << 20;
+  constexpr uint32_t n_producer = 3;
+  using Queue = SharedQueue<uint64_t, 1024, Mode, toolbox::util::ParkWait>;
+
+  int fd = memfd_create("toolbox-mpmc", 0);
+  ASSERT_GE(fd, 0);
+  Queue q(fd, ShmOpen::Create);
+
+  std::vector<pid_t> pids;
+  for (uint32_t x = 0; x < n_producer; x++) {
+    pids.emplace_back(spawn([fd, x] {
+      Queue child(fd, ShmOpen::Attach);
+      auto p = child.producer();
+      for (uint64_t i = x; i < n_ops; i += n_producer) {
+        p.pushWait(i);
+      }
+    }));
+  }
+
+  auto c = q.consumer();
+  uint64_t sum = 0;
+  for (uint64_t i = 0; i < n_ops; i++) {
+    uint64_t got = 0;
+    c.popWait(got);
+    sum += got;
+  }
+  for (auto pid : pids) {
+    EXPECT_EQ(join(pid), 0);
+  }
+  EXPECT_EQ(sum, n_ops * (n_ops - 1) / 2);
+  close(fd);
+}
+
+TEST(SharedQueue, MPMCProcessTest) { RunMPMCProcessTest<QueueMode::MPMC_HTS>(); }
+
+// the sequence numbers of the slots are shared as well
+TEST(SharedQueue, MPMCSeqProcessTest) { RunMPMCProcessTest<QueueMode::MPMC_SEQ>(); }
@@ -97,6 +97,63 @@ class SPSCCorrectnessTest {
   std::array<ValueType, TestDataSize> test_data_;
 };
 
+template <typename Queue, size_t TestDataSize>
+class SPSCZeroCopyCorrectnessTest {
+ public:
+  using ValueType = typename Queue::ValueType;
+  using ConsumerType = typename Queue::ConsumerType;
+  using ProducerType = typename Queue::ProducerType;
+
+  constexpr static uint32_t batch = 32;
+
+ public:
+  explicit SPSCZeroCopyCorrectnessTest(Queue &q) : consumer_(q), producer_(q) {
+    for (size_t i = 0; i < TestDataSize; i++) {
+      test_data_.at(i) = TestData<ValueType>::generate();
+    }
+    spdlog::info("Queue Type: {}, TestDataSize: {}, Batch: {}",
+                 toolbox::util::TypenameOf<Queue>(), TestDataSize, batch);
+    timer_.begin();
+
+    std::thread producer([this] { produce(); });
+    std::thread consumer([this] { consume(); });
+
+    producer.join();
+    consumer.join();
+
+    timer_.end();
+    spdlog::info("done: {} ms", timer_.elapsed<std::chrono::milliseconds>());
+  }
+  ~SPSCZeroCopyCorrectnessTest() = default;
+
+ public:
+  auto produce() -> void {
+    for (size_t i = 0; i < TestDataSize;) {
+      auto span = producer_.reserve(std::min<size_t>(batch, TestDataSize - i));
+      for (uint32_t j = 0; j < span.size(); j++) {
+        span.emplace(j, test_data_[i++]);
+      }
+      producer_.commit(span);
+    }
+  }
+
+  auto consume() -> void {
+    for (size_t i = 0; i < TestDataSize;) {
+      auto span = consumer_.peek(batch);
+      for (uint32_t j = 0; j < span.size(); j++) {
+        EXPECT_EQ(span[j], test_data_[i++]);
+      }
+      consumer_.release(span);
+    }
+  }
+
+ private:
+  ConsumerType consumer_;
+  ProducerType producer_;
+  toolbox::util::Timer timer_;
+  std::array<ValueType, TestDataSize> test_data_;
+};
+
 template <typename Queue>
 class MPMCCorrectnessTest {
  public:
@@ -155,7 +212,338 @@ class MPMCCorrectnessTest {
   toolbox::util::Timer timer_;
 };
 
+template <typename Queue>
+class MPMCBulkCorrectnessTest {
+ public:
+  using ValueType = typename Queue::ValueType;
+
+  static_assert(std::is_same<uint64_t, ValueType>(), "we need uint64_t");
+
+ public:
+  static auto pushPop(uint32_t n_thread, uint32_t n_ops, uint32_t batch, Queue &q,
+                      std::atomic_uint64_t &sum, uint32_t x) -> void {
+    auto producer = q.producer();
+    auto consumer = q.consumer();
+    std::vector<uint64_t> src(batch);
+    std::vector<uint64_t> dst(batch);
+    uint64_t local_sum = 0;
+    uint64_t next = x;
+    uint32_t n_src = 0;
+    uint32_t n_pushed = 0;
+    uint64_t received = 0;
+    uint64_t expect = n_ops / n_thread + (x < n_ops % n_thread ? 1 : 0);
+    while (n_src > 0 || next < n_ops || received < expect) {
+      if (n_src == 0) {
+        n_pushed = 0;
+        for (; n_src < batch && next < n_ops; n_src++, next += n_thread) {
+          src[n_src] = next;
+        }
+      }
+      if (n_src > 0) {
+        if (x % 2 == 0) {
+          if (producer.pushBulk(src.begin() + n_pushed, n_src)) {
+            n_pushed += n_src;
+            n_src = 0;
+          }
+        } else {
+          auto n = producer.pushBurst(src.begin() + n_pushed, n_src);
+          n_pushed += n;
+          n_src -= n;
+        }
+      }
+      if (received < expect) {
+        uint32_t want = std::min<uint64_t>(batch, expect - received);
+        uint32_t n = 0;
+        if (x % 2 == 0) {
+          n = consumer.popBurst(dst.begin(), want);
+        } else if (consumer.popBulk(dst.begin(), want)) {
+          n = want;
+        }
+        received += n;
+        for (uint32_t i = 0; i < n; i++) {
+          local_sum += dst[i];
+        }
+      }
+    }
+    sum += local_sum;
+  }
+
+ public:
+  explicit MPMCBulkCorrectnessTest(Queue &q, uint32_t n_threads, uint32_t n_ops,
+                                   uint32_t batch) {
+    spdlog::info("Queue Type: {}, N thread: {}, N Ops: {}, Batch: {}",
+                 toolbox::util::TypenameOf<Queue>(), n_threads, n_ops, batch);
+    timer_.begin();
+
+    std::atomic_uint64_t sum(0);
+    for (uint32_t i = 0; i < n_threads; i++) {
+      ts_.emplace_back(&MPMCBulkCorrectnessTest::pushPop, n_threads, n_ops, batch,
+                       std::ref(q), std::ref(sum), i);
+    }
+    for (auto &t : ts_) {
+      t.join();
+    }
+    uint64_t expect = (uint64_t)n_ops * (n_ops - 1) / 2 - sum;
+    EXPECT_EQ(expect, 0);
+
+    timer_.end();
+    spdlog::info("done: {} ms", timer_.elapsed<std::chrono::milliseconds>());
+  }
+
+  ~MPMCBulkCorrectnessTest() = default;
+
+ private:
+  std::vector<std::thread> ts_;
+  toolbox::util::Timer timer_;
+};
+
+template <typename Queue>
+class MPMCZeroCopyCorrectnessTest {
+ public:
+  using ValueType = typename Queue::ValueType;
+
+  static_assert(std::is_same<uint64_t, ValueType>(), "we need uint64_t");
+
+ public:
+  static auto pushPop(uint32_t n_thread, uint32_t n_ops, uint32_t batch, Queue &q,
+                      std::atomic_uint64_t &sum, uint32_t x) -> void {
+    auto producer = q.producer();
+    auto consumer = q.consumer();
+    uint64_t local_sum = 0;
+    uint64_t src = x;
+    uint64_t received = 0;
+    uint64_t expect = n_ops / n_thread + (x < n_ops % n_thread ? 1 : 0);
+    while (src < n_ops || received < expect) {
+      if (src < n_ops) {
+        uint64_t remain = (n_ops - src + n_thread - 1) / n_thread;
+        auto span = producer.reserve(std::min<uint64_t>(batch, remain));
+        for (uint32_t i = 0; i < span.size(); i++, src += n_thread) {
+          span.emplace(i, src);
+        }
+        producer.commit(span);
+      }
+      if (received < expect) {
+        auto span = consumer.peek(std::min<uint64_t>(batch, expect - received));
+        for (uint32_t i = 0; i < span.size(); i++) {
+          local_sum += span[i];
+        }
+        received += span.size();
+        consumer.release(span);
+      }
+    }
+    sum += local_sum;
+  }
+
+ public:
+  explicit MPMCZeroCopyCorrectnessTest(Queue &q, uint32_t n_threads, uint32_t n_ops,
+                                       uint32_t batch) {
+    spdlog::info("Queue Type: {}, N thread: {}, N Ops: {}, Batch: {}",
+                 toolbox::util::TypenameOf<Queue>(), n_threads, n_ops, batch);
+    timer_.begin();
+
+    std::atomic_uint64_t sum(0);
+    for (uint32_t i = 0; i < n_threads; i++) {
+      ts_.emplace_back(&MPMCZeroCopyCorrectnessTest::pushPop, n_threads, n_ops, batch,
+                       std::ref(q), std::ref(sum), i);
+    }
+    for (auto &t : ts_) {
+      t.join();
+    }
+    uint64_t expect = (uint64_t)n_ops * (n_ops - 1) / 2 - sum;
+    EXPECT_EQ(expect, 0);
+
+    timer_.end();
+    spdlog::info("done: {} ms", timer_.elapsed<std::chrono::milliseconds>());
+  }
+
+  ~MPMCZeroCopyCorrectnessTest() = default;
+
+ private:
+  std::vector<std::thread> ts_;
+  toolbox::util::Timer timer_;
+};
+
+template <typename Queue>
+class BlockingCorrectnessTest {
+ public:
+  using ValueType = typename Queue::ValueType;
+
+  static_assert(std::is_same<uint64_t, ValueType>(), "we need uint64_t");
+
+ public:
+  static auto produce(uint32_t n_producer, uint32_t n_ops, Queue &q, uint32_t x)
+      -> void {
+    auto producer = q.producer();
+    for (uint64_t src = x; src < n_ops; src += n_producer) {
+      producer.pushWait(src);
+    }
+  }
+
+  static auto consume(uint32_t n_consumer, uint32_t n_ops, Queue &q,
+                      std::atomic_uint64_t &sum, uint32_t x) -> void {
+    auto consumer = q.consumer();
+    uint64_t local_sum = 0;
+    uint64_t expect = n_ops / n_consumer + (x < n_ops % n_consumer ? 1 : 0);
+    for (uint64_t i = 0; i < expect; i++) {
+      uint64_t dst = 0;
+      consumer.popWait(dst);
+      local_sum += dst;
+    }
+    sum += local_sum;
+  }
+
+ public:
+  explicit BlockingCorrectnessTest(Queue &q, uint32_t n_producer, uint32_t n_consumer,
+                                   uint32_t n_ops) {
+    spdlog::info("Queue Type: {}, N producer: {}, N consumer: {}, N Ops: {}",
+                 toolbox::util::TypenameOf<Queue>(), n_producer, n_consumer, n_ops);
+    timer_.begin();
+
+    std::atomic_uint64_t sum(0);
+    for (uint32_t i = 0; i < n_consumer; i++) {
+      ts_.emplace_back(&BlockingCorrectnessTest::consume, n_consumer, n_ops, std::ref(q),
+                       std::ref(sum), i);
+    }
+    for (uint32_t i = 0; i < n_producer; i++) {
+      ts_.emplace_back(&BlockingCorrectnessTest::produce, n_producer, n_ops, std::ref(q),
+                       i);
+    }
+    for (auto &t : ts_) {
+      t.join();
+    }
+    uint64_t expect = (uint64_t)n_ops * (n_ops - 1) / 2 - sum;
+    EXPECT_EQ(expect, 0);
+
+    timer_.end();
+    spdlog::info("done: {} ms", timer_.elapsed<std::chrono::milliseconds>());
+  }
+
+  ~BlockingCorrectnessTest() = default;
+
+ private:
+  std::vector<std::thread> ts_;
+  toolbox::util::Timer timer_;
+};
+
+/// The queue shall be empty and have a capacity of 16.
+template <typename Queue>
+auto CheckBlockingSemantics(Queue &q) -> void {
+  using namespace std::chrono_literals;
+  uint64_t e = 0;
+  toolbox::util::Timer timer;
+  timer.begin();
+  EXPECT_FALSE(q.popWaitFor(e, 5ms));
+  timer.end();
+  EXPECT_GE(timer.elapsed<std::chrono::milliseconds>(), 5);
+  for (uint64_t i = 0; i < 16; i++) {
+    EXPECT_TRUE(q.pushWaitFor(1ms, i));
+  }
+  EXPECT_FALSE(q.pushWaitFor(5ms, 16));
+
+  // a blocked producer is woken up by a consumer
+  std::thread consumer([&q] {
+    std::this_thread::sleep_for(10ms);
+    uint64_t got = 0;
+    q.popWait(got);
+    EXPECT_EQ(got, 0);
+  });
+  q.pushWait(16);
+  consumer.join();
+
+  // a blocked consumer is woken up by a producer
+  for (uint64_t i = 1; i <= 16; i++) {
+    q.popWait(e);
+    EXPECT_EQ(e, i);
+  }
+  std::thread producer([&q] {
+    std::this_thread::sleep_for(10ms);
+    q.pushWait(42);
+  });
+  EXPECT_TRUE(q.popWaitFor(e, 10s));
+  EXPECT_EQ(e, 42);
+  producer.join();
+}
+
+/// The queue shall be empty and have a capacity of 16.
+template <typename Queue>
+auto CheckZeroCopySemantics(Queue &q) -> void {
+  using ValueType = typename Queue::ValueType;
+  for (uint32_t round = 0; round < 4; round++) {
+    auto span = q.reserve(10);
+    EXPECT_EQ(span.size(), 10);
+    for (uint32_t i = 0; i < span.size(); i++) {
+      span.emplace(i, ValueType(i));
+    }
+    q.commit(span);
+    span = q.reserve(10);
+    EXPECT_EQ(span.size(), 6);
+    for (uint32_t i = 0; i < span.size(); i++) {
+      span.emplace(i, ValueType(10 + i));
+    }
+    q.commit(span);
+    EXPECT_TRUE(q.reserve(1).empty());
+
+    auto view = q.peek(3);
+    EXPECT_EQ(view.size(), 3);
+    EXPECT_EQ(view.firstSize() + view.secondSize(), 3);
+    for (uint32_t i = 0; i < view.size(); i++) {
+      EXPECT_EQ(view[i], ValueType(i));
+    }
+    q.release(view);
+    view = q.peek(32);
+    EXPECT_EQ(view.size(), 13);
+    for (uint32_t i = 0; i < view.size(); i++) {
+      EXPECT_EQ(view[i], ValueType(3 + i));
+    }
+    q.release(view);
+    EXPECT_TRUE(q.peek(1).empty());
+
+    // shift the ring so that the next round wraps around
+    span = q.reserve(5);
+    for (uint32_t i = 0; i < span.size(); i++) {
+      span.emplace(i, ValueType(i));
+    }
+    q.commit(span);
+    q.release(q.peek(5));
+  }
+}
+
+/// The queue shall be empty and have a capacity of 16.
+template <typename Queue>
+auto CheckBulkSemantics(Queue &q) -> void {
+  std::vector<uint64_t> src(32);
+  std::vector<uint64_t> dst(32);
+  for (uint64_t i = 0; i < src.size(); i++) {
+    src[i] = i;
+  }
+  // wrap around the ring several times
+  for (uint32_t round = 0; round < 4; round++) {
+    EXPECT_TRUE(q.pushBulk(src.begin(), 10));
+    EXPECT_FALSE(q.pushBulk(src.begin() + 10, 10));
+    EXPECT_EQ(q.pushBurst(src.begin() + 10, 10), 6);
+    EXPECT_EQ(q.pushBurst(src.begin(), 1), 0);
+    EXPECT_FALSE(q.popBulk(dst.begin(), 17));
+    EXPECT_TRUE(q.popBulk(dst.begin(), 3));
+    EXPECT_EQ(q.popBurst(dst.begin() + 3, 32), 13);
+    EXPECT_EQ(q.popBurst(dst.begin(), 1), 0);
+    for (uint64_t i = 0; i < 16; i++) {
+      EXPECT_EQ(dst[i], i);
+    }
+    EXPECT_TRUE(q.pushBulk(src.begin(), 0));
+    EXPECT_TRUE(q.pushBulk(src.begin(), 5));
+    EXPECT_TRUE(q.popBulk(dst.begin(), 5));
+  }
+}
+
 #define RunSPSCCorrectnessTest(q, size) \
   std::make_shared<SPSCCorrectnessTest<decltype(q), size>>(q)
 #define RunMPMCCorrectnessTest(q, n_threads, n_ops) \
   std::make_shared<MPMCCorrectnessTest<decltype(q)>>(q, n_threads, n_ops)
+#define RunMPMCBulkCorrectnessTest(q, n_threads, n_ops, batch) \
+  std::make_shared<MPMCBulkCorrectnessTest<decltype(q)>>(q, n_threads, n_ops, batch)
+#define RunSPSCZeroCopyCorrectnessTest(q, size) \
+  std::make_shared<SPSCZeroCopyCorrectnessTest<decltype(q), size>>(q)
+#define RunMPMCZeroCopyCorrectnessTest(q, n_threads, n_ops, batch) \
+  std::make_shared<MPMCZeroCopyCorrectnessTest<decltype(q)>>(q, n_threads, n_ops, batch)
+#define RunBlockingCorrectnessTest(q, n_producer, n_consumer, n_ops) \
+  std::make_shared<BlockingCorrectnessTest<decltype(q)>>(q, n_producer, n_consumer, n_ops)
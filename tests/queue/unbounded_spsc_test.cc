@@ -17,30 +17,79 @@ TEST(UnboundedSPSCQueue, DtorTest) {
     for (int i = 0; i < 10; ++i) {
       q.push(DtorCounter());
     }
-    EXPECT_EQ(DtorCounter::get(), 11);
+    EXPECT_EQ(DtorCounter::get(), 10);
     {
       DtorCounter dummy;
       EXPECT_TRUE(q.pop(dummy));
       EXPECT_TRUE(q.pop(dummy));
     }
-    EXPECT_EQ(DtorCounter::get(), 11);
+    EXPECT_EQ(DtorCounter::get(), 8);
   }
   EXPECT_EQ(DtorCounter::get(), 0);
   {
-    UnboundedSPSC<DtorCounter> q;
-    for (int i = 0; i < 3; ++i) {
+    // elements left in several blocks
+    toolbox::container::UnboundedSPSCQueue<DtorCounter, 2> q;
+    for (int i = 0; i < 7; ++i) {
       q.push(DtorCounter());
     }
-    EXPECT_EQ(DtorCounter::get(), 4);
+    EXPECT_EQ(DtorCounter::get(), 7);
     {
       DtorCounter dummy;
-      EXPECT_TRUE(q.pop(dummy));
+      for (int i = 0; i < 3; ++i) {
+        EXPECT_TRUE(q.pop(dummy));
+      }
     }
     EXPECT_EQ(DtorCounter::get(), 4);
     q.push(DtorCounter());
-    EXPECT_EQ(DtorCounter::get(), 4);
-    q.push(DtorCounter());
     EXPECT_EQ(DtorCounter::get(), 5);
   }
   EXPECT_EQ(DtorCounter::get(), 0);
 }
+
+TEST(UnboundedSPSCQueue, BlockTest) {
+  // tiny blocks, so that blocks are linked and reused all the time
+  toolbox::container::UnboundedSPSCQueue<uint64_t, 4> iq;
+  RunSPSCCorrectnessTest(iq, 1 << 20);
+  toolbox::container::UnboundedSPSCQueue<std::string, 3> sq(2);
+  RunSPSCCorrectnessTest(sq, 1 << 20);
+}
+
+TEST(UnboundedSPSCQueue, RetainTest) {
+  toolbox::container::UnboundedSPSCQueue<uint64_t, 16> q(4);
+  uint64_t got = 0;
+  EXPECT_FALSE(q.pop(got));
+  for (uint64_t i = 0; i < 16 * 64; i++) {
+    q.push(i);
+  }
+  EXPECT_EQ(q.blockCount(), 64);
+  EXPECT_EQ(q.approximateSize(), 16 * 64);
+  for (uint64_t i = 0; i < 16 * 64; i++) {
+    EXPECT_TRUE(q.pop(got));
+    EXPECT_EQ(got, i);
+  }
+  EXPECT_FALSE(q.pop(got));
+  EXPECT_EQ(q.approximateSize(), 0);
+
+  // drained blocks beyond the cap are freed once the producer moves on
+  q.push(0);
+  EXPECT_EQ(q.blockCount(), 4);
+  EXPECT_TRUE(q.pop(got));
+
+  // and the ones within the cap are reused
+  for (uint64_t i = 0; i < (1 << 16); i++) {
+    q.push(i);
+    EXPECT_TRUE(q.pop(got));
+    EXPECT_EQ(got, i);
+  }
+  EXPECT_EQ(q.blockCount(), 4);
+
+  toolbox::container::UnboundedSPSCQueue<uint64_t, 16> uq;
+  for (uint64_t i = 0; i < 16 * 64; i++) {
+    uq.push(i);
+  }
+  for (uint64_t i = 0; i < 16 * 64; i++) {
+    EXPECT_TRUE(uq.pop(got));
+  }
+  uq.push(0);
+  EXPECT_EQ(uq.blockCount(), 64);
+}
@@ -0,0 +1,100 @@
+#include "queue/work_stealing.hh"
+
+#include <thread>
+#include <vector>
+
+#include "test_util.hh"
+
+using toolbox::container::WorkStealingDeque;
+
+TEST(WorkStealingDeque, SemanticsTest) {
+  WorkStealingDeque<uint64_t> dq;
+  uint64_t e = 0;
+  EXPECT_FALSE(dq.pop(e));
+  EXPECT_FALSE(dq.steal(e));
+  for (uint64_t i = 1; i <= 5; i++) {
+    dq.push(i);
+  }
+  EXPECT_EQ(dq.approximateSize(), 5);
+  // the owner works as a stack, thieves take the oldest elements
+  EXPECT_TRUE(dq.pop(e));
+  EXPECT_EQ(e, 5);
+  EXPECT_TRUE(dq.steal(e));
+  EXPECT_EQ(e, 1);
+  EXPECT_TRUE(dq.steal(e));
+  EXPECT_EQ(e, 2);
+  EXPECT_TRUE(dq.pop(e));
+  EXPECT_EQ(e, 4);
+  EXPECT_TRUE(dq.pop(e));
+  EXPECT_EQ(e, 3);
+  EXPECT_FALSE(dq.pop(e));
+  EXPECT_FALSE(dq.steal(e));
+  EXPECT_TRUE(dq.empty());
+  EXPECT_THROW(WorkStealingDeque<uint64_t>(0), std::runtime_error);
+}
+
+TEST(WorkStealingDeque, GrowTest) {
+  WorkStealingDeque<uint64_t> dq(2);
+  uint32_t capacity = dq.capacity();
+  uint64_t e = 0;
+  // wrap around the ring before it grows
+  for (uint64_t i = 0; i < 3; i++) {
+    dq.push(i);
+    EXPECT_TRUE(dq.steal(e));
+  }
+  for (uint64_t i = 0; i < 100; i++) {
+    dq.push(i);
+  }
+  EXPECT_GT(dq.capacity(), capacity);
+  EXPECT_EQ(dq.approximateSize(), 100);
+  EXPECT_TRUE(dq.steal(e));
+  EXPECT_EQ(e, 0);
+  for (uint64_t i = 99; i > 0; i--) {
+    EXPECT_TRUE(dq.pop(e));
+    EXPECT_EQ(e, i);
+  }
+  EXPECT_FALSE(dq.pop(e));
+}
+
+TEST(WorkStealingDeque, StealCorrectnessTest) {
+  constexpr uint64_t n_ops = 1 << 20;
+  constexpr uint32_t n_thief = 3;
+  WorkStealingDeque<uint64_t> dq(16);
+  std::vector<std::atomic_uint32_t> seen(n_ops);
+  std::atomic_uint64_t n_taken{0};
+
+  std::vector<std::thread> thieves;
+  for (uint32_t i = 0; i < n_thief; i++) {
+    thieves.emplace_back([&] {
+      uint64_t e = 0;
+      while (n_taken.load() < n_ops) {
+        if (dq.steal(e)) {
+          seen[e].fetch_add(1);
+          n_taken.fetch_add(1);
+        } else {
+          std::this_thread::yield();
+        }
+      }
+    });
+  }
+  uint64_t e = 0;
+  for (uint64_t i = 0; i < n_ops; i++) {
+    dq.push(i);
+    // the owner takes some elements back and races with thieves for the last ones
+    if (i % 3 == 0 and dq.pop(e)) {
+      seen[e].fetch_add(1);
+      n_taken.fetch_add(1);
+    }
+  }
+  while (dq.pop(e)) {
+    seen[e].fetch_add(1);
+    n_taken.fetch_add(1);
+  }
+  for (auto& t : thieves) {
+    t.join();
+  }
+  EXPECT_EQ(n_taken.load(), n_ops);
+  for (uint64_t i = 0; i < n_ops; i++) {
+    EXPECT_EQ(seen[i].load(), 1) << i;
+  }
+}
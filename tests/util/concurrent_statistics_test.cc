@@ -0,0 +1,91 @@
+#include "util/concurrent_statistics.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using toolbox::util::ConcurrentStatistics;
+using toolbox::util::Statistics;
+using toolbox::util::StatisticsCollector;
+
+TEST(ConcurrentStatistics, MultiThreadTest) {
+  constexpr uint32_t n_thread = 8;
+  constexpr uint64_t n_sample = 1 << 16;
+  ConcurrentStatistics<4, 32> statistics;
+  Statistics<4, 32> expect;
+  for (uint64_t i = 0; i < n_sample; i++) {
+    expect.record(i % 600);
+  }
+
+  std::atomic_bool done{false};
+  // snapshots taken while the writers keep going never go backwards
+  std::thread collector([&] {
+    uint64_t last = 0;
+    while (not done.load()) {
+      uint64_t n = statistics.snapshot().count();
+      EXPECT_GE(n, last);
+      last = n;
+      std::this_thread::yield();
+    }
+  });
+  std::vector<std::thread> writers;
+  for (uint32_t t = 0; t < n_thread; t++) {
+    writers.emplace_back([&statistics] {
+      for (uint64_t i = 0; i < n_sample; i++) {
+        statistics.record(i % 600);
+      }
+    });
+  }
+  for (auto& t : writers) {
+    t.join();
+  }
+  done.store(true);
+  collector.join();
+
+  auto got = statistics.snapshot();
+  EXPECT_EQ(got.count(), n_thread * n_sample);
+  EXPECT_EQ(got.sum(), n_thread * expect.sum());
+  EXPECT_EQ(got.min(), expect.min());
+  EXPECT_EQ(got.max(), expect.max());
+  EXPECT_EQ(got.percentile(0.5), expect.percentile(0.5));
+  EXPECT_EQ(got.percentile(0.99), expect.percentile(0.99));
+}
+
+TEST(ConcurrentStatistics, IntervalTest) {
+  ConcurrentStatistics<1, 128> statistics;
+  StatisticsCollector<1, 128> collector(statistics, 3);
+  auto t0 = toolbox::util::clock::now();
+  auto record = [&statistics](uint64_t x, uint32_t n) {
+    std::thread([&statistics, x, n] {
+      for (uint32_t i = 0; i < n; i++) {
+        statistics.record(x);
+      }
+    }).join();
+  };
+
+  record(10, 100);
+  collector.collect(t0 + std::chrono::seconds(1));
+  record(20, 50);
+  collector.collect(t0 + std::chrono::seconds(2));
+
+  auto last = collector.interval();
+  EXPECT_EQ(last.count(), 50);
+  EXPECT_EQ(last.min(), 20);
+  EXPECT_EQ(collector.over(std::chrono::seconds(1)).count(), 50);
+  auto both = collector.over(std::chrono::seconds(10));
+  EXPECT_EQ(both.count(), 150);
+  EXPECT_EQ(both.min(), 10);
+  EXPECT_EQ(both.max(), 20);
+
+  // the snapshot taken at construction is dropped, the window starts at t0 + 1s
+  record(30, 10);
+  collector.collect(t0 + std::chrono::seconds(3));
+  EXPECT_EQ(collector.interval().count(), 10);
+  EXPECT_EQ(collector.over(std::chrono::seconds(1)).count(), 10);
+  EXPECT_EQ(collector.over(std::chrono::seconds(10)).count(), 60);
+  EXPECT_EQ(collector.total().count(), 160);
+
+  EXPECT_THROW((StatisticsCollector<1, 128>(statistics, 1)), std::runtime_error);
+}
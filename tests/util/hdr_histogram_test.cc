@@ -0,0 +1,204 @@
+#include "util/hdr_histogram.hh"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <sstream>
+#include <tuple>
+#include <vector>
+
+using toolbox::util::HdrHistogram;
+using toolbox::util::HdrHistogramLogWriter;
+
+using Recorded = std::vector<std::tuple<uint64_t, uint64_t, uint64_t>>;
+
+template <typename Count>
+auto recorded(const HdrHistogram<Count>& h) -> Recorded {
+  Recorded r;
+  h.forEach([&r](uint64_t lo, uint64_t hi, uint64_t n) { r.emplace_back(lo, hi, n); });
+  return r;
+}
+
+TEST(HdrHistogram, LayoutTest) {
+  // 1us to 1h at 3 digits, the same layout as the Java HdrHistogram
+  HdrHistogram<> h(1, 3600UL * 1000 * 1000, 3);
+  EXPECT_EQ(h.footprint(), 23552);
+  EXPECT_EQ(h.lowestEquivalent(2047), 2047);
+  EXPECT_EQ(h.lowestEquivalent(2048), 2048);
+  EXPECT_EQ(h.highestEquivalent(2048), 2049);
+  EXPECT_EQ(h.lowestEquivalent(10007), 10000);
+  EXPECT_EQ(h.highestEquivalent(10007), 10007);
+
+  HdrHistogram<> coarse(1000, 3600UL * 1000 * 1000, 2);
+  EXPECT_EQ(coarse.lowestEquivalent(1023), 512);
+  EXPECT_EQ(coarse.highestEquivalent(1023), 1023);
+
+  EXPECT_THROW(HdrHistogram<>(0, 100, 3), std::runtime_error);
+  EXPECT_THROW(HdrHistogram<>(1, 100, 6), std::runtime_error);
+  EXPECT_THROW(HdrHistogram<>(100, 150, 3), std::runtime_error);
+}
+
+TEST(HdrHistogram, RelativeErrorTest) {
+  // 1ns to 1h at 3 digits
+  HdrHistogram<> h(1, 3600UL * 1000 * 1000 * 1000, 3);
+  std::mt19937_64 rng(42);
+  for (uint32_t i = 0; i < 100000; i++) {
+    // log-uniform over the whole range
+    uint64_t v = rng() >> (rng() % 64);
+    if (v > h.highest()) continue;
+    uint64_t lo = h.lowestEquivalent(v);
+    uint64_t hi = h.highestEquivalent(v);
+    ASSERT_LE(lo, v);
+    ASSERT_GE(hi, v);
+    ASSERT_LE(hi - lo + 1, std::max<uint64_t>(1, v / 1000)) << v;
+    ASSERT_TRUE(h.record(v));
+  }
+  uint64_t n = 0;
+  h.forEach([&n](uint64_t, uint64_t, uint64_t c) { n += c; });
+  EXPECT_EQ(n, h.count());
+}
+
+TEST(HdrHistogram, PercentileTest) {
+  HdrHistogram<> h(1, 1000UL * 1000 * 1000, 3);
+  EXPECT_EQ(h.percentile(0.5), 0);
+  EXPECT_EQ(h.max(), 0);
+  for (uint64_t v = 1; v <= 100000; v++) {
+    h.record(v);
+  }
+  std::cout << h.dump();
+  EXPECT_EQ(h.count(), 100000);
+  EXPECT_EQ(h.min(), 1);
+  EXPECT_NEAR(h.max(), 100000, 100);
+  EXPECT_GE(h.max(), 100000);
+  EXPECT_NEAR(h.mean(), 50000.5, 50);
+  for (double p : {0.1, 0.5, 0.9, 0.99, 0.999}) {
+    auto expected = static_cast<double>(p * 100000);
+    EXPECT_NEAR(static_cast<double>(h.percentile(p)), expected, expected / 1000) << p;
+    EXPECT_GE(static_cast<double>(h.percentile(p)), expected) << p;
+  }
+  EXPECT_EQ(h.percentile(0), 1);
+  EXPECT_EQ(h.percentile(1), h.max());
+
+  // a long tail is reported as it is
+  h.record(60UL * 1000 * 1000 * 1000 / 1000, 1000);
+  EXPECT_NEAR(h.percentile(0.999), 60UL * 1000 * 1000, 60UL * 1000);
+
+  h.reset();
+  EXPECT_EQ(h.count(), 0);
+  EXPECT_TRUE(recorded(h).empty());
+}
+
+TEST(HdrHistogram, OverflowTest) {
+  HdrHistogram<> h(1, 1000, 2);
+  EXPECT_TRUE(h.record(1000));
+  EXPECT_FALSE(h.record(2001, 3));
+  EXPECT_EQ(h.count(), 1);
+  EXPECT_EQ(h.overflow(), 3);
+  EXPECT_GE(h.max(), 1000);
+}
+
+TEST(HdrHistogram, MergeTest) {
+  HdrHistogram<> a(1, 1000000, 3);
+  HdrHistogram<> b(1, 1000000, 3);
+  HdrHistogram<> c(1000, 1000000000, 2);
+  for (uint64_t v = 1; v <= 1000; v++) {
+    a.record(v);
+    b.record(v * 1000);
+    c.record(v * 1000);
+  }
+  HdrHistogram<> ab = a;
+  ab += b;
+  EXPECT_EQ(ab.count(), 2000);
+  EXPECT_EQ(ab.min(), 1);
+  EXPECT_EQ(ab.max(), b.max());
+
+  // another layout is recorded bucket by bucket
+  HdrHistogram<> ac = a;
+  ac += c;
+  EXPECT_EQ(ac.count(), 2000);
+  EXPECT_NEAR(ac.percentile(0.75), 500000, 500000 / 100);
+}
+
+TEST(HdrHistogram, EncodeTest) {
+  HdrHistogram<> h(1, 3600UL * 1000 * 1000 * 1000, 3);
+  std::mt19937_64 rng(7);
+  for (uint32_t i = 0; i < 10000; i++) {
+    h.record(rng() % 1000000 + 1000, rng() % 3 + 1);
+  }
+  h.record(0);
+  h.record(uint64_t{1} << 40);
+
+  std::vector<uint8_t> raw = h.encode();
+  // big-endian cookie, then the payload length
+  EXPECT_EQ(raw[0], 0x1c);
+  EXPECT_EQ(raw[1], 0x84);
+  EXPECT_EQ(raw[2], 0x93);
+  EXPECT_EQ(raw[3], 0x13);
+  uint32_t payload = (raw[4] << 24) | (raw[5] << 16) | (raw[6] << 8) | raw[7];
+  EXPECT_EQ(payload + HdrHistogram<>::v2_header_size, raw.size());
+  EXPECT_EQ(raw[15], 3);
+
+  std::vector<uint8_t> compressed = h.encodeCompressed();
+  EXPECT_EQ(compressed[3], 0x14);
+  EXPECT_LT(compressed.size(), raw.size());
+
+  for (const auto& buf : {raw, compressed}) {
+    auto d = HdrHistogram<>::decode(buf.data(), buf.size());
+    EXPECT_EQ(d.lowest(), h.lowest());
+    EXPECT_EQ(d.highest(), h.highest());
+    EXPECT_EQ(d.significantDigits(), 3);
+    EXPECT_EQ(d.count(), h.count());
+    EXPECT_EQ(d.min(), h.min());
+    EXPECT_EQ(d.max(), h.max());
+    EXPECT_EQ(recorded(d), recorded(h));
+  }
+
+  auto d = HdrHistogram<uint32_t>::fromBase64(h.toBase64());
+  EXPECT_EQ(recorded(d), recorded(h));
+  EXPECT_EQ(h.toBase64().substr(0, 4), "HIST");
+
+  // an empty histogram has an empty payload
+  HdrHistogram<> empty(1, 1000, 2);
+  EXPECT_EQ(empty.encode().size(), HdrHistogram<>::v2_header_size);
+  EXPECT_EQ(HdrHistogram<>::fromBase64(empty.toBase64()).count(), 0);
+
+  raw[0] = 0;
+  EXPECT_THROW(HdrHistogram<>::decode(raw.data(), raw.size()), std::runtime_error);
+  EXPECT_THROW(HdrHistogram<>::decode(compressed.data(), compressed.size() / 2),
+               std::runtime_error);
+  EXPECT_THROW(HdrHistogram<>::fromBase64("HIST!"), std::runtime_error);
+
+  // runs of zeros past the counts, the last one of INT64_MIN zeros
+  for (const std::vector<uint8_t>& payload :
+       {std::vector<uint8_t>{0xff, 0x7f, 0x02}, std::vector<uint8_t>(9, 0xff)}) {
+    std::vector<uint8_t> buf = empty.encode();
+    buf[7] = static_cast<uint8_t>(payload.size());
+    buf.insert(buf.end(), payload.begin(), payload.end());
+    EXPECT_THROW(HdrHistogram<>::decode(buf.data(), buf.size()), std::runtime_error);
+  }
+}
+
+TEST(HdrHistogram, LogWriterTest) {
+  HdrHistogram<> h(1, 3600UL * 1000 * 1000 * 1000, 3);
+  for (uint64_t v = 1; v <= 1000; v++) {
+    h.record(v * 1000);
+  }
+  std::stringstream ss;
+  HdrHistogramLogWriter writer(ss);
+  writer.writeHeader(1441812279.474);
+  writer.writeInterval(h, 0.127, 1.007);
+
+  std::string line;
+  std::getline(ss, line);
+  EXPECT_EQ(line, "#[Histogram log format version 1.3]");
+  std::getline(ss, line);
+  EXPECT_EQ(line.rfind("#[StartTime: 1441812279.474 (seconds since epoch), ", 0), 0);
+  std::getline(ss, line);
+  EXPECT_EQ(line,
+            "\"StartTimestamp\",\"Interval_Length\",\"Interval_Max\","
+            "\"Interval_Compressed_Histogram\"");
+  std::getline(ss, line);
+  EXPECT_EQ(line.rfind("0.127,1.007,1.000,", 0), 0) << line;
+  auto d = HdrHistogram<>::fromBase64(line.substr(line.rfind(',') + 1));
+  EXPECT_EQ(recorded(d), recorded(h));
+}
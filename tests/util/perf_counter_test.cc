@@ -0,0 +1,40 @@
+#include "util/perf_counter.hh"
+
+#include <gtest/gtest.h>
+
+#include <map>
+
+using namespace toolbox::util;
+
+/// Without any event opened, the counters do nothing.
+TEST(PerfCounters, UnavailableTest) {
+  PerfCounters counters({{"bogus", PERF_TYPE_HARDWARE, PERF_COUNT_HW_MAX}});
+  EXPECT_FALSE(counters.available());
+  counters.start();
+  counters.stop();
+  EXPECT_TRUE(counters.read().empty());
+}
+
+TEST(PerfCounters, CountTest) {
+  PerfCounters counters;
+  if (not counters.available()) {
+    GTEST_SKIP() << "perf_event_open is not available";
+  }
+  counters.start();
+  volatile uint64_t x = 0;
+  for (uint64_t i = 0; i < 1000000; i++) {
+    x = x + i;
+  }
+  counters.stop();
+  std::map<std::string, double> values;
+  for (auto& [name, value] : counters.read()) {
+    values[name] = value;
+  }
+  ASSERT_EQ(values.count("instructions"), 1);
+  EXPECT_GT(values["instructions"], 1000000);
+
+  // nothing counts once stopped
+  auto before = counters.read();
+  x = x + 1;
+  EXPECT_EQ(counters.read(), before);
+}
@@ -0,0 +1,65 @@
+#include "util/simd.hh"
+
+#include <gtest/gtest.h>
+
+#include <random>
+#include <vector>
+
+using namespace toolbox::util;
+
+/// Every kernel agrees with the scalar one, lengths not being a multiple of the width.
+TEST(Simd, KernelTest) {
+  std::mt19937_64 rng(42);
+  for (size_t n : {0, 1, 2, 3, 4, 5, 7, 8, 9, 15, 33, 1000, 1027}) {
+    std::vector<uint64_t> a(n);
+    std::vector<uint64_t> b(n);
+    for (size_t i = 0; i < n; i++) {
+      a[i] = rng() >> 8;
+      b[i] = rng() >> 8;
+    }
+    std::vector<uint64_t> expected = a;
+    addArrayScalar(expected.data(), b.data(), n);
+    std::vector<uint64_t> actual = a;
+    addArray(actual.data(), b.data(), n);
+    EXPECT_EQ(actual, expected) << n;
+#if defined(TOOLBOX_SIMD_X86)
+    actual = a;
+    addArraySSE2(actual.data(), b.data(), n);
+    EXPECT_EQ(actual, expected) << n;
+#endif
+
+    subArrayScalar(expected.data(), b.data(), n);
+    EXPECT_EQ(expected, a);
+    subArray(actual.data(), b.data(), n);
+    EXPECT_EQ(actual, a) << n;
+
+    uint64_t sum = sumArrayScalar(a.data(), n);
+    EXPECT_EQ(sumArray(a.data(), n), sum) << n;
+
+    std::vector<uint64_t> prefix(n);
+    EXPECT_EQ(prefixSumScalar(a.data(), prefix.data(), n), sum);
+    std::vector<uint64_t> actual_prefix(n);
+    EXPECT_EQ(prefixSum(a.data(), actual_prefix.data(), n), sum) << n;
+    EXPECT_EQ(actual_prefix, prefix) << n;
+
+#if defined(TOOLBOX_SIMD_X86)
+    actual = a;
+    addArraySSE2(actual.data(), b.data(), n);
+    subArraySSE2(actual.data(), b.data(), n);
+    EXPECT_EQ(actual, a) << n;
+    EXPECT_EQ(sumArraySSE2(a.data(), n), sum) << n;
+    std::fill(actual_prefix.begin(), actual_prefix.end(), 0);
+    EXPECT_EQ(prefixSumSSE2(a.data(), actual_prefix.data(), n), sum) << n;
+    EXPECT_EQ(actual_prefix, prefix) << n;
+    if (hasAVX2()) {
+      addArrayAVX2(actual.data(), b.data(), n);
+      subArrayAVX2(actual.data(), b.data(), n);
+      EXPECT_EQ(actual, a) << n;
+      EXPECT_EQ(sumArrayAVX2(a.data(), n), sum) << n;
+      std::fill(actual_prefix.begin(), actual_prefix.end(), 0);
+      EXPECT_EQ(prefixSumAVX2(a.data(), actual_prefix.data(), n), sum) << n;
+      EXPECT_EQ(actual_prefix, prefix) << n;
+    }
+#endif
+  }
+}
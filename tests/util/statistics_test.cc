@@ -65,4 +65,96 @@ TEST(Statistics, AllMethodTest) {
   EXPECT_TRUE(within_error_margin(statistics.percentile(0.95), 123));
   EXPECT_TRUE(within_error_margin(statistics.percentile(0.99), 126));
   EXPECT_TRUE(within_error_margin(statistics.percentile(0.999), 127));
-}
\ No newline at end of file
+}
+
+/// The per-level loop locate() used to run.
+template <uint32_t N, uint32_t scale>
+auto LocateByLoop(uint64_t x, uint32_t& i, uint32_t& j) -> bool {
+  for (i = 0; i < N; i++) {
+    uint64_t n = 1ULL << i;
+    if (x / n < scale) {
+      j = static_cast<uint32_t>(x / n);
+      return true;
+    }
+    x -= scale * n;
+  }
+  return false;
+}
+
+template <uint32_t N, uint32_t scale>
+auto CheckLocate() -> void {
+  using S = toolbox::util::Statistics<N, scale>;
+  uint64_t upper = ((1ULL << N) - 1) * scale;
+  std::mt19937_64 rng(N * scale);
+  auto check = [](uint64_t x) {
+    uint32_t i = 0, j = 0, ei = 0, ej = 0;
+    bool ok = S::locate(x, i, j);
+    ASSERT_EQ(ok, (LocateByLoop<N, scale>(x, ei, ej))) << x;
+    if (ok) {
+      ASSERT_EQ(i, ei) << x;
+      ASSERT_EQ(j, ej) << x;
+    }
+  };
+  for (uint64_t x = 0; x < std::min<uint64_t>(upper + 16, 1 << 20); x++) {
+    check(x);
+  }
+  for (uint32_t k = 0; k < 1 << 16; k++) {
+    check(rng() % (upper * 2));
+  }
+  check(UINT64_MAX);
+}
+
+TEST(Statistics, LocateTest) {
+  CheckLocate<1, 128>();
+  CheckLocate<4, 32>();
+  CheckLocate<10, 64>();
+  CheckLocate<20, 100>();
+  CheckLocate<31, 3>();
+}
+
+TEST(Statistics, CachedQueryTest) {
+  toolbox::util::Statistics<4, 32> statistics;
+  EXPECT_EQ(statistics.count(), 0);
+  EXPECT_EQ(statistics.max(), 0);
+  EXPECT_EQ(statistics.min(), 15 * 32);
+  for (uint64_t x = 0; x < 10; x++) {
+    statistics.record(x);
+  }
+  EXPECT_EQ(statistics.percentile(0.5), 5);
+  EXPECT_EQ(statistics.max(), 9);
+  // queries see the samples recorded after the last one
+  for (uint64_t x = 100; x < 110; x++) {
+    statistics.record(x);
+  }
+  EXPECT_EQ(statistics.count(), 20);
+  EXPECT_EQ(statistics.percentile(0.9), 108);
+  EXPECT_EQ(statistics.max(), 108);
+  statistics.record(1000);
+  EXPECT_EQ(statistics.max(), 15 * 32);
+  EXPECT_EQ(statistics.percentile(0.99), 15 * 32);
+  auto copy = statistics;
+  copy -= statistics;
+  EXPECT_EQ(copy.count(), 0);
+  EXPECT_EQ(copy.sum(), 0);
+  copy += statistics;
+  EXPECT_EQ(copy.percentile(0.5), statistics.percentile(0.5));
+}
+
+TEST(Statistics, PercentilesTest) {
+  toolbox::util::Statistics<10, 64> statistics;
+  std::mt19937_64 rng(42);
+  for (uint32_t i = 0; i < 10000; i++) {
+    statistics.record(rng() % 50000);
+  }
+  // ascending, descending and out of range percentiles agree with percentile()
+  std::array<double, 8> ps{0.1, 0.5, 0.9, 0.99, 0.5, 0.0, 1.0, -1.0};
+  auto r = statistics.percentiles(ps);
+  for (size_t k = 0; k < ps.size(); k++) {
+    EXPECT_EQ(r[k], statistics.percentile(ps[k])) << ps[k];
+  }
+  // reset leaves no trace in the queries
+  statistics.reset();
+  statistics.record(7);
+  EXPECT_EQ(statistics.percentiles(std::array<double, 2>{0.5, 0.99})[1], 7);
+  EXPECT_EQ(statistics.max(), 7);
+}
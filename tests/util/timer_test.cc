@@ -0,0 +1,88 @@
+#include "util/timer.hh"
+
+#include <gtest/gtest.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+using namespace toolbox::util;
+
+auto steadyNow() -> int64_t {
+  return std::chrono::duration_cast<nanoseconds>(clock::now().time_since_epoch()).count();
+}
+
+TEST(TscClock, CalibrationTest) {
+  std::cout << "invariant: " << TscClock::invariant()
+            << ", cycles per ns: " << TscClock::cyclesPerNano() << std::endl;
+  EXPECT_GT(TscClock::cyclesPerNano(), 0.0);
+  // on the epoch of the steady clock
+  EXPECT_LT(std::abs(static_cast<int64_t>(TscClock::now()) - steadyNow()), 1000000);
+
+  int64_t ns0 = steadyNow();
+  uint64_t tsc0 = TscClock::now();
+  uint64_t c0 = tscp();
+  std::this_thread::sleep_for(milliseconds(50));
+  uint64_t c1 = tscp();
+  uint64_t tsc1 = TscClock::now();
+  int64_t ns1 = steadyNow();
+  auto steady = static_cast<double>(ns1 - ns0);
+  EXPECT_NEAR(static_cast<double>(tsc1 - tsc0), steady, steady / 100);
+  if (TscClock::invariant()) {
+    EXPECT_NEAR(static_cast<double>(TscClock::toNanos(c1 - c0)), steady, steady / 100);
+  }
+}
+
+TEST(TscClock, RecalibrateTest) {
+  uint64_t last = TscClock::now();
+  for (uint32_t i = 0; i < 5; i++) {
+    std::this_thread::sleep_for(milliseconds(20));
+    TscClock::recalibrate();
+    for (uint32_t j = 0; j < 1000; j++) {
+      uint64_t ns = TscClock::now();
+      ASSERT_GE(ns, last);
+      last = ns;
+    }
+    EXPECT_LT(std::abs(static_cast<int64_t>(last) - steadyNow()), 1000000);
+  }
+}
+
+/// now() never goes back in a thread while another one recalibrates the clock.
+TEST(TscClock, ConcurrentTest) {
+  std::atomic_bool stop{false};
+  std::vector<std::thread> readers;
+  std::atomic_uint32_t n_back{0};
+  for (uint32_t i = 0; i < 3; i++) {
+    readers.emplace_back([&] {
+      uint64_t last = 0;
+      while (not stop.load()) {
+        uint64_t ns = TscClock::now();
+        if (ns < last) n_back++;
+        last = ns;
+      }
+    });
+  }
+  for (uint32_t i = 0; i < 50; i++) {
+    TscClock::recalibrate();
+    std::this_thread::sleep_for(milliseconds(1));
+  }
+  stop = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  EXPECT_EQ(n_back.load(), 0);
+}
+
+TEST(ClockTimer, ElapsedTest) {
+  ClockTimer timer;
+  timer.begin();
+  std::this_thread::sleep_for(milliseconds(20));
+  timer.end();
+  EXPECT_GT(timer.elapsed(), 0);
+  if (TscClock::invariant()) {
+    EXPECT_GE(timer.elapsed<milliseconds>(), 19);
+    EXPECT_LT(timer.elapsed<milliseconds>(), 40);
+    EXPECT_GE(timer.elapsed<microseconds>(), 19000);
+  }
+}
@@ -0,0 +1,105 @@
+#include "util/topology.hh"
+
+#include <gtest/gtest.h>
+#include <unistd.h>
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+using namespace toolbox::util;
+
+/// A fake sysfs of 2 nodes, each with 2 cores of 2 SMT siblings sharing an L3, the
+/// siblings numbered as Linux does, i.e. cpu i and i + 4 on the same core.
+class FakeSysfs {
+ public:
+  FakeSysfs() : root_(fmt::format("/tmp/toolbox_topology_{}", ::getpid())) {
+    std::filesystem::remove_all(root_);
+    write("online", "0-7");
+    for (uint32_t cpu = 0; cpu < 8; cpu++) {
+      uint32_t core = cpu % 4;
+      uint32_t node = core / 2;
+      std::string dir = fmt::format("cpu{}", cpu);
+      write(dir + "/topology/thread_siblings_list", fmt::format("{},{}", core, core + 4));
+      write(dir + "/topology/physical_package_id", std::to_string(node));
+      write(dir + "/cache/index0/level", "1");
+      write(dir + "/cache/index0/shared_cpu_list", fmt::format("{},{}", core, core + 4));
+      write(dir + "/cache/index1/level", "3");
+      uint32_t first = node * 2;
+      write(dir + "/cache/index1/shared_cpu_list",
+            fmt::format("{}-{},{}-{}", first, first + 1, first + 4, first + 5));
+      std::filesystem::create_directories(fmt::format("{}/{}/node{}", root_, dir, node));
+    }
+  }
+  ~FakeSysfs() { std::filesystem::remove_all(root_); }
+
+  auto write(const std::string& path, const std::string& content) -> void {
+    std::filesystem::path p = root_ + "/" + path;
+    std::filesystem::create_directories(p.parent_path());
+    std::ofstream(p) << content << "\n";
+  }
+
+ public:
+  const std::string root_;
+};
+
+TEST(Topology, ParseTest) {
+  EXPECT_EQ(Topology::parseCpuList("0"), (std::vector<uint32_t>{0}));
+  EXPECT_EQ(Topology::parseCpuList("0-3,8,10-11"),
+            (std::vector<uint32_t>{0, 1, 2, 3, 8, 10, 11}));
+
+  FakeSysfs sysfs;
+  Topology t(sysfs.root_);
+  ASSERT_EQ(t.cpus().size(), 8);
+  EXPECT_EQ(t.nodes(), 2);
+  const Cpu& cpu = t.cpus()[5];
+  EXPECT_EQ(cpu.id_, 5);
+  EXPECT_EQ(cpu.core_, 1);
+  EXPECT_EQ(cpu.package_, 0);
+  EXPECT_EQ(cpu.l3_, 0);
+  EXPECT_EQ(cpu.node_, 0);
+  EXPECT_EQ(t.cpus()[6].l3_, 2);
+  EXPECT_EQ(t.cpus()[6].node_, 1);
+}
+
+TEST(Topology, PickTest) {
+  FakeSysfs sysfs;
+  Topology t(sysfs.root_);
+  EXPECT_EQ(t.pick(Placement::SMTSiblings, 2), (std::vector<uint32_t>{0, 4}));
+  EXPECT_TRUE(t.pick(Placement::SMTSiblings, 4).empty());
+  EXPECT_EQ(t.pick(Placement::SameL3, 2), (std::vector<uint32_t>{0, 1}));
+  EXPECT_TRUE(t.pick(Placement::SameL3, 3).empty());
+  EXPECT_EQ(t.pick(Placement::CrossNUMA, 2), (std::vector<uint32_t>{0, 2}));
+  EXPECT_EQ(t.pick(Placement::CrossNUMA, 4), (std::vector<uint32_t>{0, 2, 1, 3}));
+  EXPECT_TRUE(t.pick(Placement::CrossNUMA, 6).empty());
+
+  // a single node without SMT
+  sysfs.write("online", "0-1");
+  for (uint32_t cpu = 0; cpu < 2; cpu++) {
+    sysfs.write(fmt::format("cpu{}/topology/thread_siblings_list", cpu),
+                std::to_string(cpu));
+    std::filesystem::remove_all(fmt::format("{}/cpu{}/node1", sysfs.root_, cpu));
+  }
+  Topology single(sysfs.root_);
+  EXPECT_TRUE(single.pick(Placement::SMTSiblings, 2).empty());
+  EXPECT_EQ(single.pick(Placement::SameL3, 2), (std::vector<uint32_t>{0, 1}));
+  EXPECT_TRUE(single.pick(Placement::CrossNUMA, 2).empty());
+}
+
+TEST(Topology, PinTest) {
+  const Topology& t = Topology::instance();
+  ASSERT_FALSE(t.cpus().empty());
+  std::vector<uint32_t> before = Topology::affinity();
+  uint32_t cpu = t.cpus().back().id_;
+  {
+    ScopedAffinity pinned(cpu);
+    EXPECT_EQ(Topology::affinity(), std::vector<uint32_t>{cpu});
+    EXPECT_EQ(static_cast<uint32_t>(::sched_getcpu()), cpu);
+  }
+  EXPECT_EQ(Topology::affinity(), before);
+
+  std::thread thread([] { std::this_thread::sleep_for(std::chrono::milliseconds(10)); });
+  Topology::pin(thread, cpu);
+  thread.join();
+}
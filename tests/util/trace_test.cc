@@ -0,0 +1,105 @@
+#include "util/trace.hh"
+
+#include <gtest/gtest.h>
+
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+using toolbox::util::Tracer;
+
+auto countOf(const std::string& s, const std::string& pattern) -> size_t {
+  size_t n = 0;
+  for (size_t pos = s.find(pattern); pos != std::string::npos;
+       pos = s.find(pattern, pos + 1)) {
+    n++;
+  }
+  return n;
+}
+
+auto inner() -> void { TRACE_SCOPE("inner"); }
+
+auto outer() -> void {
+  TRACE_SCOPE("outer");
+  inner();
+  inner();
+}
+
+TEST(Tracer, ScopeTest) {
+  Tracer& tracer = Tracer::instance();
+  tracer.drain();
+  tracer.clear();
+  outer();
+  Tracer::enable(false);
+  outer();
+  Tracer::enable(true);
+  {
+    TRACE_SCOPE("say \"hi\"");
+  }
+  EXPECT_EQ(tracer.drain(), 4);
+  EXPECT_EQ(tracer.size(), 4);
+
+  std::stringstream ss;
+  tracer.writeChromeTrace(ss);
+  std::string json = ss.str();
+  std::cout << json;
+  EXPECT_EQ(json.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0), 0);
+  EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+  EXPECT_EQ(countOf(json, "\"ph\":\"X\""), 4);
+  EXPECT_EQ(countOf(json, "\"name\":\"outer\""), 1);
+  EXPECT_EQ(countOf(json, "\"name\":\"inner\""), 2);
+  EXPECT_EQ(countOf(json, R"("name":"say \"hi\"")"), 1);
+  // inner spans end first
+  EXPECT_LT(json.find("\"inner\""), json.find("\"outer\""));
+  tracer.clear();
+}
+
+TEST(Tracer, DrainerTest) {
+  constexpr uint32_t n_thread = 4;
+  constexpr uint32_t n_span = 10000;
+  Tracer& tracer = Tracer::instance();
+  tracer.drain();
+  tracer.clear();
+  uint64_t dropped = tracer.dropped();
+  tracer.start(std::chrono::milliseconds(1));
+  std::vector<std::thread> threads;
+  for (uint32_t i = 0; i < n_thread; i++) {
+    threads.emplace_back([] {
+      for (uint32_t j = 0; j < n_span; j++) {
+        TRACE_SCOPE("span");
+        if (j % 1000 == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    });
+  }
+  for (auto& t : threads) {
+    t.join();
+  }
+  tracer.stop();
+  tracer.drain();
+  EXPECT_EQ(tracer.size() + (tracer.dropped() - dropped), n_thread * n_span);
+
+  std::stringstream ss;
+  tracer.writeChromeTrace(ss);
+  std::set<std::string> tids;
+  std::string json = ss.str();
+  for (size_t pos = json.find("\"tid\":"); pos != std::string::npos;
+       pos = json.find("\"tid\":", pos + 1)) {
+    tids.insert(json.substr(pos, json.find('}', pos) - pos));
+  }
+  EXPECT_EQ(tids.size(), n_thread);
+  tracer.clear();
+}
+
+TEST(Tracer, DropTest) {
+  Tracer& tracer = Tracer::instance();
+  tracer.drain();
+  tracer.clear();
+  uint64_t dropped = tracer.dropped();
+  for (uint32_t i = 0; i < Tracer::ring_size + 100; i++) {
+    TRACE_SCOPE("drop");
+  }
+  EXPECT_EQ(tracer.drain(), Tracer::ring_size);
+  EXPECT_EQ(tracer.dropped() - dropped, 100);
+  tracer.clear();
+}